@@ -3,7 +3,7 @@
 TARGET = qView
 VERSION = 5.0
 
-QT += core gui network widgets
+QT += core gui network widgets concurrent
 
 TEMPLATE = app
 
@@ -42,7 +42,7 @@ win32 {
 
     # To build without win32: qmake CONFIG+=NO_WIN32
     !CONFIG(NO_WIN32) {
-        LIBS += -lshell32 -luser32 -lole32 -lshlwapi
+        LIBS += -lshell32 -luser32 -lole32 -lshlwapi -lgdi32
         DEFINES += WIN32_LOADED
         message("Linked to win32 api")
     }
@@ -74,6 +74,31 @@ macx {
     }
 }
 
+# Linux specific stuff
+linux {
+    # To build without native directory scanning: qmake CONFIG+=NO_LINUX
+    !CONFIG(NO_LINUX) {
+        DEFINES += LINUX_LOADED
+        message("Using linux native directory scanning")
+    }
+}
+
+# Deflated zip/cbz entries, stored ones work without it
+# To build without zlib: qmake CONFIG+=NO_ZLIB
+!win32:!CONFIG(NO_ZLIB) {
+    LIBS += -lz
+    DEFINES += ZLIB_LOADED
+    message("Linked to zlib")
+}
+
+# Lossless JPEG rotation, Save Rotation is disabled without it
+# To build without libjpeg: qmake CONFIG+=NO_LIBJPEG
+linux:!CONFIG(NO_LIBJPEG) {
+    LIBS += -ljpeg
+    DEFINES += LIBJPEG_LOADED
+    message("Linked to libjpeg")
+}
+
 # Stuff for make install
 # To use a custom prefix: qmake PREFIX=/usr
 # An environment variable will also work: PREFIX=/usr qmake
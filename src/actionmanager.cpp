@@ -270,6 +270,7 @@ QMenu *ActionManager::buildViewMenu(bool addIcon, QWidget *parent)
     viewMenu->addSeparator();
     viewMenu->addAction(cloneAction("mirror"));
     viewMenu->addAction(cloneAction("flip"));
+    viewMenu->addAction(cloneAction("saverotation"));
     viewMenu->addSeparator();
     viewMenu->addAction(cloneAction("fullscreen"));
 
@@ -285,8 +286,10 @@ QMenu *ActionManager::buildToolsMenu(bool addIcon, QWidget *parent)
         toolsMenu->setIcon(QIcon::fromTheme("configure", QIcon::fromTheme("preferences-other")));
 
     toolsMenu->addAction(cloneAction("saveframeas"));
+    toolsMenu->addAction(cloneAction("exportframes"));
     toolsMenu->addAction(cloneAction("pause"));
     toolsMenu->addAction(cloneAction("nextframe"));
+    toolsMenu->addAction(cloneAction("gotoframe"));
     toolsMenu->addSeparator();
     toolsMenu->addAction(cloneAction("decreasespeed"));
     toolsMenu->addAction(cloneAction("resetspeed"));
@@ -618,6 +621,8 @@ void ActionManager::actionTriggered(QAction *triggeredAction, MainWindow *releva
         relevantWindow->mirror();
     } else if (key == "flip") {
         relevantWindow->flip();
+    } else if (key == "saverotation") {
+        relevantWindow->saveRotation();
     } else if (key == "fullscreen") {
         relevantWindow->toggleFullScreen();
     } else if (key == "firstfile") {
@@ -630,10 +635,14 @@ void ActionManager::actionTriggered(QAction *triggeredAction, MainWindow *releva
         relevantWindow->lastFile();
     } else if (key == "saveframeas") {
         relevantWindow->saveFrameAs();
+    } else if (key == "exportframes") {
+        relevantWindow->exportFrames();
     } else if (key == "pause") {
         relevantWindow->pause();
     } else if (key == "nextframe") {
         relevantWindow->nextFrame();
+    } else if (key == "gotoframe") {
+        relevantWindow->goToFrame();
     } else if (key == "decreasespeed") {
         relevantWindow->decreaseSpeed();
     } else if (key == "resetspeed") {
@@ -742,6 +751,10 @@ void ActionManager::initializeActionLibrary()
     flipAction->setData({"disable"});
     actionLibrary.insert("flip", flipAction);
 
+    auto *saveRotationAction = new QAction(QIcon::fromTheme("document-save"), tr("&Save Rotation"));
+    saveRotationAction->setData({"disable"});
+    actionLibrary.insert("saverotation", saveRotationAction);
+
     auto *fullScreenAction = new QAction(QIcon::fromTheme("view-fullscreen"), tr("Enter F&ull Screen"));
     fullScreenAction->setMenuRole(QAction::NoRole);
     actionLibrary.insert("fullscreen", fullScreenAction);
@@ -766,6 +779,10 @@ void ActionManager::initializeActionLibrary()
     saveFrameAsAction->setData({"gifdisable"});
     actionLibrary.insert("saveframeas", saveFrameAsAction);
 
+    auto *exportFramesAction = new QAction(QIcon::fromTheme("document-export", QIcon::fromTheme("document-save-as")), tr("&Export Frames..."));
+    exportFramesAction->setData({"gifdisable"});
+    actionLibrary.insert("exportframes", exportFramesAction);
+
     auto *pauseAction = new QAction(QIcon::fromTheme("media-playback-pause"), tr("Pa&use"));
     pauseAction->setData({"gifdisable"});
     actionLibrary.insert("pause", pauseAction);
@@ -774,6 +791,10 @@ void ActionManager::initializeActionLibrary()
     nextFrameAction->setData({"gifdisable"});
     actionLibrary.insert("nextframe", nextFrameAction);
 
+    auto *goToFrameAction = new QAction(QIcon::fromTheme("go-jump"), tr("&Go to Frame..."));
+    goToFrameAction->setData({"gifdisable"});
+    actionLibrary.insert("gotoframe", goToFrameAction);
+
     auto *decreaseSpeedAction = new QAction(QIcon::fromTheme("media-seek-backward"), tr("&Decrease Speed"));
     decreaseSpeedAction->setData({"gifdisable"});
     actionLibrary.insert("decreasespeed", decreaseSpeedAction);
@@ -3,6 +3,9 @@
 #include "qvapplication.h"
 #include "qvcocoafunctions.h"
 #include "qvrenamedialog.h"
+#include "qvexportframesdialog.h"
+#include "qvframeexporter.h"
+#include "qvjpegtransform.h"
 
 #include <QFileDialog>
 #include <QMessageBox>
@@ -15,8 +18,9 @@
 #include <QProcess>
 #include <QDesktopServices>
 #include <QContextMenuEvent>
-#include <QMovie>
+#include <QImageReader>
 #include <QImageWriter>
+#include <QBuffer>
 #include <QSettings>
 #include <QStyle>
 #include <QIcon>
@@ -32,6 +36,68 @@
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QTemporaryFile>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QLabel>
+#include <limits>
+
+namespace
+{
+    // How big the preview in the download dialog gets, and how often it's redone while more arrives
+    const QSize URL_PREVIEW_SIZE(480, 360);
+    const int URL_PREVIEW_INTERVAL = 250;
+
+    // What a download keeps between chunks. They're kept as they arrived rather than appended to one buffer,
+    // since appending to a buffer a preview decode still holds a copy of would copy all of it every time
+    struct UrlDownload
+    {
+        QList<QByteArray> chunks;
+        qint64 size = 0;
+        QElapsedTimer previewTimer;
+        bool isFormatChecked = false;
+        bool canPreview = false;
+    };
+
+    QByteArray joinChunks(const QList<QByteArray> &chunks)
+    {
+        int size = 0;
+        for (const auto &chunk : chunks)
+            size += chunk.size();
+
+        QByteArray data;
+        data.reserve(size);
+        for (const auto &chunk : chunks)
+            data.append(chunk);
+        return data;
+    }
+
+    // Of the formats Qt reads, only JPEG makes something of a truncated file, the rest come back null,
+    // so nothing else is worth decoding over and over while it downloads
+    bool canDecodePartially(const QByteArray &start)
+    {
+        return start.startsWith("\xFF\xD8\xFF");
+    }
+
+    // Decodes as much of a download as has arrived. JPEGs come out with the missing part gray, or blurry when progressive
+    QImage decodeUrlPreview(const QList<QByteArray> &chunks)
+    {
+        QBuffer buffer;
+        buffer.setData(joinChunks(chunks));
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer);
+        reader.setAutoTransform(true);
+
+        // Scaled while decoding where the format can do it, which for JPEG is much cheaper than decoding it all
+        const QSize size = reader.size();
+        if (size.width() > URL_PREVIEW_SIZE.width() || size.height() > URL_PREVIEW_SIZE.height())
+            reader.setScaledSize(size.scaled(URL_PREVIEW_SIZE, Qt::KeepAspectRatio));
+
+        const QImage image = reader.read();
+        if (image.width() > URL_PREVIEW_SIZE.width() || image.height() > URL_PREVIEW_SIZE.height())
+            return image.scaled(URL_PREVIEW_SIZE, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        return image;
+    }
+}
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -42,6 +108,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
     // Initialize variables
     justLaunchedWithImage = false;
+    isSavingRotation = false;
     storedWindowState = Qt::WindowNoState;
 
     // Initialize graphicsview
@@ -53,6 +120,10 @@ MainWindow::MainWindow(QWidget *parent) :
 
     // Connect graphicsview signals
     connect(graphicsView, &QVGraphicsView::fileChanged, this, &MainWindow::fileChanged);
+    connect(graphicsView, &QVGraphicsView::folderInfoChanged, this, [this](){
+        disableActions();
+        buildWindowTitle();
+    });
     connect(graphicsView, &QVGraphicsView::updatedLoadedPixmapItem, this, &MainWindow::setWindowSize);
     connect(graphicsView, &QVGraphicsView::cancelSlideshow, this, &MainWindow::cancelSlideshow);
 
@@ -69,6 +140,19 @@ MainWindow::MainWindow(QWidget *parent) :
     // Make info dialog object
     info = new QVInfoDialog(this);
 
+    // Playback stats keep changing while an animation plays, so they're refreshed as long as the dialog is up
+    infoRefreshTimer = new QTimer(this);
+    infoRefreshTimer->setInterval(1000);
+    connect(infoRefreshTimer, &QTimer::timeout, this, [this]{
+        if (!info->isVisible())
+        {
+            infoRefreshTimer->stop();
+            return;
+        }
+        if (getCurrentFileDetails().isMovieLoaded)
+            info->setPlaybackStats(graphicsView->getLoadedMovie().playbackStats());
+    });
+
     // Timer for slideshow
     slideshowTimer = new QTimer(this);
     connect(slideshowTimer, &QTimer::timeout, this, &MainWindow::slideshowAction);
@@ -344,7 +428,7 @@ void MainWindow::disableActions()
                 }
                 else if (cloneData.last() == "folderdisable")
                 {
-                    clone->setEnabled(!getCurrentFileDetails().folderFileInfoList.isEmpty());
+                    clone->setEnabled(!getCurrentFileDetails().folderIndex.isEmpty());
                 }
             }
         }
@@ -401,12 +485,13 @@ void MainWindow::refreshProperties()
     else
         value4 = 0;
     info->setInfo(getCurrentFileDetails().fileInfo, getCurrentFileDetails().baseImageSize.width(), getCurrentFileDetails().baseImageSize.height(), value4);
+    info->setPlaybackStats(getCurrentFileDetails().isMovieLoaded ? graphicsView->getLoadedMovie().playbackStats() : QVAnimationPlayer::Stats());
 }
 
 void MainWindow::buildWindowTitle()
 {
     QString newString = "qView";
-    if (getCurrentFileDetails().fileInfo.isFile())
+    if (getCurrentFileDetails().fileInfo.isFile() || QVArchive::isArchiveEntryPath(getCurrentFileDetails().fileInfo.absoluteFilePath()))
     {
         switch (qvApp->getSettingsManager().getInteger("titlebarmode")) {
         case 1:
@@ -417,14 +502,14 @@ void MainWindow::buildWindowTitle()
         case 2:
         {
             newString = QString::number(getCurrentFileDetails().loadedIndexInFolder+1);
-            newString += "/" + QString::number(getCurrentFileDetails().folderFileInfoList.count());
+            newString += "/" + QString::number(getCurrentFileDetails().folderIndex.count());
             newString += " - " + getCurrentFileDetails().fileInfo.fileName();
             break;
         }
         case 3:
         {
             newString = QString::number(getCurrentFileDetails().loadedIndexInFolder+1);
-            newString += "/" + QString::number(getCurrentFileDetails().folderFileInfoList.count());
+            newString += "/" + QString::number(getCurrentFileDetails().folderIndex.count());
             newString += " - " + getCurrentFileDetails().fileInfo.fileName();
             newString += " - "  + QString::number(getCurrentFileDetails().baseImageSize.width());
             newString += "x" + QString::number(getCurrentFileDetails().baseImageSize.height());
@@ -573,19 +658,66 @@ void MainWindow::openUrl(const QUrl &url)
     progressDialog->setAutoClose(false);
     progressDialog->setAutoReset(false);
     progressDialog->setWindowTitle(tr("Open URL..."));
+
+    // Shows the text until there is enough of the image for a preview
+    auto *previewLabel = new QLabel(tr("Downloading image..."));
+    previewLabel->setAlignment(Qt::AlignCenter);
+    progressDialog->setLabel(previewLabel);
     progressDialog->open();
 
     connect(progressDialog, &QProgressDialog::canceled, reply, [reply]{
         reply->abort();
     });
 
+    // The download is taken out of the reply as it arrives, so the preview can be redone from what's there so far
+    auto download = QSharedPointer<UrlDownload>::create();
+    auto *previewFutureWatcher = new QFutureWatcher<QImage>(progressDialog);
+
+    connect(previewFutureWatcher, &QFutureWatcher<QImage>::finished, progressDialog, [progressDialog, previewLabel, previewFutureWatcher]{
+        const QImage preview = previewFutureWatcher->result();
+        if (preview.isNull())
+            return;
+
+        // The text goes once there's a picture, and the dialog grows to fit it the first time
+        const bool firstPreview = !previewLabel->text().isEmpty();
+        previewLabel->setPixmap(QPixmap::fromImage(preview));
+        if (firstPreview)
+            progressDialog->resize(progressDialog->sizeHint().expandedTo(progressDialog->size()));
+    });
+
+    connect(reply, &QNetworkReply::readyRead, progressDialog, [reply, download, previewFutureWatcher]{
+        const QByteArray chunk = reply->readAll();
+        if (chunk.isEmpty())
+            return;
+        download->chunks.append(chunk);
+        download->size += chunk.size();
+
+        // The format is decided once, from the first bytes
+        if (!download->isFormatChecked)
+        {
+            if (download->size < 3)
+                return;
+            download->isFormatChecked = true;
+            download->canPreview = canDecodePartially(joinChunks(download->chunks));
+        }
+
+        if (!download->canPreview || previewFutureWatcher->isRunning() ||
+            (download->previewTimer.isValid() && download->previewTimer.elapsed() < URL_PREVIEW_INTERVAL))
+            return;
+
+        download->previewTimer.start();
+        previewFutureWatcher->setFuture(QtConcurrent::run(decodeUrlPreview, download->chunks));
+    });
+
     connect(reply, &QNetworkReply::downloadProgress, progressDialog, [progressDialog](qreal bytesReceived, qreal bytesTotal){
         auto percent = (bytesReceived/bytesTotal)*100;
         progressDialog->setValue(qRound(percent));
     });
 
 
-    connect(reply, &QNetworkReply::finished, progressDialog, [progressDialog, reply, this]{
+    connect(reply, &QNetworkReply::finished, progressDialog, [progressDialog, reply, download, previewFutureWatcher, this]{
+        reply->deleteLater();
+        previewFutureWatcher->disconnect();
         if (reply->error())
         {
             progressDialog->close();
@@ -595,32 +727,50 @@ void MainWindow::openUrl(const QUrl &url)
             return;
         }
 
+        download->chunks.append(reply->readAll());
+        const QByteArray data = joinChunks(download->chunks);
+        download->chunks.clear();
+
+        // Only the header is checked here, the image itself is decoded once, by the core, from the bytes as downloaded.
+        // That keeps animations animated and skips decoding and re-encoding everything as PNG first
+        QBuffer buffer;
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer);
+        if (!reader.canRead())
+        {
+            progressDialog->close();
+            QMessageBox::critical(this, tr("Error"), tr("Error: Invalid image"));
+            progressDialog->deleteLater();
+            return;
+        }
+
         progressDialog->setMaximum(0);
 
+        // Named after the format that was found, since that's how the core and the folder listing recognize it
         auto *tempFile = new QTemporaryFile(this);
-        tempFile->setFileTemplate(QDir::tempPath() + "/" + qvApp->applicationName() + ".XXXXXX.png");
+        tempFile->setFileTemplate(QDir::tempPath() + "/" + qvApp->applicationName() + ".XXXXXX." + QString::fromLatin1(reader.format()));
 
         auto *saveFutureWatcher = new QFutureWatcher<bool>();
         connect(saveFutureWatcher, &QFutureWatcher<bool>::finished, this, [progressDialog, tempFile, saveFutureWatcher, this](){
             progressDialog->close();
             if (saveFutureWatcher->result())
             {
-                if (tempFile->open())
-                {
-                    openFile(tempFile->fileName());
-                }
+                openFile(tempFile->fileName());
             }
             else
             {
-                 QMessageBox::critical(this, tr("Error"), tr("Error: Invalid image"));
+                 QMessageBox::critical(this, tr("Error"), tr("Error: Could not save the image to %1").arg(QDir::toNativeSeparators(QDir::tempPath())));
                  tempFile->deleteLater();
             }
             progressDialog->deleteLater();
             saveFutureWatcher->deleteLater();
         });
 
-        saveFutureWatcher->setFuture(QtConcurrent::run([reply, tempFile]{
-            return QImage::fromData(reply->readAll()).save(tempFile, "png");
+        saveFutureWatcher->setFuture(QtConcurrent::run([data, tempFile]{
+            const bool saved = tempFile->open() && tempFile->write(data) == data.size();
+            tempFile->close();
+            return saved;
         }));
     });
 }
@@ -669,6 +819,7 @@ void MainWindow::showFileInfo()
     refreshProperties();
     info->show();
     info->raise();
+    infoRefreshTimer->start();
 }
 
 void MainWindow::askDeleteFile()
@@ -857,11 +1008,6 @@ void MainWindow::rename()
 
     auto *renameDialog = new QVRenameDialog(this, getCurrentFileDetails().fileInfo);
     connect(renameDialog, &QVRenameDialog::newFileToOpen, this, &MainWindow::openFile);
-    connect(renameDialog, &QVRenameDialog::readyToRenameFile, this, [this] () {
-        if (auto device = graphicsView->getLoadedMovie().device()) {
-            device->close();
-        }
-    });
 
     renameDialog->open();
 }
@@ -910,6 +1056,60 @@ void MainWindow::flip()
     resetZoom();
 }
 
+void MainWindow::saveRotation()
+{
+    if (!getCurrentFileDetails().isPixmapLoaded || isSavingRotation)
+        return;
+
+    const int rotation = graphicsView->getCurrentRotation();
+    const bool mirrored = graphicsView->isMirrored();
+    const bool flipped = graphicsView->isFlipped();
+    if (rotation == 0 && !mirrored && !flipped)
+        return;
+
+    if (!QVJpegTransform::isSupported())
+    {
+        QMessageBox::critical(this, tr("Not Supported"), tr("This program was compiled without libjpeg and this feature is not available."));
+        return;
+    }
+
+    // Archive entries aren't files that can be written to
+    const QFileInfo fileInfo = getCurrentFileDetails().fileInfo;
+    const QString filePath = fileInfo.absoluteFilePath();
+    if (!fileInfo.isFile() || !QVJpegTransform::canTransform(filePath))
+    {
+        QMessageBox::warning(this, tr("Save Rotation"), tr("Only JPEG files can be rotated losslessly."));
+        return;
+    }
+
+    isSavingRotation = true;
+    auto *transformFutureWatcher = new QFutureWatcher<QString>(this);
+    connect(transformFutureWatcher, &QFutureWatcher<QString>::finished, this, [this, transformFutureWatcher, filePath, rotation, mirrored, flipped]{
+        isSavingRotation = false;
+        transformFutureWatcher->deleteLater();
+
+        const QString errorString = transformFutureWatcher->result();
+        if (!errorString.isEmpty())
+        {
+            QMessageBox::critical(this, tr("Error"), errorString);
+            return;
+        }
+
+        // The file now looks the way the view was showing it, so the view goes back to showing it as it is
+        graphicsView->removeFromCache(filePath);
+        graphicsView->rotateImage(-rotation);
+        if (mirrored)
+            graphicsView->scale(-1, 1);
+        if (flipped)
+            graphicsView->scale(1, -1);
+
+        if (getCurrentFileDetails().fileInfo.absoluteFilePath() == filePath)
+            graphicsView->loadFile(filePath);
+        resetZoom();
+    });
+    transformFutureWatcher->setFuture(QtConcurrent::run(&QVJpegTransform::transformFile, filePath, rotation, mirrored, flipped));
+}
+
 void MainWindow::firstFile()
 {
     graphicsView->goToFile(QVGraphicsView::GoToFileMode::first);
@@ -937,7 +1137,7 @@ void MainWindow::saveFrameAs()
     if (!getCurrentFileDetails().isMovieLoaded)
         return;
 
-    if (graphicsView->getLoadedMovie().state() == QMovie::Running)
+    if (graphicsView->getLoadedMovie().state() == QVAnimationPlayer::State::Running)
     {
         pause();
     }
@@ -950,14 +1150,61 @@ void MainWindow::saveFrameAs()
     saveDialog->open();
     connect(saveDialog, &QFileDialog::fileSelected, this, [=](const QString &fileName){
         graphicsView->originalSize();
-        for(int i=0; i < graphicsView->getLoadedMovie().frameCount(); i++)
-            nextFrame();
-
         graphicsView->getLoadedMovie().currentPixmap().save(fileName, nullptr, 100);
         graphicsView->resetScale();
     });
 }
 
+void MainWindow::exportFrames()
+{
+    if (!getCurrentFileDetails().isMovieLoaded)
+        return;
+
+    QSettings settings;
+    settings.beginGroup("recents");
+
+    const QVAnimationPlayer &movie = graphicsView->getLoadedMovie();
+    auto *exportDialog = new QVExportFramesDialog(this, settings.value("lastFileDialogDir", QDir::homePath()).toString(), movie.frameCount());
+    connect(exportDialog, &QDialog::accepted, this, [this, exportDialog, data = movie.getData(), format = movie.format(),
+                                                      baseName = getCurrentFileDetails().fileInfo.baseName()]{
+        const int firstFrame = exportDialog->getFirstFrame();
+        const int lastFrame = exportDialog->getLastFrame();
+
+        // Decodes from its own reference to the animation's bytes, so the window can keep playing or move on to something else
+        auto *exporter = new QVFrameExporter(this);
+        auto *progressDialog = new QProgressDialog(tr("Exporting frames..."), tr("Cancel"), 0, lastFrame >= 0 ? lastFrame - firstFrame + 1 : 0, this);
+        progressDialog->setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+        progressDialog->setAutoClose(false);
+        progressDialog->setAutoReset(false);
+        progressDialog->setWindowTitle(tr("Export Frames..."));
+        progressDialog->open();
+
+        connect(progressDialog, &QProgressDialog::canceled, exporter, &QVFrameExporter::cancel);
+
+        // Signals come from the exporter's workers, so they're queued onto the dialog
+        connect(exporter, &QVFrameExporter::progressChanged, progressDialog, [progressDialog](int framesWritten, int frameTotal){
+            if (frameTotal > 0)
+                progressDialog->setValue(framesWritten);
+            else
+                progressDialog->setLabelText(tr("Exporting frames... (%1 written)").arg(framesWritten));
+        });
+
+        connect(exporter, &QVFrameExporter::finished, progressDialog, [this, progressDialog, exporter](int framesWritten, const QString &errorString){
+            progressDialog->close();
+            progressDialog->deleteLater();
+            exporter->deleteLater();
+
+            if (!errorString.isEmpty())
+                QMessageBox::critical(this, tr("Error"), errorString);
+            else if (framesWritten == 0 && !progressDialog->wasCanceled())
+                QMessageBox::warning(this, tr("Export Frames..."), tr("There were no frames in that range."));
+        });
+
+        exporter->start(data, format, exportDialog->getDirectory(), baseName, firstFrame, lastFrame, exportDialog->getCompressionLevel());
+    });
+    exportDialog->open();
+}
+
 void MainWindow::pause()
 {
     if (!getCurrentFileDetails().isMovieLoaded)
@@ -965,7 +1212,7 @@ void MainWindow::pause()
 
     const auto pauseActions = qvApp->getActionManager().getAllClonesOfAction("pause", this);
 
-    if (graphicsView->getLoadedMovie().state() == QMovie::Running)
+    if (graphicsView->getLoadedMovie().state() == QVAnimationPlayer::State::Running)
     {
         graphicsView->setPaused(true);
         for (const auto &pauseAction : pauseActions)
@@ -993,6 +1240,32 @@ void MainWindow::nextFrame()
     graphicsView->jumpToNextFrame();
 }
 
+void MainWindow::goToFrame()
+{
+    if (!getCurrentFileDetails().isMovieLoaded)
+        return;
+
+    // Paused so the picked frame stays up
+    if (graphicsView->getLoadedMovie().state() == QVAnimationPlayer::State::Running)
+        pause();
+
+    const int frameCount = graphicsView->getLoadedMovie().frameCount();
+    auto inputDialog = new QInputDialog(this);
+    inputDialog->setWindowTitle(tr("Go to Frame"));
+    inputDialog->setLabelText(tr("Frame number:"));
+    inputDialog->setInputMode(QInputDialog::IntInput);
+    inputDialog->setIntRange(1, frameCount > 0 ? frameCount : std::numeric_limits<int>::max());
+    inputDialog->setIntValue(graphicsView->getLoadedMovie().currentFrameNumber() + 1);
+    inputDialog->setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+
+    // Scrubs through the animation as the number changes, seeks start from the nearest keyframe
+    connect(inputDialog, &QInputDialog::intValueChanged, this, [this](int value) {
+        graphicsView->jumpToFrame(value - 1);
+    });
+    connect(inputDialog, &QInputDialog::finished, inputDialog, &QObject::deleteLater);
+    inputDialog->open();
+}
+
 void MainWindow::toggleSlideshow()
 {
     const auto slideshowActions = qvApp->getActionManager().getAllClonesOfAction("slideshow", this);
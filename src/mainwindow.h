@@ -87,6 +87,8 @@ public:
 
     void flip();
 
+    void saveRotation();
+
     void firstFile();
 
     void previousFile();
@@ -97,10 +99,14 @@ public:
 
     void saveFrameAs();
 
+    void exportFrames();
+
     void pause();
 
     void nextFrame();
 
+    void goToFrame();
+
     void decreaseSpeed();
 
     void resetSpeed();
@@ -152,12 +158,16 @@ private:
 
     QTimer *slideshowTimer;
 
+    QTimer *infoRefreshTimer;
+
     QShortcut *escShortcut;
 
     QVInfoDialog *info;
 
     bool justLaunchedWithImage;
 
+    bool isSavingRotation;
+
     Qt::WindowStates storedWindowState;
 
     QNetworkAccessManager networkAccessManager;
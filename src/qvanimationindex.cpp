@@ -0,0 +1,370 @@
+#include "qvanimationindex.h"
+
+#include <algorithm>
+
+namespace
+{
+    quint32 readLittleEndian(const uchar *bytes, int byteCount)
+    {
+        quint32 value = 0;
+        for (int i = byteCount - 1; i >= 0; i--)
+            value = (value << 8) | bytes[i];
+        return value;
+    }
+
+    quint32 readBigEndian(const uchar *bytes)
+    {
+        return (static_cast<quint32>(bytes[0]) << 24) | (static_cast<quint32>(bytes[1]) << 16) |
+               (static_cast<quint32>(bytes[2]) << 8) | bytes[3];
+    }
+
+    void appendBigEndian(QByteArray &bytes, quint32 value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            bytes.append(static_cast<char>((value >> shift) & 0xff));
+    }
+
+    const int PNG_SIGNATURE_LENGTH = 8;
+
+    // Length, type and CRC around every PNG chunk's data
+    const int PNG_CHUNK_OVERHEAD = 12;
+
+    quint32 getPngCrc(const QByteArray &typeAndData)
+    {
+        static const QVector<quint32> table = []{
+            QVector<quint32> crcTable(256);
+            for (quint32 n = 0; n < 256; n++)
+            {
+                quint32 c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+                crcTable[static_cast<int>(n)] = c;
+            }
+            return crcTable;
+        }();
+
+        quint32 crc = 0xffffffff;
+        for (const char byte : typeAndData)
+            crc = table.at(static_cast<int>((crc ^ static_cast<uchar>(byte)) & 0xff)) ^ (crc >> 8);
+        return crc ^ 0xffffffff;
+    }
+
+    void appendPngChunk(QByteArray &png, const QByteArray &type, const QByteArray &chunkData)
+    {
+        const QByteArray typeAndData = type + chunkData;
+        appendBigEndian(png, static_cast<quint32>(chunkData.size()));
+        png.append(typeAndData);
+        appendBigEndian(png, getPngCrc(typeAndData));
+    }
+
+    QByteArray withBigEndianAt(QByteArray bytes, int offset, quint32 value)
+    {
+        for (int i = 0; i < 4; i++)
+            bytes[offset + i] = static_cast<char>((value >> ((3 - i) * 8)) & 0xff);
+        return bytes;
+    }
+}
+
+QVAnimationIndex QVAnimationIndex::build(const QByteArray &data)
+{
+    QVAnimationIndex index;
+    if (parseGif(data, index) || parseApng(data, index) || parseWebP(data, index))
+        return index;
+
+    return QVAnimationIndex();
+}
+
+int QVAnimationIndex::getKeyframe(int frameNumber) const
+{
+    // Frame 0 is always one, so there's always an answer
+    const auto next = std::upper_bound(keyframes.constBegin(), keyframes.constEnd(), frameNumber);
+    if (next == keyframes.constBegin())
+        return 0;
+
+    return *(next - 1);
+}
+
+QByteArray QVAnimationIndex::getStreamFrom(const QByteArray &data, int keyframe) const
+{
+    if (keyframe <= 0 || keyframe >= frameOffsets.length())
+        return data;
+
+    // APNG chunks are numbered and checksummed, and the first frame has to be IDAT, so it's rewritten chunk by chunk:
+    // the header keeps everything but the frame count, the keyframe's fdAT chunks become IDAT, and the rest are renumbered from 0
+    if (container == Container::Png)
+    {
+        const auto *bytes = reinterpret_cast<const uchar *>(data.constData());
+        QByteArray stream = data.left(PNG_SIGNATURE_LENGTH);
+        quint32 sequenceNumber = 0;
+        bool isKeyframeData = false;
+        int position = PNG_SIGNATURE_LENGTH;
+        while (position + PNG_CHUNK_OVERHEAD <= data.size())
+        {
+            // Skip from the end of the header straight to the keyframe
+            if (position == headerLength)
+                position = frameOffsets.at(keyframe);
+
+            const int chunkLength = static_cast<int>(readBigEndian(bytes + position));
+            if (chunkLength < 0 || chunkLength > data.size() - position - PNG_CHUNK_OVERHEAD)
+                break;
+
+            const int next = position + PNG_CHUNK_OVERHEAD + chunkLength;
+            const QByteArray type = data.mid(position + 4, 4);
+            const QByteArray chunkData = data.mid(position + 8, chunkLength);
+            if (type == "acTL" && chunkLength >= 8)
+            {
+                appendPngChunk(stream, type, withBigEndianAt(chunkData, 0, static_cast<quint32>(frameOffsets.length() - keyframe)));
+            }
+            else if (type == "fcTL" && chunkLength >= 4)
+            {
+                isKeyframeData = sequenceNumber == 0;
+                appendPngChunk(stream, type, withBigEndianAt(chunkData, 0, sequenceNumber++));
+            }
+            else if (type == "fdAT" && chunkLength >= 4)
+            {
+                if (isKeyframeData)
+                    appendPngChunk(stream, "IDAT", chunkData.mid(4));
+                else
+                    appendPngChunk(stream, type, withBigEndianAt(chunkData, 0, sequenceNumber++));
+            }
+            else
+            {
+                stream.append(data.mid(position, next - position));
+            }
+
+            // Anything after the end wasn't looked at when the index was built
+            if (type == "IEND")
+                break;
+
+            position = next;
+        }
+        return stream;
+    }
+
+    QByteArray stream = data.left(headerLength) + data.mid(frameOffsets.at(keyframe));
+
+    // RIFF starts with the size of everything after the first 8 bytes
+    if (container == Container::WebP)
+    {
+        const quint32 riffSize = static_cast<quint32>(stream.size() - 8);
+        for (int i = 0; i < 4; i++)
+            stream[4 + i] = static_cast<char>((riffSize >> (i * 8)) & 0xff);
+    }
+
+    return stream;
+}
+
+bool QVAnimationIndex::parseGif(const QByteArray &data, QVAnimationIndex &index)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data.constData());
+    const int size = data.size();
+    if (size < 13 || (!data.startsWith("GIF87a") && !data.startsWith("GIF89a")))
+        return false;
+
+    const int canvasWidth = static_cast<int>(readLittleEndian(bytes + 6, 2));
+    const int canvasHeight = static_cast<int>(readLittleEndian(bytes + 8, 2));
+
+    int position = 13;
+    if (bytes[10] & 0x80)
+        position += 3 << ((bytes[10] & 0x07) + 1);
+
+    index.container = Container::Gif;
+    index.headerLength = position;
+
+    // A frame starts at the first block after the previous image, so it takes its extensions along
+    int frameStart = position;
+    int disposal = 0;
+    bool hasTransparency = false;
+    while (position < size)
+    {
+        const uchar blockType = bytes[position];
+        if (blockType == 0x3b)
+            break;
+
+        if (blockType == 0x21)
+        {
+            if (position + 2 > size)
+                return false;
+
+            // Graphic control extension, the one for the next image
+            if (bytes[position + 1] == 0xf9 && position + 4 <= size)
+            {
+                disposal = (bytes[position + 3] >> 2) & 0x07;
+                hasTransparency = bytes[position + 3] & 0x01;
+            }
+
+            position += 2;
+            while (position < size && bytes[position] != 0)
+                position += bytes[position] + 1;
+            position++;
+            continue;
+        }
+
+        if (blockType != 0x2c || position + 10 > size)
+            return false;
+
+        const int left = static_cast<int>(readLittleEndian(bytes + position + 1, 2));
+        const int top = static_cast<int>(readLittleEndian(bytes + position + 3, 2));
+        const int width = static_cast<int>(readLittleEndian(bytes + position + 5, 2));
+        const int height = static_cast<int>(readLittleEndian(bytes + position + 7, 2));
+        const uchar flags = bytes[position + 9];
+
+        position += 10;
+        if (flags & 0x80)
+            position += 3 << ((flags & 0x07) + 1);
+
+        // LZW code size, then the image data in sub-blocks
+        position++;
+        while (position < size && bytes[position] != 0)
+            position += bytes[position] + 1;
+        position++;
+        if (position > size)
+            break;
+
+        // Every pixel is drawn and nothing is restored to what came before it afterwards
+        const bool coversCanvas = left == 0 && top == 0 && width >= canvasWidth && height >= canvasHeight;
+        if (index.frameOffsets.isEmpty() || (coversCanvas && !hasTransparency && disposal != 3))
+            index.keyframes.append(index.frameOffsets.length());
+
+        index.frameOffsets.append(frameStart);
+        frameStart = position;
+        disposal = 0;
+        hasTransparency = false;
+    }
+
+    return !index.frameOffsets.isEmpty();
+}
+
+bool QVAnimationIndex::parseApng(const QByteArray &data, QVAnimationIndex &index)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data.constData());
+    const int size = data.size();
+    if (size < PNG_SIGNATURE_LENGTH || !data.startsWith("\x89PNG\r\n\x1a\n"))
+        return false;
+
+    int canvasWidth = 0;
+    int canvasHeight = 0;
+    bool isOpaque = true;
+    bool isAnimated = false;
+
+    index.container = Container::Png;
+
+    int position = PNG_SIGNATURE_LENGTH;
+    while (position + PNG_CHUNK_OVERHEAD <= size)
+    {
+        const int chunkLength = static_cast<int>(readBigEndian(bytes + position));
+        const int payload = position + 8;
+        if (chunkLength < 0 || chunkLength > size - position - PNG_CHUNK_OVERHEAD)
+            break;
+
+        const QByteArray type = data.mid(position + 4, 4);
+        if (type == "IHDR" && chunkLength >= 13)
+        {
+            canvasWidth = static_cast<int>(readBigEndian(bytes + payload));
+            canvasHeight = static_cast<int>(readBigEndian(bytes + payload + 4));
+            // Gray with alpha and RGBA
+            isOpaque = bytes[payload + 9] != 4 && bytes[payload + 9] != 6;
+        }
+        else if (type == "tRNS")
+        {
+            isOpaque = false;
+        }
+        else if (type == "acTL")
+        {
+            isAnimated = true;
+        }
+        else if (type == "IEND")
+        {
+            break;
+        }
+
+        // The default image may come before the first frame control without being part of the animation
+        if ((type == "fcTL" || type == "IDAT") && index.headerLength == 0)
+            index.headerLength = position;
+
+        if (type == "fcTL" && chunkLength >= 26)
+        {
+            const int width = static_cast<int>(readBigEndian(bytes + payload + 4));
+            const int height = static_cast<int>(readBigEndian(bytes + payload + 8));
+            const int left = static_cast<int>(readBigEndian(bytes + payload + 12));
+            const int top = static_cast<int>(readBigEndian(bytes + payload + 16));
+            const uchar disposeOp = bytes[payload + 24];
+            const uchar blendOp = bytes[payload + 25];
+
+            // Like GIF, a frame restored to what came before it can't start a stream. A frame that is blended over
+            // what's there only hides it all if nothing in it is see-through
+            const bool coversCanvas = left == 0 && top == 0 && width == canvasWidth && height == canvasHeight;
+            if (index.frameOffsets.isEmpty() || (coversCanvas && disposeOp != 2 && (blendOp == 0 || isOpaque)))
+                index.keyframes.append(index.frameOffsets.length());
+
+            index.frameOffsets.append(position);
+        }
+
+        position = payload + chunkLength + 4;
+    }
+
+    return isAnimated && !index.frameOffsets.isEmpty();
+}
+
+bool QVAnimationIndex::parseWebP(const QByteArray &data, QVAnimationIndex &index)
+{
+    const auto *bytes = reinterpret_cast<const uchar *>(data.constData());
+    const int size = data.size();
+    if (size < 12 || !data.startsWith("RIFF") || data.mid(8, 4) != "WEBP")
+        return false;
+
+    int canvasWidth = 0;
+    int canvasHeight = 0;
+
+    index.container = Container::WebP;
+
+    int position = 12;
+    while (position + 8 <= size)
+    {
+        const QByteArray fourCc = data.mid(position, 4);
+        const int chunkSize = static_cast<int>(readLittleEndian(bytes + position + 4, 4));
+        const int payload = position + 8;
+        if (chunkSize < 0 || chunkSize > size - payload)
+            break;
+
+        if (fourCc == "VP8X" && chunkSize >= 10)
+        {
+            canvasWidth = static_cast<int>(readLittleEndian(bytes + payload + 4, 3)) + 1;
+            canvasHeight = static_cast<int>(readLittleEndian(bytes + payload + 7, 3)) + 1;
+        }
+        else if (fourCc == "ANMF" && chunkSize >= 16)
+        {
+            if (index.frameOffsets.isEmpty())
+                index.headerLength = position;
+
+            const int left = static_cast<int>(readLittleEndian(bytes + payload, 3)) * 2;
+            const int top = static_cast<int>(readLittleEndian(bytes + payload + 3, 3)) * 2;
+            const int width = static_cast<int>(readLittleEndian(bytes + payload + 6, 3)) + 1;
+            const int height = static_cast<int>(readLittleEndian(bytes + payload + 9, 3)) + 1;
+            const bool isBlended = !(bytes[payload + 15] & 0x02);
+
+            // Only lossless frames without their alpha bit set, or lossy ones without an ALPH chunk, are fully opaque
+            bool hasAlpha = true;
+            const int frameData = payload + 16;
+            if (frameData + 8 <= payload + chunkSize)
+            {
+                const QByteArray frameFourCc = data.mid(frameData, 4);
+                if (frameFourCc == "VP8 ")
+                    hasAlpha = false;
+                else if (frameFourCc == "VP8L" && frameData + 13 <= payload + chunkSize)
+                    hasAlpha = (readLittleEndian(bytes + frameData + 9, 4) >> 28) & 0x01;
+            }
+
+            const bool coversCanvas = left == 0 && top == 0 && width >= canvasWidth && height >= canvasHeight;
+            if (index.frameOffsets.isEmpty() || (coversCanvas && (!isBlended || !hasAlpha)))
+                index.keyframes.append(index.frameOffsets.length());
+
+            index.frameOffsets.append(position);
+        }
+
+        // Chunks are padded to an even length
+        position = payload + chunkSize + (chunkSize & 1);
+    }
+
+    return !index.frameOffsets.isEmpty();
+}
@@ -0,0 +1,46 @@
+#ifndef QVANIMATIONINDEX_H
+#define QVANIMATIONINDEX_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Where each frame of a GIF, APNG or animated WebP starts, and which frames are keyframes: ones that cover
+// the whole canvas without blending into what was there, so decoding can start from them.
+// Only the container is parsed, nothing is decoded. Other formats get an empty index.
+class QVAnimationIndex
+{
+public:
+    static QVAnimationIndex build(const QByteArray &data);
+
+    bool isEmpty() const { return frameOffsets.isEmpty(); }
+    int frameCount() const { return frameOffsets.length(); }
+
+    // The last keyframe at or before frameNumber
+    int getKeyframe(int frameNumber) const;
+
+    // A file of the same format holding the frames from keyframe on, which decodes to the same pictures
+    QByteArray getStreamFrom(const QByteArray &data, int keyframe) const;
+
+private:
+    enum class Container
+    {
+        None,
+        Gif,
+        Png,
+        WebP
+    };
+
+    static bool parseGif(const QByteArray &data, QVAnimationIndex &index);
+    static bool parseApng(const QByteArray &data, QVAnimationIndex &index);
+    static bool parseWebP(const QByteArray &data, QVAnimationIndex &index);
+
+    Container container = Container::None;
+
+    // Everything before the first frame, which every stream needs
+    int headerLength = 0;
+
+    QVector<int> frameOffsets;
+    QVector<int> keyframes;
+};
+
+#endif // QVANIMATIONINDEX_H
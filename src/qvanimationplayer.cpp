@@ -0,0 +1,605 @@
+#include "qvanimationplayer.h"
+
+#include <QImageReader>
+#include <QBuffer>
+#include <QFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QList>
+
+namespace
+{
+    // How far the decoder may run ahead, in frames and in memory, whichever comes first.
+    // A single frame bigger than the byte limit is still decoded on its own
+    const int MAX_QUEUED_FRAMES = 8;
+    const qint64 MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+
+    qint64 getFrameBytes(const QImage &image)
+    {
+        return static_cast<qint64>(image.bytesPerLine()) * image.height();
+    }
+
+    // Same formats the rest of the viewer works in, converted on the worker rather than the GUI thread
+    QImage convertToFrameFormat(const QImage &image)
+    {
+        return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    }
+}
+
+// Shared between the player and one decoder, a new one is made every time decoding starts over
+// so a decoder that's still finishing its last frame never touches the next one's frames
+class QVAnimationPlayer::DecodeQueue
+{
+public:
+    QMutex mutex;
+    QWaitCondition changed;
+    QList<Frame> frames;
+    qint64 queuedBytes = 0;
+    bool cancelled = false;
+    bool finished = false;
+
+    QAtomicInt signalPending;
+};
+
+class QVAnimationPlayer::Decoder : public QRunnable
+{
+public:
+    Decoder(QVAnimationPlayer *player, const QSharedPointer<DecodeQueue> &queue, const QByteArray &data, const QByteArray &stream,
+            const QByteArray &format, int firstFrameNumber, int skipUntilFrame) :
+        player(player), queue(queue), data(data), stream(stream), format(format),
+        firstFrameNumber(firstFrameNumber), skipUntilFrame(skipUntilFrame) {}
+
+    void run() override
+    {
+        // The stream may start at a keyframe partway in, loops after the first always start from the whole file
+        QBuffer buffer;
+        buffer.setData(stream);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer, format);
+
+        int frameNumber = firstFrameNumber;
+        bool hasReadFrame = false;
+        while (true)
+        {
+            {
+                QMutexLocker locker(&queue->mutex);
+                while (!queue->cancelled && !queue->frames.isEmpty() &&
+                       (queue->frames.length() >= MAX_QUEUED_FRAMES || queue->queuedBytes >= MAX_QUEUED_BYTES))
+                    queue->changed.wait(&queue->mutex);
+
+                if (queue->cancelled)
+                    return;
+            }
+
+            QElapsedTimer decodeTimer;
+            decodeTimer.start();
+
+            QImage image;
+            if (!reader.read(&image))
+            {
+                // Nothing at all means the data is broken, there's no loop to go back to
+                if (!hasReadFrame)
+                {
+                    QMutexLocker locker(&queue->mutex);
+                    queue->finished = true;
+                    queue->changed.wakeAll();
+                    break;
+                }
+
+                // End of a loop. Not every plugin can jump back to the start, so begin again on a fresh reader
+                reader.setDevice(nullptr);
+                buffer.close();
+                buffer.setData(data);
+                buffer.open(QIODevice::ReadOnly);
+                reader.setDevice(&buffer);
+                reader.setFormat(format);
+                frameNumber = 0;
+                hasReadFrame = false;
+                skipUntilFrame = 0;
+                continue;
+            }
+            hasReadFrame = true;
+
+            // Frames before a seek target are only decoded to build up the picture
+            if (frameNumber < skipUntilFrame)
+            {
+                frameNumber++;
+                continue;
+            }
+            skipUntilFrame = 0;
+
+            Frame frame;
+            frame.image = convertToFrameFormat(image);
+            frame.delay = reader.nextImageDelay();
+            frame.number = frameNumber++;
+            frame.decodeTime = decodeTimer.nsecsElapsed();
+
+            {
+                QMutexLocker locker(&queue->mutex);
+                queue->queuedBytes += getFrameBytes(frame.image);
+                queue->frames.append(frame);
+                queue->changed.wakeAll();
+            }
+
+            // Coalesced, the player takes whatever is queued when it gets around to it
+            if (queue->signalPending.testAndSetOrdered(0, 1))
+                QMetaObject::invokeMethod(player, "framesAvailable", Qt::QueuedConnection);
+        }
+
+        if (queue->signalPending.testAndSetOrdered(0, 1))
+            QMetaObject::invokeMethod(player, "framesAvailable", Qt::QueuedConnection);
+    }
+
+private:
+    QVAnimationPlayer *player;
+    QSharedPointer<DecodeQueue> queue;
+    QByteArray data;
+    QByteArray stream;
+    QByteArray format;
+    int firstFrameNumber;
+    int skipUntilFrame;
+};
+
+QVAnimationPlayer::QVAnimationPlayer(QObject *parent) : QObject(parent)
+{
+    valid = false;
+    reportedFrameCount = 0;
+    loopCount = -1;
+    isIndexBuilt = false;
+
+    isKeepingAllFrames = false;
+    loopLength = -1;
+    loopsPlayed = 0;
+
+    playerState = State::NotRunning;
+    percentSpeed = 100;
+    isWaitingForFrame = false;
+    seekTarget = -1;
+    nextFrameDue = 0;
+    lastFrameShownAt = -1;
+    scheduledDelay = 0;
+
+    // A stale decoder can still be finishing a frame when the next animation starts
+    threadPool.setMaxThreadCount(2);
+
+    frameTimer.setSingleShot(true);
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer, &QTimer::timeout, this, &QVAnimationPlayer::frameTimerTimeout);
+
+    clock.start();
+}
+
+QVAnimationPlayer::~QVAnimationPlayer()
+{
+    // Decoders call back into us, so none may outlive the player
+    stopDecoder();
+    threadPool.waitForDone();
+}
+
+QVAnimationPlayer::Preload QVAnimationPlayer::preload(const QString &fileName, const QByteArray &data, const QByteArray &format,
+                                                     qint64 maxFrameBytes)
+{
+    Preload preloaded;
+
+    // Only the header is read to find out whether this animates at all
+    QBuffer buffer;
+    QImageReader probe;
+    if (!data.isEmpty())
+    {
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+        probe.setDevice(&buffer);
+    }
+    else
+    {
+        probe.setFileName(fileName);
+    }
+    if (!format.isEmpty())
+        probe.setFormat(format);
+
+    preloaded.valid = probe.canRead();
+    preloaded.format = probe.format();
+    preloaded.frameCount = probe.imageCount();
+    preloaded.loopCount = probe.loopCount();
+
+    if (!preloaded.valid || preloaded.frameCount == 1)
+        return preloaded;
+
+    if (!data.isEmpty())
+    {
+        preloaded.data = data;
+    }
+    else
+    {
+        QFile file(fileName);
+        if (file.open(QIODevice::ReadOnly))
+            preloaded.data = file.readAll();
+        if (preloaded.data.isEmpty())
+        {
+            preloaded.valid = false;
+            return preloaded;
+        }
+    }
+
+    if (maxFrameBytes <= 0)
+        return preloaded;
+
+    QBuffer frameBuffer;
+    frameBuffer.setData(preloaded.data);
+    frameBuffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&frameBuffer, preloaded.format);
+
+    qint64 frameBytes = 0;
+    QElapsedTimer decodeTimer;
+    decodeTimer.start();
+    QImage image;
+    while (preloaded.frames.length() < MAX_QUEUED_FRAMES && reader.read(&image))
+    {
+        Frame frame;
+        frame.image = convertToFrameFormat(image);
+        frame.delay = reader.nextImageDelay();
+        frame.number = preloaded.frames.length();
+        frame.decodeTime = decodeTimer.nsecsElapsed();
+        decodeTimer.restart();
+
+        frameBytes += getFrameBytes(frame.image);
+        if (frameBytes > maxFrameBytes)
+            break;
+
+        preloaded.frames.append(frame);
+    }
+
+    return preloaded;
+}
+
+qint64 QVAnimationPlayer::Preload::byteCount() const
+{
+    qint64 bytes = data.size();
+    for (const auto &frame : frames)
+        bytes += getFrameBytes(frame.image);
+    return bytes;
+}
+
+void QVAnimationPlayer::load(const Preload &preloaded)
+{
+    clear();
+
+    data = preloaded.data;
+    detectedFormat = preloaded.format;
+    valid = preloaded.valid;
+    reportedFrameCount = preloaded.frameCount;
+    loopCount = preloaded.loopCount;
+    preloadedFrames = preloaded.frames;
+}
+
+void QVAnimationPlayer::load(const QString &fileName, const QByteArray &data, const QByteArray &format)
+{
+    load(preload(fileName, data, format));
+}
+
+void QVAnimationPlayer::clear()
+{
+    stop();
+
+    data.clear();
+    detectedFormat.clear();
+    valid = false;
+    reportedFrameCount = 0;
+    loopCount = -1;
+    index = QVAnimationIndex();
+    isIndexBuilt = false;
+    preloadedFrames.clear();
+    stats = Stats();
+
+    currentFrame = Frame();
+    currentFramePixmap = QPixmap();
+    keptFrames.clear();
+    loopLength = -1;
+}
+
+void QVAnimationPlayer::setKeepAllFrames(bool keepAllFrames)
+{
+    isKeepingAllFrames = keepAllFrames;
+    if (!isKeepingAllFrames)
+    {
+        keptFrames.clear();
+        loopLength = -1;
+    }
+}
+
+void QVAnimationPlayer::start()
+{
+    if (!valid || data.isEmpty() || playerState == State::Running)
+        return;
+
+    stop();
+    currentFrame = Frame();
+    currentFramePixmap = QPixmap();
+    loopsPlayed = 0;
+
+    buildIndex();
+    if (loopLength < 0)
+    {
+        // Preloaded frames go up first while the decoder starts from the keyframe before the next one
+        const int preloadedCount = preloadedFrames.length();
+        startDecoder(index.getKeyframe(preloadedCount), preloadedCount);
+
+        QMutexLocker locker(&decodeQueue->mutex);
+        for (int i = preloadedCount - 1; i >= 0; i--)
+        {
+            decodeQueue->frames.prepend(preloadedFrames.at(i));
+            decodeQueue->queuedBytes += getFrameBytes(preloadedFrames.at(i).image);
+        }
+        preloadedFrames.clear();
+    }
+
+    playerState = State::Running;
+    nextFrameDue = clock.elapsed();
+
+    // The first frame goes up right away, even if that means waiting for it
+    if (advance(true))
+        scheduleNextFrame();
+}
+
+void QVAnimationPlayer::stop()
+{
+    frameTimer.stop();
+    stopDecoder();
+    seekTarget = -1;
+    playerState = State::NotRunning;
+}
+
+void QVAnimationPlayer::setPaused(bool paused)
+{
+    if (paused)
+    {
+        if (playerState != State::Running)
+            return;
+
+        frameTimer.stop();
+        isWaitingForFrame = false;
+        playerState = State::Paused;
+    }
+    else if (playerState == State::Paused)
+    {
+        playerState = State::Running;
+        lastFrameShownAt = -1;
+        nextFrameDue = clock.elapsed();
+        scheduleNextFrame();
+    }
+    else if (playerState == State::NotRunning)
+    {
+        // Finished playing, resuming starts over
+        start();
+    }
+}
+
+void QVAnimationPlayer::jumpToNextFrame()
+{
+    if (!valid || data.isEmpty())
+        return;
+
+    // Past the last loop, stepping goes around again
+    if (!decodeQueue && loopLength < 0)
+        startDecoder();
+
+    if (!advance(true) || playerState != State::Running)
+        return;
+
+    frameTimer.stop();
+    nextFrameDue = clock.elapsed();
+    scheduleNextFrame();
+}
+
+void QVAnimationPlayer::jumpToFrame(int frameNumber)
+{
+    if (!valid || data.isEmpty())
+        return;
+
+    buildIndex();
+    frameNumber = frameCount() > 0 ? qBound(0, frameNumber, frameCount() - 1) : qMax(0, frameNumber);
+    frameTimer.stop();
+
+    if (loopLength > 0)
+    {
+        currentFrame = keptFrames.at(qMin(frameNumber, loopLength - 1));
+        currentFramePixmap = QPixmap();
+        lastFrameShownAt = -1;
+        emit updated(currentFrame.image.rect());
+
+        nextFrameDue = clock.elapsed();
+        scheduleNextFrame();
+        return;
+    }
+
+    startDecoder(index.getKeyframe(frameNumber), frameNumber);
+    seekTarget = frameNumber;
+    isWaitingForFrame = true;
+}
+
+void QVAnimationPlayer::setSpeed(int percentSpeed)
+{
+    this->percentSpeed = qMax(0, percentSpeed);
+
+    if (playerState != State::Running)
+        return;
+
+    frameTimer.stop();
+    nextFrameDue = clock.elapsed();
+    scheduleNextFrame();
+}
+
+QPixmap QVAnimationPlayer::currentPixmap() const
+{
+    // Made on first use, a frame that's only ever scaled doesn't need one
+    if (currentFramePixmap.isNull() && !currentFrame.image.isNull())
+        currentFramePixmap = QPixmap::fromImage(currentFrame.image);
+
+    return currentFramePixmap;
+}
+
+int QVAnimationPlayer::nextFrameDelay() const
+{
+    if (percentSpeed == 0)
+        return 0;
+
+    return currentFrame.delay * 100 / percentSpeed;
+}
+
+void QVAnimationPlayer::startDecoder(int firstFrameNumber, int skipUntilFrame)
+{
+    stopDecoder();
+
+    const QByteArray stream = firstFrameNumber > 0 ? index.getStreamFrom(data, firstFrameNumber) : data;
+    decodeQueue = QSharedPointer<DecodeQueue>::create();
+    threadPool.start(new Decoder(this, decodeQueue, data, stream, detectedFormat, firstFrameNumber, skipUntilFrame));
+}
+
+void QVAnimationPlayer::buildIndex()
+{
+    if (isIndexBuilt)
+        return;
+
+    // Only walks the container, which is quick even for thousands of frames
+    index = QVAnimationIndex::build(data);
+    isIndexBuilt = true;
+
+    if (reportedFrameCount <= 0 && !index.isEmpty())
+        reportedFrameCount = index.frameCount();
+}
+
+void QVAnimationPlayer::stopDecoder()
+{
+    isWaitingForFrame = false;
+    if (!decodeQueue)
+        return;
+
+    {
+        QMutexLocker locker(&decodeQueue->mutex);
+        decodeQueue->cancelled = true;
+        decodeQueue->changed.wakeAll();
+    }
+    decodeQueue.reset();
+}
+
+bool QVAnimationPlayer::takeFrame(Frame &frame, bool wait)
+{
+    // Once a whole loop is kept there's nothing left to decode
+    if (loopLength > 0)
+    {
+        frame = keptFrames.at((currentFrame.number + 1) % loopLength);
+        return true;
+    }
+
+    if (!decodeQueue)
+        return false;
+
+    QMutexLocker locker(&decodeQueue->mutex);
+    while (wait && decodeQueue->frames.isEmpty() && !decodeQueue->finished)
+        decodeQueue->changed.wait(&decodeQueue->mutex);
+
+    if (decodeQueue->frames.isEmpty())
+        return false;
+
+    frame = decodeQueue->frames.takeFirst();
+    decodeQueue->queuedBytes -= getFrameBytes(frame.image);
+    decodeQueue->changed.wakeAll();
+
+    stats.decodedFrames++;
+    stats.decodeTime += frame.decodeTime;
+    stats.maxDecodeTime = qMax(stats.maxDecodeTime, frame.decodeTime);
+    return true;
+}
+
+bool QVAnimationPlayer::advance(bool wait, qint64 dueTime)
+{
+    Frame frame;
+    if (!takeFrame(frame, wait))
+    {
+        // framesAvailable picks this up again when the decoder catches up
+        if (!wait)
+            isWaitingForFrame = true;
+        return false;
+    }
+
+    // Frame 0 after any other is the start of another loop, unless it was sought out
+    const bool isSeekResult = seekTarget >= 0;
+    seekTarget = -1;
+    if (!isSeekResult && frame.number == 0 && currentFrame.number >= 0)
+    {
+        if (isKeepingAllFrames && loopLength < 0 && keptFrames.length() == currentFrame.number + 1)
+        {
+            loopLength = keptFrames.length();
+            stopDecoder();
+        }
+
+        loopsPlayed++;
+        if (!wait && loopCount >= 0 && loopsPlayed > loopCount)
+        {
+            stop();
+            return false;
+        }
+    }
+
+    // Only kept while they come in order, a seek leaves a gap until playback gets back to where the kept ones end
+    if (isKeepingAllFrames && loopLength < 0 && frame.number == keptFrames.length() && currentFrame.number == frame.number - 1)
+        keptFrames.append(frame);
+
+    // Compared against the delay the last frame was scheduled with, which already has the speed in it
+    const qint64 now = clock.elapsed();
+    const bool isOnSchedule = dueTime >= 0 && !isSeekResult;
+    if (isOnSchedule && lastFrameShownAt >= 0 && scheduledDelay > 0)
+    {
+        stats.timedFrames++;
+        stats.targetTime += scheduledDelay;
+        stats.actualTime += now - lastFrameShownAt;
+        if (now - dueTime >= scheduledDelay)
+            stats.droppedFrames++;
+    }
+    lastFrameShownAt = isOnSchedule ? now : -1;
+
+    currentFrame = frame;
+    currentFramePixmap = QPixmap();
+    emit updated(currentFrame.image.rect());
+    return true;
+}
+
+void QVAnimationPlayer::scheduleNextFrame()
+{
+    if (playerState != State::Running || percentSpeed == 0)
+        return;
+
+    // Timed from when this frame was due rather than when it went up, so lateness doesn't add up over a loop.
+    // If even the next frame is already overdue, start timing again from now instead of rushing to catch up
+    const qint64 now = clock.elapsed();
+    scheduledDelay = nextFrameDelay();
+    nextFrameDue += scheduledDelay;
+    if (nextFrameDue < now)
+        nextFrameDue = now;
+
+    frameTimer.start(static_cast<int>(nextFrameDue - now));
+}
+
+void QVAnimationPlayer::framesAvailable()
+{
+    if (decodeQueue)
+        decodeQueue->signalPending.storeRelease(0);
+
+    if (!isWaitingForFrame)
+        return;
+
+    // The frame is going up late, so the next one is timed from now
+    isWaitingForFrame = false;
+    const qint64 dueTime = nextFrameDue;
+    nextFrameDue = clock.elapsed();
+    if (advance(false, playerState == State::Running ? dueTime : -1))
+        scheduleNextFrame();
+}
+
+void QVAnimationPlayer::frameTimerTimeout()
+{
+    if (advance(false, nextFrameDue))
+        scheduleNextFrame();
+}
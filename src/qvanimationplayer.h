@@ -0,0 +1,190 @@
+#ifndef QVANIMATIONPLAYER_H
+#define QVANIMATIONPLAYER_H
+
+#include "qvanimationindex.h"
+
+#include <QObject>
+#include <QImage>
+#include <QPixmap>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QSharedPointer>
+#include <QVector>
+
+// Plays animations with the frames decoded ahead of time on a worker, so a busy GUI thread
+// doesn't hold up decoding and a slow frame to decode doesn't hold up the GUI.
+// A small queue of decoded frames runs ahead of what is on screen, and each frame is due at a time
+// measured on a monotonic clock from when the one before it was due, so late frames don't push back the ones after them.
+// GIFs and WebPs are indexed when they first play, so seeking only decodes from the keyframe before the target.
+class QVAnimationPlayer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class State
+    {
+        NotRunning,
+        Paused,
+        Running
+    };
+
+    struct Frame
+    {
+        QImage image;
+        int delay = 0;
+        int number = -1;
+
+        // Reading and converting it on the worker, in ns
+        qint64 decodeTime = 0;
+    };
+
+    // How playback has kept up since the animation was loaded. Intervals only count between two frames
+    // that both went up on schedule, so pauses, steps and seeks don't skew them
+    struct Stats
+    {
+        int timedFrames = 0;
+
+        // In ms, what the frame delays at the current speed asked for and the time that actually passed
+        qint64 targetTime = 0;
+        qint64 actualTime = 0;
+
+        // Frames that went up a whole frame late, which a player skipping frames to keep up would have dropped
+        int droppedFrames = 0;
+
+        // In ns, frames skipped on the way to a seek target aren't counted
+        int decodedFrames = 0;
+        qint64 decodeTime = 0;
+        qint64 maxDecodeTime = 0;
+    };
+
+    // Everything load() needs, read ahead of time on any thread. Animations can come with their first frames
+    // already decoded, which the player shows while its own decoder catches up
+    struct Preload
+    {
+        bool valid = false;
+        QByteArray format;
+        int frameCount = 0;
+        int loopCount = -1;
+        // Must own its bytes rather than wrap someone else's with fromRawData, since the image cache charges for them
+        // and the player and exporter keep them past the read
+        QByteArray data;
+        QVector<Frame> frames;
+
+        qint64 byteCount() const;
+    };
+
+    explicit QVAnimationPlayer(QObject *parent = nullptr);
+    ~QVAnimationPlayer() override;
+
+    // Reads the animation from data if there is any, otherwise from the file. The file is only read into
+    // memory when it turns out to have several frames, and is never held open.
+    // An empty format lets QImageReader work it out from the contents.
+    // Up to maxFrameBytes of leading frames are decoded, never more than the player would queue up itself
+    static Preload preload(const QString &fileName, const QByteArray &data = QByteArray(), const QByteArray &format = QByteArray(),
+                           qint64 maxFrameBytes = 0);
+
+    void load(const Preload &preloaded);
+    void load(const QString &fileName, const QByteArray &data = QByteArray(), const QByteArray &format = QByteArray());
+    void clear();
+
+    bool isValid() const { return valid; }
+    QByteArray format() const { return detectedFormat; }
+
+    // The whole file, only held for animations
+    const QByteArray &getData() const { return data; }
+
+    // 0 when the format can't tell without decoding everything
+    int frameCount() const { return reportedFrameCount; }
+
+    // Keeps every frame once it has been decoded, so later loops don't decode again.
+    // Only worth it when the whole animation is known to fit in memory
+    void setKeepAllFrames(bool keepAllFrames);
+
+    void start();
+    void stop();
+    void setPaused(bool paused);
+    void jumpToNextFrame();
+
+    // Shows the frame once it's decoded, without waiting for it
+    void jumpToFrame(int frameNumber);
+
+    // Percent of normal speed, 0 holds the current frame
+    void setSpeed(int percentSpeed);
+    int speed() const { return percentSpeed; }
+
+    State state() const { return playerState; }
+
+    int currentFrameNumber() const { return currentFrame.number; }
+    const QImage &currentImage() const { return currentFrame.image; }
+    QPixmap currentPixmap() const;
+
+    // How long the current frame stays up at the current speed, in ms
+    int nextFrameDelay() const;
+
+    const Stats &playbackStats() const { return stats; }
+
+signals:
+    void updated(const QRect &rect);
+
+private:
+    class DecodeQueue;
+    class Decoder;
+
+    void startDecoder(int firstFrameNumber = 0, int skipUntilFrame = 0);
+    void buildIndex();
+    void stopDecoder();
+
+    bool takeFrame(Frame &frame, bool wait);
+
+    // dueTime is when the frame was due in timed playback, -1 for frames shown on request
+    bool advance(bool wait, qint64 dueTime = -1);
+    void scheduleNextFrame();
+
+private slots:
+    void framesAvailable();
+    void frameTimerTimeout();
+
+private:
+    QByteArray data;
+    QByteArray detectedFormat;
+    bool valid;
+    int reportedFrameCount;
+    int loopCount;
+
+    QVAnimationIndex index;
+    bool isIndexBuilt;
+
+    // Handed over by load(), queued ahead of the decoder's first frame when playback starts
+    QVector<Frame> preloadedFrames;
+
+    QThreadPool threadPool;
+    QSharedPointer<DecodeQueue> decodeQueue;
+
+    Frame currentFrame;
+    mutable QPixmap currentFramePixmap;
+
+    // Frames in order as they were first shown, complete once loopLength is known
+    bool isKeepingAllFrames;
+    QVector<Frame> keptFrames;
+    int loopLength;
+    int loopsPlayed;
+
+    State playerState;
+    int percentSpeed;
+    bool isWaitingForFrame;
+
+    // The frame a seek is waiting for, it doesn't count as the next one in sequence
+    int seekTarget;
+
+    QTimer frameTimer;
+    QElapsedTimer clock;
+    qint64 nextFrameDue;
+
+    // For the stats, -1 when the frame on screen didn't go up on schedule
+    qint64 lastFrameShownAt;
+    int scheduledDelay;
+    Stats stats;
+};
+
+#endif // QVANIMATIONPLAYER_H
@@ -111,7 +111,9 @@ void QVApplication::pickFile(MainWindow *parent)
     auto *fileDialog = new QFileDialog(parent, tr("Open..."));
     fileDialog->setDirectory(settings.value("lastFileDialogDir", QDir::homePath()).toString());
     fileDialog->setFileMode(QFileDialog::ExistingFiles);
-    fileDialog->setNameFilters(qvApp->getNameFilterList());
+    QStringList nameFilters = qvApp->getNameFilterList();
+    nameFilters.insert(1, tr("Image Archives") + " (*.zip *.cbz)");
+    fileDialog->setNameFilters(nameFilters);
     if (parent)
         fileDialog->setWindowModality(Qt::WindowModal);
 
@@ -0,0 +1,441 @@
+#include "qvarchive.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QtEndian>
+#include <limits>
+
+#ifdef ZLIB_LOADED
+#include <zlib.h>
+#endif
+
+#include <QDebug>
+
+namespace
+{
+    const quint32 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+    const quint32 CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+    const quint32 END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+    const quint32 ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06064b50;
+    const quint32 ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+
+    const int LOCAL_HEADER_SIZE = 30;
+    const int CENTRAL_HEADER_SIZE = 46;
+    const int END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+    const int ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE = 56;
+    const int ZIP64_LOCATOR_SIZE = 20;
+    const int MAX_COMMENT_SIZE = 0xFFFF;
+
+    const quint16 METHOD_STORED = 0;
+    const quint16 METHOD_DEFLATED = 8;
+
+    const quint16 FLAG_ENCRYPTED = 0x0001;
+    const quint16 FLAG_UTF8 = 0x0800;
+
+    const quint16 EXTRA_ZIP64 = 0x0001;
+    const quint16 EXTRA_EXTENDED_TIMESTAMP = 0x5455;
+
+    // A handful of archives is plenty to page back and forth between batches
+    const int MAX_CACHED_ARCHIVES = 4;
+
+    // Deflate can't do better than about 1032:1, so a larger claimed size is a lie.
+    // The output buffer starts small and grows with what inflate actually produces
+    const qint64 MAX_DEFLATE_RATIO = 1032;
+    const qint64 INITIAL_INFLATE_BUFFER_SIZE = 1024 * 1024;
+
+    quint16 read16(const uchar *data) { return qFromLittleEndian<quint16>(data); }
+    quint32 read32(const uchar *data) { return qFromLittleEndian<quint32>(data); }
+    quint64 read64(const uchar *data) { return qFromLittleEndian<quint64>(data); }
+
+    qint64 dosDateTimeToMSecs(quint16 dosDate, quint16 dosTime)
+    {
+        const QDate date(1980 + (dosDate >> 9), (dosDate >> 5) & 0xF, dosDate & 0x1F);
+        const QTime time(dosTime >> 11, (dosTime >> 5) & 0x3F, (dosTime & 0x1F) * 2);
+        if (!date.isValid() || !time.isValid())
+            return -1;
+
+        return QDateTime(date, time).toMSecsSinceEpoch();
+    }
+
+    struct CachedArchive
+    {
+        QString path;
+        qint64 lastModified;
+        qint64 size;
+        QSharedPointer<QVArchive> archive;
+    };
+
+    QMutex cacheMutex;
+    QList<CachedArchive> archiveCache;
+}
+
+QVArchive::QVArchive(const QString &archivePath) : archivePath(archivePath), file(archivePath)
+{
+    mappedData = nullptr;
+    fileSize = 0;
+}
+
+QVArchive::~QVArchive()
+{
+    if (mappedData)
+        file.unmap(const_cast<uchar *>(mappedData));
+}
+
+QSharedPointer<QVArchive> QVArchive::open(const QString &archivePath)
+{
+    const QFileInfo fileInfo(archivePath);
+    const qint64 lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    const QString absolutePath = fileInfo.absoluteFilePath();
+
+    QMutexLocker locker(&cacheMutex);
+    for (int i = 0; i < archiveCache.length(); i++)
+    {
+        const CachedArchive &cached = archiveCache.at(i);
+        if (cached.path != absolutePath)
+            continue;
+
+        // Reparse if the archive was replaced since it was indexed
+        if (cached.lastModified != lastModified || cached.size != fileInfo.size())
+        {
+            archiveCache.removeAt(i);
+            break;
+        }
+
+        archiveCache.move(i, 0);
+        return archiveCache.constFirst().archive;
+    }
+
+    QSharedPointer<QVArchive> archive(new QVArchive(absolutePath));
+    if (!archive->readCentralDirectory())
+        return QSharedPointer<QVArchive>();
+
+    archiveCache.prepend({absolutePath, lastModified, fileInfo.size(), archive});
+    while (archiveCache.length() > MAX_CACHED_ARCHIVES)
+        archiveCache.removeLast();
+
+    return archive;
+}
+
+bool QVArchive::isArchive(const QString &filePath)
+{
+    // Check the name first, this is called for every folder during a scan
+    if (!filePath.endsWith(".zip", Qt::CaseInsensitive) && !filePath.endsWith(".cbz", Qt::CaseInsensitive))
+        return false;
+
+    return QFileInfo(filePath).isFile();
+}
+
+bool QVArchive::splitPath(const QString &path, QString &archivePath, QString &entryName)
+{
+    const QStringList suffixes = {".zip/", ".cbz/"};
+    for (const QString &suffix : suffixes)
+    {
+        int index = path.indexOf(suffix, 0, Qt::CaseInsensitive);
+        while (index != -1)
+        {
+            const int archivePathLength = index + suffix.length() - 1;
+            if (QFileInfo(path.left(archivePathLength)).isFile())
+            {
+                archivePath = path.left(archivePathLength);
+                entryName = path.mid(archivePathLength + 1);
+                return !entryName.isEmpty();
+            }
+            index = path.indexOf(suffix, index + 1, Qt::CaseInsensitive);
+        }
+    }
+    return false;
+}
+
+bool QVArchive::isArchiveEntryPath(const QString &path)
+{
+    QString archivePath;
+    QString entryName;
+    return splitPath(path, archivePath, entryName);
+}
+
+bool QVArchive::isEntryReadable(const Entry &entry) const
+{
+    if (entry.flags & FLAG_ENCRYPTED)
+        return false;
+
+    if (entry.method == METHOD_STORED)
+        return true;
+
+#ifdef ZLIB_LOADED
+    if (entry.method == METHOD_DEFLATED)
+        return true;
+#endif
+
+    return false;
+}
+
+int QVArchive::indexOf(const QString &entryName) const
+{
+    return entryIndices.value(entryName, -1);
+}
+
+QByteArray QVArchive::readEntry(const QString &entryName) const
+{
+    return readEntry(indexOf(entryName));
+}
+
+QByteArray QVArchive::readEntry(int index) const
+{
+    if (index < 0 || index >= entries.length())
+        return QByteArray();
+
+    const Entry &entry = entries.at(index);
+    if (!isEntryReadable(entry))
+        return QByteArray();
+
+    // The local header repeats the name and has its own extra field, so its length has to be read from it
+    const QByteArray localHeader = readRange(entry.localHeaderOffset, LOCAL_HEADER_SIZE);
+    if (localHeader.size() != LOCAL_HEADER_SIZE)
+        return QByteArray();
+
+    const auto *header = reinterpret_cast<const uchar *>(localHeader.constData());
+    if (read32(header) != LOCAL_HEADER_SIGNATURE)
+        return QByteArray();
+
+    // Only the two 16-bit lengths are added to an offset readRange accepted, so this can't overflow
+    const qint64 dataOffset = entry.localHeaderOffset + LOCAL_HEADER_SIZE + read16(header + 26) + read16(header + 28);
+    if (dataOffset > fileSize)
+        return QByteArray();
+
+    const QByteArray compressedData = readRange(dataOffset, entry.compressedSize);
+    if (compressedData.size() != entry.compressedSize)
+        return QByteArray();
+
+    if (entry.method == METHOD_STORED)
+    {
+        if (entry.uncompressedSize != entry.compressedSize || !isCrcValid(entry, compressedData))
+            return QByteArray();
+        return compressedData;
+    }
+
+#ifdef ZLIB_LOADED
+    if (entry.uncompressedSize < 0 || entry.uncompressedSize > std::numeric_limits<int>::max() - 1 ||
+        entry.uncompressedSize > qMax<qint64>(entry.compressedSize, 1) * MAX_DEFLATE_RATIO)
+    {
+        qWarning() << "Implausible size for" << entry.name << "in" << archivePath;
+        return QByteArray();
+    }
+
+    // Entries are raw deflate streams without a zlib header, hence the negative window size
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return QByteArray();
+
+    // One byte past the promised size is room for inflate to show that the entry is longer than it claims
+    const qint64 bufferLimit = entry.uncompressedSize + 1;
+    QByteArray data(static_cast<int>(qMin(bufferLimit, INITIAL_INFLATE_BUFFER_SIZE)), Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressedData.constData()));
+    stream.avail_in = static_cast<uInt>(compressedData.size());
+
+    int result = Z_OK;
+    while (result == Z_OK)
+    {
+        // Grows only once the output so far has filled it
+        if (stream.total_out == static_cast<uLong>(data.size()))
+        {
+            if (data.size() == bufferLimit)
+                break;
+            data.resize(static_cast<int>(qMin<qint64>(bufferLimit, static_cast<qint64>(data.size()) * 2)));
+        }
+
+        stream.next_out = reinterpret_cast<Bytef *>(data.data()) + stream.total_out;
+        stream.avail_out = static_cast<uInt>(data.size() - static_cast<int>(stream.total_out));
+        result = inflate(&stream, Z_NO_FLUSH);
+    }
+    const uLong totalOut = stream.total_out;
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END || totalOut != static_cast<uLong>(entry.uncompressedSize))
+    {
+        qWarning() << "Failed to inflate" << entry.name << "in" << archivePath;
+        return QByteArray();
+    }
+    data.resize(static_cast<int>(totalOut));
+
+    if (!isCrcValid(entry, data))
+        return QByteArray();
+
+    return data;
+#else
+    return QByteArray();
+#endif
+}
+
+bool QVArchive::isCrcValid(const Entry &entry, const QByteArray &data) const
+{
+#ifdef ZLIB_LOADED
+    if (crc32(0, reinterpret_cast<const Bytef *>(data.constData()), static_cast<uInt>(data.size())) != entry.crc)
+    {
+        qWarning() << "CRC mismatch for" << entry.name << "in" << archivePath;
+        return false;
+    }
+#else
+    // Without zlib there's no CRC-32 to check against
+    Q_UNUSED(entry)
+    Q_UNUSED(data)
+#endif
+    return true;
+}
+
+QByteArray QVArchive::readRange(qint64 offset, qint64 length) const
+{
+    // Offsets and sizes come from the file, and ZIP64 ones are 64-bit, so offset + length could overflow
+    if (offset < 0 || length < 0 || offset > fileSize || length > fileSize - offset || length > std::numeric_limits<int>::max())
+        return QByteArray();
+
+    if (mappedData)
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(mappedData + offset), static_cast<int>(length));
+
+    QMutexLocker locker(&fileMutex);
+    if (!file.seek(offset))
+        return QByteArray();
+
+    return file.read(length);
+}
+
+bool QVArchive::readCentralDirectory()
+{
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    fileSize = file.size();
+    mappedData = file.map(0, fileSize);
+    if (!mappedData)
+        qInfo() << "Couldn't map" << archivePath << "- falling back to reads";
+
+    // The end of central directory record sits behind an optional comment, so scan backwards for it
+    const qint64 tailSize = qMin<qint64>(fileSize, END_OF_CENTRAL_DIRECTORY_SIZE + MAX_COMMENT_SIZE);
+    const QByteArray tail = readRange(fileSize - tailSize, tailSize);
+    if (tail.size() != tailSize || tailSize < END_OF_CENTRAL_DIRECTORY_SIZE)
+        return false;
+
+    const auto *tailData = reinterpret_cast<const uchar *>(tail.constData());
+    int eocdOffset = -1;
+    for (int i = static_cast<int>(tailSize) - END_OF_CENTRAL_DIRECTORY_SIZE; i >= 0; i--)
+    {
+        if (read32(tailData + i) == END_OF_CENTRAL_DIRECTORY_SIGNATURE)
+        {
+            eocdOffset = i;
+            break;
+        }
+    }
+    if (eocdOffset == -1)
+    {
+        qWarning() << "No central directory found in" << archivePath;
+        return false;
+    }
+
+    const uchar *eocd = tailData + eocdOffset;
+    quint64 entryCount = read16(eocd + 10);
+    quint64 centralDirectorySize = read32(eocd + 12);
+    quint64 centralDirectoryOffset = read32(eocd + 16);
+
+    // Large archives move the real values into a ZIP64 record, found through the locator right before
+    if (entryCount == 0xFFFF || centralDirectorySize == 0xFFFFFFFF || centralDirectoryOffset == 0xFFFFFFFF)
+    {
+        const qint64 locatorOffset = fileSize - tailSize + eocdOffset - ZIP64_LOCATOR_SIZE;
+        const QByteArray locator = readRange(locatorOffset, ZIP64_LOCATOR_SIZE);
+        if (locator.size() == ZIP64_LOCATOR_SIZE && read32(reinterpret_cast<const uchar *>(locator.constData())) == ZIP64_LOCATOR_SIGNATURE)
+        {
+            const qint64 zip64Offset = static_cast<qint64>(read64(reinterpret_cast<const uchar *>(locator.constData()) + 8));
+            const QByteArray zip64Record = readRange(zip64Offset, ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE);
+            const auto *zip64Data = reinterpret_cast<const uchar *>(zip64Record.constData());
+            if (zip64Record.size() == ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE && read32(zip64Data) == ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE)
+            {
+                entryCount = read64(zip64Data + 32);
+                centralDirectorySize = read64(zip64Data + 40);
+                centralDirectoryOffset = read64(zip64Data + 48);
+            }
+        }
+    }
+
+    const QByteArray centralDirectory = readRange(static_cast<qint64>(centralDirectoryOffset), static_cast<qint64>(centralDirectorySize));
+    if (centralDirectory.size() != static_cast<qint64>(centralDirectorySize))
+    {
+        qWarning() << "Truncated central directory in" << archivePath;
+        return false;
+    }
+
+    const auto *data = reinterpret_cast<const uchar *>(centralDirectory.constData());
+    const int dataSize = centralDirectory.size();
+    entries.reserve(static_cast<int>(qMin<quint64>(entryCount, static_cast<quint64>(dataSize / CENTRAL_HEADER_SIZE))));
+
+    int offset = 0;
+    while (offset + CENTRAL_HEADER_SIZE <= dataSize && read32(data + offset) == CENTRAL_HEADER_SIGNATURE)
+    {
+        const uchar *header = data + offset;
+        const int nameLength = read16(header + 28);
+        const int extraLength = read16(header + 30);
+        const int commentLength = read16(header + 32);
+        if (offset + CENTRAL_HEADER_SIZE + nameLength + extraLength + commentLength > dataSize)
+            break;
+
+        Entry entry;
+        entry.flags = read16(header + 8);
+        entry.method = read16(header + 10);
+        entry.lastModified = dosDateTimeToMSecs(read16(header + 14), read16(header + 12));
+        entry.crc = read32(header + 16);
+        entry.compressedSize = read32(header + 20);
+        entry.uncompressedSize = read32(header + 24);
+        entry.localHeaderOffset = read32(header + 42);
+
+        const char *name = reinterpret_cast<const char *>(header + CENTRAL_HEADER_SIZE);
+        if (entry.flags & FLAG_UTF8)
+            entry.name = QString::fromUtf8(name, nameLength);
+        else
+            entry.name = QString::fromLocal8Bit(name, nameLength);
+
+        // Extra fields override the sizes and offset marked as overflowed, and may carry a precise timestamp
+        const uchar *extra = header + CENTRAL_HEADER_SIZE + nameLength;
+        int extraOffset = 0;
+        while (extraOffset + 4 <= extraLength)
+        {
+            const quint16 extraId = read16(extra + extraOffset);
+            const int extraSize = read16(extra + extraOffset + 2);
+            const uchar *field = extra + extraOffset + 4;
+            if (extraOffset + 4 + extraSize > extraLength)
+                break;
+
+            if (extraId == EXTRA_ZIP64)
+            {
+                int fieldOffset = 0;
+                if (entry.uncompressedSize == 0xFFFFFFFF && fieldOffset + 8 <= extraSize)
+                {
+                    entry.uncompressedSize = static_cast<qint64>(read64(field + fieldOffset));
+                    fieldOffset += 8;
+                }
+                if (entry.compressedSize == 0xFFFFFFFF && fieldOffset + 8 <= extraSize)
+                {
+                    entry.compressedSize = static_cast<qint64>(read64(field + fieldOffset));
+                    fieldOffset += 8;
+                }
+                if (entry.localHeaderOffset == 0xFFFFFFFF && fieldOffset + 8 <= extraSize)
+                {
+                    entry.localHeaderOffset = static_cast<qint64>(read64(field + fieldOffset));
+                }
+            }
+            else if (extraId == EXTRA_EXTENDED_TIMESTAMP && extraSize >= 5 && (field[0] & 0x01))
+            {
+                entry.lastModified = static_cast<qint64>(static_cast<qint32>(read32(field + 1))) * 1000;
+            }
+
+            extraOffset += 4 + extraSize;
+        }
+
+        offset += CENTRAL_HEADER_SIZE + nameLength + extraLength + commentLength;
+
+        // Folder entries carry no data
+        if (entry.name.isEmpty() || entry.name.endsWith('/'))
+            continue;
+
+        entryIndices.insert(entry.name, entries.length());
+        entries.append(entry);
+    }
+
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef QVARCHIVE_H
+#define QVARCHIVE_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+
+// Read-only view of a ZIP/CBZ archive. The central directory is indexed once,
+// entries are read straight out of a memory mapping of the whole file.
+// Files inside an archive are addressed as "/path/to/archive.cbz/entry/name.jpg".
+class QVArchive
+{
+public:
+    struct Entry
+    {
+        QString name;
+        quint16 flags;
+        quint16 method;
+        quint32 crc;
+        qint64 compressedSize;
+        qint64 uncompressedSize;
+        qint64 localHeaderOffset;
+        qint64 lastModified;
+    };
+
+    ~QVArchive();
+
+    // Shared and cached, so preloading several entries only parses the archive once
+    static QSharedPointer<QVArchive> open(const QString &archivePath);
+
+    static bool isArchive(const QString &filePath);
+
+    static bool splitPath(const QString &path, QString &archivePath, QString &entryName);
+
+    static bool isArchiveEntryPath(const QString &path);
+
+    const QString &getArchivePath() const { return archivePath; }
+
+    const QVector<Entry> &getEntries() const { return entries; }
+
+    bool isEntryReadable(const Entry &entry) const;
+
+    int indexOf(const QString &entryName) const;
+
+    // Stored entries point straight into the mapping without a copy,
+    // so the archive has to outlive the returned data
+    QByteArray readEntry(int index) const;
+    QByteArray readEntry(const QString &entryName) const;
+
+private:
+    explicit QVArchive(const QString &archivePath);
+
+    bool readCentralDirectory();
+
+    QByteArray readRange(qint64 offset, qint64 length) const;
+
+    bool isCrcValid(const Entry &entry, const QByteArray &data) const;
+
+    QString archivePath;
+    mutable QFile file;
+    const uchar *mappedData;
+    qint64 fileSize;
+
+    // Only used when the file couldn't be mapped
+    mutable QMutex fileMutex;
+
+    QVector<Entry> entries;
+    QHash<QString, int> entryIndices;
+};
+
+#endif // QVARCHIVE_H
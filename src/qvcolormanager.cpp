@@ -0,0 +1,642 @@
+#include "qvcolormanager.h"
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+
+#ifdef WIN32_LOADED
+#include "qvwin32functions.h"
+#endif
+
+#include <QColor>
+#include <QColorSpace>
+#include <QColorTransform>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cstring>
+
+#if defined(Q_PROCESSOR_X86) && (defined(Q_CC_GNU) || defined(Q_CC_MSVC))
+#define QV_COLOR_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang need the instruction set enabled per function, MSVC allows the intrinsics anywhere
+#if defined(Q_CC_GNU)
+#define QV_TARGET(isa) __attribute__((target(isa)))
+#else
+#define QV_TARGET(isa)
+#endif
+
+namespace
+{
+    // The table is indexed by linear light and holds linear light, the curves of both profiles are 1D lookups on either side of it.
+    // Most profiles are a curve and a matrix, which leaves nothing but the matrix in the table, so interpolating it is exact up to rounding.
+    // 33 points per axis keeps the error small for the ones that aren't
+    const int GRID_SIZE = 33;
+    const int GRID_STEPS = GRID_SIZE - 1;
+
+    // Positions along an axis are in 4096ths of a cell
+    const int CELL_BITS = 12;
+    const int CELL_SIZE = 1 << CELL_BITS;
+    const int AXIS_LENGTH = GRID_STEPS * CELL_SIZE;
+
+    // The input curves are sampled in 16ths of an 8-bit step, for translucent premultiplied pixels once their alpha is divided out
+    const int INPUT_STEPS = 16;
+    const int INPUT_SIZE = 255 * INPUT_STEPS + 1;
+
+    // Nodes are four 16-bit channels, the fourth unused, so a node is always one aligned 8-byte load
+    const int NODE_CHANNELS = 4;
+    const int R_STRIDE = GRID_SIZE * GRID_SIZE * NODE_CHANNELS;
+    const int G_STRIDE = GRID_SIZE * NODE_CHANNELS;
+    const int B_STRIDE = NODE_CHANNELS;
+
+    // Nodes have 1.0 at NODE_ONE and 0 at NODE_ZERO. Colors outside the display's gamut keep their value instead of being clipped,
+    // clipped nodes would bend the interpolation in every cell along the gamut's edge
+    const int NODE_ONE = 32768;
+    const int NODE_ZERO = 16384;
+    const int OUTPUT_SIZE = NODE_ONE + 1;
+
+    const int MAX_CACHED_LUTS = 8;
+
+    using InstructionSet = QVImageScaler::InstructionSet;
+
+    // Rows per job when splitting an image across the thread pool
+    const int ROWS_PER_JOB = 64;
+
+    // The curves hold all of red, then all of green, then all of blue
+    struct Lut
+    {
+        QColorSpace source;
+        QColorSpace display;
+        // Source values in INPUT_STEPS to positions along the table's axes
+        QVector<int> input;
+        QVector<quint16> nodes;
+        // Linear light in NODE_ONEths to 8-bit display values
+        QVector<uchar> output;
+    };
+
+    QMutex lutCacheMutex;
+    QList<QSharedPointer<const Lut>> lutCache;
+
+    QColorSpace getDisplayColorSpace()
+    {
+        // macOS matches sRGB window contents to the display by itself, elsewhere the system profile is used when there is one
+        static const QColorSpace displayColorSpace = []{
+#ifdef WIN32_LOADED
+            const QColorSpace colorSpace = QColorSpace::fromIccProfile(QVWin32Functions::getDisplayIccProfile());
+            if (colorSpace.isValid())
+                return colorSpace;
+#endif
+            return QColorSpace(QColorSpace::SRgb);
+        }();
+        return displayColorSpace;
+    }
+
+    // A profile that can't be made linear is left as it is, its curve then goes through the table instead
+    QColorSpace getLinearColorSpace(const QColorSpace &colorSpace)
+    {
+        const QColorSpace linear = colorSpace.withTransferFunction(QColorSpace::TransferFunction::Linear);
+        return linear.isValid() ? linear : colorSpace;
+    }
+
+    QSharedPointer<const Lut> buildLut(const QColorSpace &source, const QColorSpace &display)
+    {
+        const QColorSpace linearSource = getLinearColorSpace(source);
+        const QColorSpace linearDisplay = getLinearColorSpace(display);
+
+        QSharedPointer<Lut> lut(new Lut{source, display, QVector<int>(3 * INPUT_SIZE),
+                                        QVector<quint16>(GRID_SIZE * GRID_SIZE * GRID_SIZE * NODE_CHANNELS), QVector<uchar>(3 * OUTPUT_SIZE)});
+
+        // Both sides of the curves have the same primaries, so a gray comes out as what each channel's curve makes of it
+        const QColorTransform toLinear = source.transformationToColorSpace(linearSource);
+        int *input = lut->input.data();
+        for (int i = 0; i < INPUT_SIZE; i++)
+        {
+            const quint16 value = static_cast<quint16>(qRound(i * 65535.0 / (INPUT_SIZE - 1)));
+            const QColor mapped = toLinear.map(QColor::fromRgba64(value, value, value));
+            input[i] = qBound(0, qRound(mapped.redF() * AXIS_LENGTH), AXIS_LENGTH);
+            input[INPUT_SIZE + i] = qBound(0, qRound(mapped.greenF() * AXIS_LENGTH), AXIS_LENGTH);
+            input[2 * INPUT_SIZE + i] = qBound(0, qRound(mapped.blueF() * AXIS_LENGTH), AXIS_LENGTH);
+        }
+
+        // Mapping QColor rather than QRgba64 returns colors outside the display's gamut as extended values instead of clipping them
+        const QColorTransform transform = linearSource.transformationToColorSpace(linearDisplay);
+        quint16 *node = lut->nodes.data();
+        for (int r = 0; r < GRID_SIZE; r++)
+        {
+            for (int g = 0; g < GRID_SIZE; g++)
+            {
+                for (int b = 0; b < GRID_SIZE; b++)
+                {
+                    const QColor mapped = transform.map(QColor::fromRgba64(r * 65535 / GRID_STEPS, g * 65535 / GRID_STEPS, b * 65535 / GRID_STEPS));
+                    node[0] = static_cast<quint16>(qBound(0, qRound(mapped.redF() * NODE_ONE) + NODE_ZERO, 65535));
+                    node[1] = static_cast<quint16>(qBound(0, qRound(mapped.greenF() * NODE_ONE) + NODE_ZERO, 65535));
+                    node[2] = static_cast<quint16>(qBound(0, qRound(mapped.blueF() * NODE_ONE) + NODE_ZERO, 65535));
+                    node[3] = 0;
+                    node += NODE_CHANNELS;
+                }
+            }
+        }
+
+        const QColorTransform fromLinear = linearDisplay.transformationToColorSpace(display);
+        uchar *output = lut->output.data();
+        for (int i = 0; i < OUTPUT_SIZE; i++)
+        {
+            const quint16 value = static_cast<quint16>(qRound(i * 65535.0 / NODE_ONE));
+            const QColor mapped = fromLinear.map(QColor::fromRgba64(value, value, value));
+            output[i] = static_cast<uchar>(mapped.red());
+            output[OUTPUT_SIZE + i] = static_cast<uchar>(mapped.green());
+            output[2 * OUTPUT_SIZE + i] = static_cast<uchar>(mapped.blue());
+        }
+        return lut;
+    }
+
+    QSharedPointer<const Lut> getLut(const QColorSpace &source, const QColorSpace &display)
+    {
+        {
+            QMutexLocker locker(&lutCacheMutex);
+            for (int i = 0; i < lutCache.length(); i++)
+            {
+                if (lutCache.at(i)->source == source && lutCache.at(i)->display == display)
+                {
+                    lutCache.move(i, 0);
+                    return lutCache.constFirst();
+                }
+            }
+        }
+
+        // Built without holding the lock, two workers may both build the same table but neither waits on the other
+        QSharedPointer<const Lut> lut = buildLut(source, display);
+
+        QMutexLocker locker(&lutCacheMutex);
+        lutCache.prepend(lut);
+        while (lutCache.length() > MAX_CACHED_LUTS)
+            lutCache.removeLast();
+
+        return lut;
+    }
+
+    inline int toOutputIndex(int value)
+    {
+        return qBound(0, ((value + CELL_SIZE / 2) >> CELL_BITS) - NODE_ZERO, NODE_ONE);
+    }
+
+    // Splits the cube cell around the position into six tetrahedra and interpolates inside the one holding it,
+    // which only needs four nodes instead of the eight trilinear interpolation reads
+    inline QRgb mapPosition(const Lut &lut, const int position[3], int alpha)
+    {
+        int fraction[3];
+        int offset = 0;
+        const int strides[3] = {R_STRIDE, G_STRIDE, B_STRIDE};
+        for (int i = 0; i < 3; i++)
+        {
+            // The far end of an axis lands on the far side of the last cell
+            const int index = qMin(position[i] >> CELL_BITS, GRID_STEPS - 1);
+            fraction[i] = position[i] - (index << CELL_BITS);
+            offset += index * strides[i];
+        }
+
+        const int fr = fraction[0];
+        const int fg = fraction[1];
+        const int fb = fraction[2];
+
+        // Walk from the base corner along the axes in order of decreasing fraction
+        int step1, step2, weight1, weight2, weight3;
+        if (fr >= fg)
+        {
+            if (fg >= fb)
+            {
+                step1 = R_STRIDE; step2 = R_STRIDE + G_STRIDE; weight1 = fr; weight2 = fg; weight3 = fb;
+            }
+            else if (fr >= fb)
+            {
+                step1 = R_STRIDE; step2 = R_STRIDE + B_STRIDE; weight1 = fr; weight2 = fb; weight3 = fg;
+            }
+            else
+            {
+                step1 = B_STRIDE; step2 = B_STRIDE + R_STRIDE; weight1 = fb; weight2 = fr; weight3 = fg;
+            }
+        }
+        else
+        {
+            if (fr >= fb)
+            {
+                step1 = G_STRIDE; step2 = G_STRIDE + R_STRIDE; weight1 = fg; weight2 = fr; weight3 = fb;
+            }
+            else if (fg >= fb)
+            {
+                step1 = G_STRIDE; step2 = G_STRIDE + B_STRIDE; weight1 = fg; weight2 = fb; weight3 = fr;
+            }
+            else
+            {
+                step1 = B_STRIDE; step2 = B_STRIDE + G_STRIDE; weight1 = fb; weight2 = fg; weight3 = fr;
+            }
+        }
+
+        const quint16 *c0 = lut.nodes.constData() + offset;
+        const quint16 *c1 = c0 + step1;
+        const quint16 *c2 = c0 + step2;
+        const quint16 *c3 = c0 + R_STRIDE + G_STRIDE + B_STRIDE;
+        const uchar *output = lut.output.constData();
+
+        int out[3];
+        for (int i = 0; i < 3; i++)
+        {
+            // 16-bit nodes times 4096ths, rounded back to the output curve's steps
+            const int value = c0[i] * CELL_SIZE + (c1[i] - c0[i]) * weight1 + (c2[i] - c1[i]) * weight2 + (c3[i] - c2[i]) * weight3;
+            out[i] = output[i * OUTPUT_SIZE + toOutputIndex(value)];
+        }
+
+        return qRgba(out[0], out[1], out[2], alpha);
+    }
+
+    inline QRgb mapRgb(const Lut &lut, QRgb pixel)
+    {
+        const int *input = lut.input.constData();
+        const int position[3] = {input[qRed(pixel) * INPUT_STEPS], input[INPUT_SIZE + qGreen(pixel) * INPUT_STEPS],
+                                 input[2 * INPUT_SIZE + qBlue(pixel) * INPUT_STEPS]};
+        return mapPosition(lut, position, qAlpha(pixel));
+    }
+
+    // Profiles describe straight color, so premultiplied pixels are converted without their alpha.
+    // It is divided out into the input curve's finer steps, since at the edge of a wide gamut a single 8-bit step can move the result by ten
+    inline QRgb mapPixel(const Lut &lut, QRgb pixel, bool isPremultiplied)
+    {
+        if (isPremultiplied)
+        {
+            const int alpha = qAlpha(pixel);
+            if (alpha == 0)
+                return pixel;
+            if (alpha != 255)
+            {
+                const int *input = lut.input.constData();
+                const auto unpremultiply = [alpha](int value){
+                    return qMin((value * (INPUT_SIZE - 1) + alpha / 2) / alpha, INPUT_SIZE - 1);
+                };
+                const int position[3] = {input[unpremultiply(qRed(pixel))], input[INPUT_SIZE + unpremultiply(qGreen(pixel))],
+                                         input[2 * INPUT_SIZE + unpremultiply(qBlue(pixel))]};
+                return qPremultiply(mapPosition(lut, position, alpha));
+            }
+        }
+        return mapRgb(lut, pixel);
+    }
+
+    using RowMap = void (*)(QRgb *line, int width, bool isPremultiplied, const Lut &lut);
+
+    struct Kernels
+    {
+        RowMap mapRow;
+    };
+
+    // Scalar kernel, the reference the others have to match bit for bit
+    void mapRowScalar(QRgb *line, int width, bool isPremultiplied, const Lut &lut)
+    {
+        for (int x = 0; x < width; x++)
+            line[x] = mapPixel(lut, line[x], isPremultiplied);
+    }
+
+#ifdef QV_COLOR_X86
+    // The vector kernels map several pixels per lane group with the same integer math as mapPosition, written without branches:
+    // the walk goes along the axis with the largest fraction first and leaves the one with the smallest for last,
+    // and where fractions tie the nodes the choice could change get a weight of zero, so any tie-break gives the same sum.
+    // Nodes are read as two 32-bit halves, red and green in the first, blue in the second.
+    // The output curve is a byte table, so each lane group is written back one pixel at a time.
+    // Premultiplied groups that aren't entirely opaque fall back to mapPixel
+
+    inline quint32 loadHalf(const quint16 *node)
+    {
+        quint32 half;
+        std::memcpy(&half, node, sizeof(half));
+        return half;
+    }
+
+    inline void storeOutput(const Lut &lut, QRgb *pixels, int count, const int *red, const int *green, const int *blue)
+    {
+        const uchar *output = lut.output.constData();
+        for (int i = 0; i < count; i++)
+            pixels[i] = qRgba(output[red[i]], output[OUTPUT_SIZE + green[i]], output[2 * OUTPUT_SIZE + blue[i]], qAlpha(pixels[i]));
+    }
+
+    QV_TARGET("sse4.1")
+    inline __m128i toOutputIndexSSE41(__m128i value)
+    {
+        const __m128i index = _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(value, _mm_set1_epi32(CELL_SIZE / 2)), CELL_BITS), _mm_set1_epi32(NODE_ZERO));
+        return _mm_min_epi32(_mm_max_epi32(index, _mm_setzero_si128()), _mm_set1_epi32(NODE_ONE));
+    }
+
+    QV_TARGET("sse4.1")
+    inline __m128i gatherSSE41(const quint16 *nodes, const int *offsets, int extra)
+    {
+        return _mm_setr_epi32(static_cast<int>(loadHalf(nodes + offsets[0] + extra)), static_cast<int>(loadHalf(nodes + offsets[1] + extra)),
+                              static_cast<int>(loadHalf(nodes + offsets[2] + extra)), static_cast<int>(loadHalf(nodes + offsets[3] + extra)));
+    }
+
+    QV_TARGET("sse4.1")
+    void mapRowSSE41(QRgb *line, int width, bool isPremultiplied, const Lut &lut)
+    {
+        const quint16 *nodes = lut.nodes.constData();
+        const int *input = lut.input.constData();
+        const __m128i wordMask = _mm_set1_epi32(0xffff);
+        const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000));
+        const __m128i lastIndex = _mm_set1_epi32(GRID_STEPS - 1);
+        const __m128i full = _mm_set1_epi32(CELL_SIZE);
+        const __m128i rStride = _mm_set1_epi32(R_STRIDE);
+        const __m128i gStride = _mm_set1_epi32(G_STRIDE);
+        const __m128i bStride = _mm_set1_epi32(B_STRIDE);
+        const __m128i allStrides = _mm_set1_epi32(R_STRIDE + G_STRIDE + B_STRIDE);
+
+        int x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(line + x));
+            if (isPremultiplied && _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(pixels, alphaMask), alphaMask)) != 0xffff)
+            {
+                for (int i = x; i < x + 4; i++)
+                    line[i] = mapPixel(lut, line[i], true);
+                continue;
+            }
+
+            // SSE4.1 has no gather, the input curve is read one channel at a time
+            alignas(16) int positions[3][4];
+            for (int i = 0; i < 4; i++)
+            {
+                positions[0][i] = input[qRed(line[x + i]) * INPUT_STEPS];
+                positions[1][i] = input[INPUT_SIZE + qGreen(line[x + i]) * INPUT_STEPS];
+                positions[2][i] = input[2 * INPUT_SIZE + qBlue(line[x + i]) * INPUT_STEPS];
+            }
+            const __m128i positionR = _mm_load_si128(reinterpret_cast<const __m128i *>(positions[0]));
+            const __m128i positionG = _mm_load_si128(reinterpret_cast<const __m128i *>(positions[1]));
+            const __m128i positionB = _mm_load_si128(reinterpret_cast<const __m128i *>(positions[2]));
+            const __m128i indexR = _mm_min_epi32(_mm_srli_epi32(positionR, CELL_BITS), lastIndex);
+            const __m128i indexG = _mm_min_epi32(_mm_srli_epi32(positionG, CELL_BITS), lastIndex);
+            const __m128i indexB = _mm_min_epi32(_mm_srli_epi32(positionB, CELL_BITS), lastIndex);
+            const __m128i fr = _mm_sub_epi32(positionR, _mm_slli_epi32(indexR, CELL_BITS));
+            const __m128i fg = _mm_sub_epi32(positionG, _mm_slli_epi32(indexG, CELL_BITS));
+            const __m128i fb = _mm_sub_epi32(positionB, _mm_slli_epi32(indexB, CELL_BITS));
+
+            const __m128i base = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(indexR, rStride), _mm_mullo_epi32(indexG, gStride)),
+                                               _mm_mullo_epi32(indexB, bStride));
+
+            const __m128i largest = _mm_max_epi32(_mm_max_epi32(fr, fg), fb);
+            const __m128i smallest = _mm_min_epi32(_mm_min_epi32(fr, fg), fb);
+            const __m128i middle = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(fr, fg), fb), _mm_add_epi32(largest, smallest));
+
+            const __m128i firstStride = _mm_blendv_epi8(_mm_blendv_epi8(bStride, gStride, _mm_cmpeq_epi32(fg, largest)),
+                                                        rStride, _mm_cmpeq_epi32(fr, largest));
+            const __m128i lastStride = _mm_blendv_epi8(_mm_blendv_epi8(bStride, gStride, _mm_cmpeq_epi32(fg, smallest)),
+                                                       rStride, _mm_cmpeq_epi32(fr, smallest));
+
+            alignas(16) int offsets[4][4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(offsets[0]), base);
+            _mm_store_si128(reinterpret_cast<__m128i *>(offsets[1]), _mm_add_epi32(base, firstStride));
+            _mm_store_si128(reinterpret_cast<__m128i *>(offsets[2]), _mm_add_epi32(base, _mm_sub_epi32(allStrides, lastStride)));
+            _mm_store_si128(reinterpret_cast<__m128i *>(offsets[3]), _mm_add_epi32(base, allStrides));
+
+            const __m128i weights[4] = {
+                _mm_sub_epi32(full, largest),
+                _mm_sub_epi32(largest, middle),
+                _mm_sub_epi32(middle, smallest),
+                smallest
+            };
+
+            __m128i sumR = _mm_setzero_si128();
+            __m128i sumG = _mm_setzero_si128();
+            __m128i sumB = _mm_setzero_si128();
+            for (int corner = 0; corner < 4; corner++)
+            {
+                const __m128i redGreen = gatherSSE41(nodes, offsets[corner], 0);
+                const __m128i blue = _mm_and_si128(gatherSSE41(nodes, offsets[corner], 2), wordMask);
+                sumR = _mm_add_epi32(sumR, _mm_mullo_epi32(_mm_and_si128(redGreen, wordMask), weights[corner]));
+                sumG = _mm_add_epi32(sumG, _mm_mullo_epi32(_mm_srli_epi32(redGreen, 16), weights[corner]));
+                sumB = _mm_add_epi32(sumB, _mm_mullo_epi32(blue, weights[corner]));
+            }
+
+            alignas(16) int indices[3][4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(indices[0]), toOutputIndexSSE41(sumR));
+            _mm_store_si128(reinterpret_cast<__m128i *>(indices[1]), toOutputIndexSSE41(sumG));
+            _mm_store_si128(reinterpret_cast<__m128i *>(indices[2]), toOutputIndexSSE41(sumB));
+            storeOutput(lut, line + x, 4, indices[0], indices[1], indices[2]);
+        }
+
+        for (; x < width; x++)
+            line[x] = mapPixel(lut, line[x], isPremultiplied);
+    }
+
+    QV_TARGET("avx2")
+    inline __m256i toOutputIndexAVX2(__m256i value)
+    {
+        const __m256i index = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_add_epi32(value, _mm256_set1_epi32(CELL_SIZE / 2)), CELL_BITS),
+                                               _mm256_set1_epi32(NODE_ZERO));
+        return _mm256_min_epi32(_mm256_max_epi32(index, _mm256_setzero_si256()), _mm256_set1_epi32(NODE_ONE));
+    }
+
+    QV_TARGET("avx2")
+    void mapRowAVX2(QRgb *line, int width, bool isPremultiplied, const Lut &lut)
+    {
+        const int *table = reinterpret_cast<const int *>(lut.nodes.constData());
+        const int *input = lut.input.constData();
+        const __m256i byteMask = _mm256_set1_epi32(0xff);
+        const __m256i wordMask = _mm256_set1_epi32(0xffff);
+        const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xff000000));
+        const __m256i lastIndex = _mm256_set1_epi32(GRID_STEPS - 1);
+        const __m256i full = _mm256_set1_epi32(CELL_SIZE);
+        const __m256i rStride = _mm256_set1_epi32(R_STRIDE);
+        const __m256i gStride = _mm256_set1_epi32(G_STRIDE);
+        const __m256i bStride = _mm256_set1_epi32(B_STRIDE);
+        const __m256i allStrides = _mm256_set1_epi32(R_STRIDE + G_STRIDE + B_STRIDE);
+        const __m256i blueOffset = _mm256_set1_epi32(2);
+
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(line + x));
+            if (isPremultiplied && _mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(pixels, alphaMask), alphaMask)) != -1)
+            {
+                for (int i = x; i < x + 8; i++)
+                    line[i] = mapPixel(lut, line[i], true);
+                continue;
+            }
+
+            // Each channel's value in 8-bit steps, scaled to the input curve's finer ones
+            const __m256i positionR = _mm256_i32gather_epi32(input, _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask), 4), 4);
+            const __m256i positionG = _mm256_i32gather_epi32(input + INPUT_SIZE, _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask), 4), 4);
+            const __m256i positionB = _mm256_i32gather_epi32(input + 2 * INPUT_SIZE, _mm256_slli_epi32(_mm256_and_si256(pixels, byteMask), 4), 4);
+            const __m256i indexR = _mm256_min_epi32(_mm256_srli_epi32(positionR, CELL_BITS), lastIndex);
+            const __m256i indexG = _mm256_min_epi32(_mm256_srli_epi32(positionG, CELL_BITS), lastIndex);
+            const __m256i indexB = _mm256_min_epi32(_mm256_srli_epi32(positionB, CELL_BITS), lastIndex);
+            const __m256i fr = _mm256_sub_epi32(positionR, _mm256_slli_epi32(indexR, CELL_BITS));
+            const __m256i fg = _mm256_sub_epi32(positionG, _mm256_slli_epi32(indexG, CELL_BITS));
+            const __m256i fb = _mm256_sub_epi32(positionB, _mm256_slli_epi32(indexB, CELL_BITS));
+
+            const __m256i base = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(indexR, rStride), _mm256_mullo_epi32(indexG, gStride)),
+                                                  _mm256_mullo_epi32(indexB, bStride));
+
+            const __m256i largest = _mm256_max_epi32(_mm256_max_epi32(fr, fg), fb);
+            const __m256i smallest = _mm256_min_epi32(_mm256_min_epi32(fr, fg), fb);
+            const __m256i middle = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(fr, fg), fb), _mm256_add_epi32(largest, smallest));
+
+            const __m256i firstStride = _mm256_blendv_epi8(_mm256_blendv_epi8(bStride, gStride, _mm256_cmpeq_epi32(fg, largest)),
+                                                           rStride, _mm256_cmpeq_epi32(fr, largest));
+            const __m256i lastStride = _mm256_blendv_epi8(_mm256_blendv_epi8(bStride, gStride, _mm256_cmpeq_epi32(fg, smallest)),
+                                                          rStride, _mm256_cmpeq_epi32(fr, smallest));
+
+            const __m256i offsets[4] = {
+                base,
+                _mm256_add_epi32(base, firstStride),
+                _mm256_add_epi32(base, _mm256_sub_epi32(allStrides, lastStride)),
+                _mm256_add_epi32(base, allStrides)
+            };
+            const __m256i weights[4] = {
+                _mm256_sub_epi32(full, largest),
+                _mm256_sub_epi32(largest, middle),
+                _mm256_sub_epi32(middle, smallest),
+                smallest
+            };
+
+            __m256i sumR = _mm256_setzero_si256();
+            __m256i sumG = _mm256_setzero_si256();
+            __m256i sumB = _mm256_setzero_si256();
+            for (int corner = 0; corner < 4; corner++)
+            {
+                // Offsets count 16-bit channels, hence the scale of 2
+                const __m256i redGreen = _mm256_i32gather_epi32(table, offsets[corner], 2);
+                const __m256i blue = _mm256_and_si256(_mm256_i32gather_epi32(table, _mm256_add_epi32(offsets[corner], blueOffset), 2), wordMask);
+                sumR = _mm256_add_epi32(sumR, _mm256_mullo_epi32(_mm256_and_si256(redGreen, wordMask), weights[corner]));
+                sumG = _mm256_add_epi32(sumG, _mm256_mullo_epi32(_mm256_srli_epi32(redGreen, 16), weights[corner]));
+                sumB = _mm256_add_epi32(sumB, _mm256_mullo_epi32(blue, weights[corner]));
+            }
+
+            alignas(32) int indices[3][8];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(indices[0]), toOutputIndexAVX2(sumR));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(indices[1]), toOutputIndexAVX2(sumG));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(indices[2]), toOutputIndexAVX2(sumB));
+            storeOutput(lut, line + x, 8, indices[0], indices[1], indices[2]);
+        }
+
+        for (; x < width; x++)
+            line[x] = mapPixel(lut, line[x], isPremultiplied);
+    }
+#endif
+
+    Kernels kernelsFor(InstructionSet instructionSet)
+    {
+#ifdef QV_COLOR_X86
+        if (instructionSet == InstructionSet::AVX2)
+            return {mapRowAVX2};
+        if (instructionSet == InstructionSet::SSE41)
+            return {mapRowSSE41};
+#else
+        Q_UNUSED(instructionSet)
+#endif
+        return {mapRowScalar};
+    }
+
+    // Same processor checks as the scaler, which knows how to ask each compiler
+    InstructionSet bestInstructionSet()
+    {
+        static const InstructionSet best = []{
+            if (QVImageScaler::isSupported(InstructionSet::AVX2))
+                return InstructionSet::AVX2;
+            if (QVImageScaler::isSupported(InstructionSet::SSE41))
+                return InstructionSet::SSE41;
+            return InstructionSet::Scalar;
+        }();
+        return best;
+    }
+}
+
+bool QVColorManager::convertToDisplay(QImage &image, InstructionSet instructionSet)
+{
+    const QColorSpace source = image.colorSpace();
+    const QColorSpace display = getDisplayColorSpace();
+    if (image.isNull() || !source.isValid() || source == display)
+        return false;
+
+    switch (image.format()) {
+    case QImage::Format_Grayscale8:
+    case QImage::Format_Grayscale16:
+        // Gray profiles aren't something QColorSpace handles
+        return false;
+    case QImage::Format_BGR30:
+    case QImage::Format_A2BGR30_Premultiplied:
+    case QImage::Format_RGB30:
+    case QImage::Format_A2RGB30_Premultiplied:
+        // Deep color keeps its precision through Qt's own conversion, the table is for 8-bit
+        image.convertToColorSpace(display);
+        return true;
+    default:
+        if (image.depth() > 32)
+        {
+            image.convertToColorSpace(display);
+            return true;
+        }
+        break;
+    }
+
+    const QSharedPointer<const Lut> lut = getLut(source, display);
+
+    // Palettes only need their entries converted, which also keeps 1-bit images 1-bit
+    if (image.format() == QImage::Format_Indexed8 || image.depth() == 1)
+    {
+        QVector<QRgb> colorTable = image.colorTable();
+        for (auto &color : colorTable)
+            color = mapRgb(*lut, color);
+        image.setColorTable(colorTable);
+        image.setColorSpace(display);
+        return true;
+    }
+
+    switch (image.format()) {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+        break;
+    default:
+        image = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+        break;
+    }
+
+    // Resolve the pixel pointer before any threads see the image, scanLine() may detach
+    uchar *bits = image.bits();
+    const qptrdiff bytesPerLine = image.bytesPerLine();
+    const int width = image.width();
+    const bool isPremultiplied = image.format() == QImage::Format_ARGB32_Premultiplied;
+
+    if (instructionSet == InstructionSet::Automatic || !QVImageScaler::isSupported(instructionSet))
+        instructionSet = bestInstructionSet();
+    const RowMap mapRow = kernelsFor(instructionSet).mapRow;
+
+    QVector<QPair<int, int>> jobs;
+    for (int row = 0; row < image.height(); row += ROWS_PER_JOB)
+        jobs.append({row, qMin(image.height(), row + ROWS_PER_JOB)});
+
+    const Lut *table = lut.data();
+    QtConcurrent::blockingMap(jobs, [=](const QPair<int, int> &job){
+        for (int y = job.first; y < job.second; y++)
+            mapRow(reinterpret_cast<QRgb *>(bits + y * bytesPerLine), width, isPremultiplied, *table);
+    });
+
+    image.setColorSpace(display);
+    return true;
+}
+
+bool QVColorManager::isSupported()
+{
+    return true;
+}
+
+#else
+
+bool QVColorManager::convertToDisplay(QImage &image, QVImageScaler::InstructionSet instructionSet)
+{
+    Q_UNUSED(image)
+    Q_UNUSED(instructionSet)
+    return false;
+}
+
+bool QVColorManager::isSupported()
+{
+    return false;
+}
+
+#endif
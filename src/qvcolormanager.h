@@ -0,0 +1,23 @@
+#ifndef QVCOLORMANAGER_H
+#define QVCOLORMANAGER_H
+
+#include "qvimagescaler.h"
+
+#include <QImage>
+
+// Converts decoded images from their embedded color profile to the display's.
+// Each pair of profiles is sampled once into a 3D lookup table in linear light with a 1D curve for each side, which are kept
+// for the next image that uses the same profile, and pixels are then converted by looking up their curves and interpolating
+// tetrahedrally in the table instead of evaluating the full transform. Results stay within a level or two of QImage::convertToColorSpace.
+// The interpolation has SSE4.1 and AVX2 versions picked at runtime, with the same instruction sets and results as QVImageScaler.
+// Needs QColorSpace, so this does nothing before Qt 5.14.
+class QVColorManager
+{
+public:
+    // Returns false if the image was left as it is, because it has no profile or already matches the display
+    static bool convertToDisplay(QImage &image, QVImageScaler::InstructionSet instructionSet = QVImageScaler::InstructionSet::Automatic);
+
+    static bool isSupported();
+};
+
+#endif // QVCOLORMANAGER_H
@@ -0,0 +1,101 @@
+#include "qvexportframesdialog.h"
+
+#include <QDir>
+#include <QFileDialog>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QDialogButtonBox>
+#include <QPushButton>
+#include <QMessageBox>
+#include <limits>
+
+QVExportFramesDialog::QVExportFramesDialog(QWidget *parent, const QString &directory, int frameCount) :
+    QDialog(parent)
+{
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowFlag(Qt::WindowContextHelpButtonHint, false);
+    setWindowTitle(tr("Export Frames..."));
+
+    directoryLineEdit = new QLineEdit(QDir::toNativeSeparators(directory));
+    auto *browseButton = new QPushButton(tr("Browse..."));
+    connect(browseButton, &QPushButton::clicked, this, &QVExportFramesDialog::browse);
+
+    auto *directoryLayout = new QHBoxLayout();
+    directoryLayout->addWidget(directoryLineEdit);
+    directoryLayout->addWidget(browseButton);
+
+    // Shown from 1 like the Go to Frame dialog
+    const int maximumFrame = frameCount > 0 ? frameCount : std::numeric_limits<int>::max();
+    firstFrameSpinBox = new QSpinBox();
+    firstFrameSpinBox->setRange(1, maximumFrame);
+    firstFrameSpinBox->setValue(1);
+
+    // 0 shows as "End", for when the frame count isn't known up front
+    lastFrameSpinBox = new QSpinBox();
+    lastFrameSpinBox->setRange(0, maximumFrame);
+    lastFrameSpinBox->setSpecialValueText(tr("End"));
+    lastFrameSpinBox->setValue(frameCount);
+
+    compressionSpinBox = new QSpinBox();
+    compressionSpinBox->setRange(0, 9);
+    compressionSpinBox->setValue(6);
+    compressionSpinBox->setToolTip(tr("0 writes the fastest, 9 writes the smallest files"));
+
+    auto *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    buttonBox->button(QDialogButtonBox::Ok)->setText(tr("Export"));
+    connect(buttonBox, &QDialogButtonBox::accepted, this, [this]{
+        if (!QDir(getDirectory()).exists())
+        {
+            QMessageBox::critical(this, tr("Error"), tr("The folder %1 does not exist.").arg(directoryLineEdit->text()));
+            return;
+        }
+        if (getLastFrame() >= 0 && getLastFrame() < getFirstFrame())
+        {
+            QMessageBox::critical(this, tr("Error"), tr("The last frame comes before the first frame."));
+            return;
+        }
+        accept();
+    });
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    auto *formLayout = new QFormLayout(this);
+    formLayout->addRow(tr("Folder:"), directoryLayout);
+    formLayout->addRow(tr("First frame:"), firstFrameSpinBox);
+    formLayout->addRow(tr("Last frame:"), lastFrameSpinBox);
+    formLayout->addRow(tr("PNG compression:"), compressionSpinBox);
+    formLayout->addRow(buttonBox);
+
+    resize(400, height());
+}
+
+QString QVExportFramesDialog::getDirectory() const
+{
+    return QDir::fromNativeSeparators(directoryLineEdit->text());
+}
+
+int QVExportFramesDialog::getFirstFrame() const
+{
+    return firstFrameSpinBox->value() - 1;
+}
+
+int QVExportFramesDialog::getLastFrame() const
+{
+    return lastFrameSpinBox->value() - 1;
+}
+
+int QVExportFramesDialog::getCompressionLevel() const
+{
+    return compressionSpinBox->value();
+}
+
+void QVExportFramesDialog::browse()
+{
+    auto *directoryDialog = new QFileDialog(this, tr("Export Frames To..."), getDirectory());
+    directoryDialog->setFileMode(QFileDialog::Directory);
+    directoryDialog->setOption(QFileDialog::ShowDirsOnly);
+    directoryDialog->setAttribute(Qt::WA_DeleteOnClose);
+    connect(directoryDialog, &QFileDialog::fileSelected, this, [this](const QString &directory){
+        directoryLineEdit->setText(QDir::toNativeSeparators(directory));
+    });
+    directoryDialog->open();
+}
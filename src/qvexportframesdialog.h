@@ -0,0 +1,32 @@
+#ifndef QVEXPORTFRAMESDIALOG_H
+#define QVEXPORTFRAMESDIALOG_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QSpinBox>
+
+class QVExportFramesDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    // frameCount is 0 when it isn't known, which leaves the range open at the end
+    QVExportFramesDialog(QWidget *parent, const QString &directory, int frameCount);
+
+    QString getDirectory() const;
+
+    // Numbered from 0, lastFrame is -1 for everything up to the end
+    int getFirstFrame() const;
+    int getLastFrame() const;
+
+    int getCompressionLevel() const;
+
+private:
+    void browse();
+
+    QLineEdit *directoryLineEdit;
+    QSpinBox *firstFrameSpinBox;
+    QSpinBox *lastFrameSpinBox;
+    QSpinBox *compressionSpinBox;
+};
+
+#endif // QVEXPORTFRAMESDIALOG_H
@@ -0,0 +1,325 @@
+#include "qvfolderindex.h"
+
+#include <QCollator>
+#include <QMimeDatabase>
+#include <QHash>
+#include <random>
+#include <algorithm>
+#include <numeric>
+
+class QVFolderIndexData : public QSharedData
+{
+public:
+    QString dirPrefix;
+
+    // All file names back to back, file i spans [nameOffsets[i], nameOffsets[i+1])
+    QString nameArena;
+    QVector<quint32> nameOffsets = {0};
+
+    QVector<qint64> lastModifieds;
+    QVector<qint64> sizes;
+
+    // Sorted position -> entry in the arrays above
+    QVector<quint32> order;
+
+    // Open addressing hash table of name -> sorted position + 1, 0 marks an empty slot
+    QVector<quint32> positionTable;
+
+    void appendEntry(const QString &fileName, qint64 lastModified, qint64 size)
+    {
+        order.append(static_cast<quint32>(order.size()));
+        nameArena += fileName;
+        nameOffsets.append(static_cast<quint32>(nameArena.size()));
+        lastModifieds.append(lastModified);
+        sizes.append(size);
+    }
+
+    const QChar *nameData(quint32 entry) const { return nameArena.constData() + nameOffsets.at(entry); }
+    int nameLength(quint32 entry) const { return nameOffsets.at(entry + 1) - nameOffsets.at(entry); }
+    QString name(quint32 entry) const { return QString(nameData(entry), nameLength(entry)); }
+
+    static quint32 hashName(const QChar *name, int length)
+    {
+        // FNV-1a over the UTF-16 code units
+        quint32 hash = 2166136261u;
+        for (int i = 0; i < length; i++)
+        {
+            hash ^= name[i].unicode();
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    void insertPosition(quint32 position)
+    {
+        const quint32 entry = order.at(position);
+        const quint32 mask = static_cast<quint32>(positionTable.size()) - 1;
+        quint32 slot = hashName(nameData(entry), nameLength(entry)) & mask;
+        while (positionTable.at(slot) != 0)
+            slot = (slot + 1) & mask;
+        positionTable[slot] = position + 1;
+    }
+
+    void rebuildPositionTable()
+    {
+        // Keep the table at most half full so probe sequences stay short
+        int tableSize = 16;
+        while (tableSize < order.size() * 2)
+            tableSize *= 2;
+
+        positionTable.fill(0, tableSize);
+        for (int position = 0; position < order.size(); position++)
+            insertPosition(static_cast<quint32>(position));
+    }
+
+    int findPosition(const QChar *name, int length) const
+    {
+        if (positionTable.isEmpty())
+            return -1;
+
+        const quint32 mask = static_cast<quint32>(positionTable.size()) - 1;
+        quint32 slot = hashName(name, length) & mask;
+        while (const quint32 value = positionTable.at(slot))
+        {
+            const quint32 entry = order.at(value - 1);
+            if (nameLength(entry) == length && std::equal(name, name + length, nameData(entry)))
+                return static_cast<int>(value - 1);
+
+            slot = (slot + 1) & mask;
+        }
+        return -1;
+    }
+
+    // Mime type of each entry as an index into mimeTypeNames, only filled in for the type sort
+    QStringList mimeTypeNames;
+    QVector<quint32> mimeTypeIds;
+
+    void updateMimeTypeIds()
+    {
+        QMimeDatabase mimeDb;
+        QHash<QString, quint32> knownIds;
+        for (int i = 0; i < mimeTypeNames.size(); i++)
+            knownIds.insert(mimeTypeNames.at(i), static_cast<quint32>(i));
+
+        // Entries never move in the arrays, so only ones appended since the last sort need a lookup
+        for (int entry = mimeTypeIds.size(); entry < order.size(); entry++)
+        {
+            const QString mimeName = mimeDb.mimeTypeForFile(dirPrefix + name(static_cast<quint32>(entry))).name();
+            auto it = knownIds.constFind(mimeName);
+            if (it == knownIds.constEnd())
+            {
+                it = knownIds.insert(mimeName, static_cast<quint32>(mimeTypeNames.size()));
+                mimeTypeNames.append(mimeName);
+            }
+            mimeTypeIds.append(it.value());
+        }
+    }
+
+    // Sorts order[first, end) and merges it into the already sorted positions before it
+    template <typename LessThan>
+    void sortTail(int first, bool descending, LessThan lessThan)
+    {
+        auto compare = [&lessThan, descending](quint32 entry1, quint32 entry2)
+        {
+            if (descending)
+                return lessThan(entry2, entry1);
+            else
+                return lessThan(entry1, entry2);
+        };
+
+        std::sort(order.begin() + first, order.end(), compare);
+        std::inplace_merge(order.begin(), order.begin() + first, order.end(), compare);
+    }
+
+    void sortFrom(int first, int sortMode, bool descending, unsigned randomSeed)
+    {
+        // Sorting only permutes 32-bit indices, names and stats stay where they are
+        if (sortMode == 0) // Natural sorting
+        {
+            QCollator collator;
+            collator.setNumericMode(true);
+            sortTail(first, descending, [&collator, this](quint32 entry1, quint32 entry2)
+            {
+                return collator.compare(nameData(entry1), nameLength(entry1),
+                                        nameData(entry2), nameLength(entry2)) < 0;
+            });
+        }
+        else if (sortMode == 1) // last modified
+        {
+            sortTail(first, descending, [this](quint32 entry1, quint32 entry2)
+            {
+                return lastModifieds.at(entry1) > lastModifieds.at(entry2);
+            });
+        }
+        else if (sortMode == 2) // size
+        {
+            sortTail(first, descending, [this](quint32 entry1, quint32 entry2)
+            {
+                return sizes.at(entry1) > sizes.at(entry2);
+            });
+        }
+        else if (sortMode == 3) // type
+        {
+            // Look up each file's mime type once and sort on its rank instead of comparing names every time.
+            // Ranks follow the collation order of the names, so positions that are already sorted stay sorted
+            updateMimeTypeIds();
+
+            QVector<quint32> nameOrder(mimeTypeNames.size());
+            std::iota(nameOrder.begin(), nameOrder.end(), 0);
+            QCollator collator;
+            std::sort(nameOrder.begin(), nameOrder.end(), [&collator, this](quint32 id1, quint32 id2)
+            {
+                return collator.compare(mimeTypeNames.at(static_cast<int>(id1)), mimeTypeNames.at(static_cast<int>(id2))) < 0;
+            });
+            QVector<quint32> mimeRanks(mimeTypeNames.size());
+            for (int rank = 0; rank < nameOrder.size(); rank++)
+                mimeRanks[static_cast<int>(nameOrder.at(rank))] = static_cast<quint32>(rank);
+
+            sortTail(first, descending, [&mimeRanks, this](quint32 entry1, quint32 entry2)
+            {
+                return mimeRanks.at(static_cast<int>(mimeTypeIds.at(entry1))) < mimeRanks.at(static_cast<int>(mimeTypeIds.at(entry2)));
+            });
+        }
+        else if (sortMode == 4) // Random
+        {
+            // New files are shuffled among themselves so the part already being browsed doesn't move
+            std::shuffle(order.begin() + first, order.end(), std::default_random_engine(randomSeed));
+        }
+
+        // Positions all moved, so rehash them
+        rebuildPositionTable();
+    }
+};
+
+QVFolderIndex::QVFolderIndex() : d(new QVFolderIndexData)
+{
+}
+
+QVFolderIndex::QVFolderIndex(const QString &dirPath) : d(new QVFolderIndexData)
+{
+    d->dirPrefix = dirPath.endsWith('/') ? dirPath : dirPath + '/';
+}
+
+QVFolderIndex::QVFolderIndex(const QVFolderIndex &other) = default;
+
+QVFolderIndex &QVFolderIndex::operator=(const QVFolderIndex &other) = default;
+
+QVFolderIndex::~QVFolderIndex() = default;
+
+void QVFolderIndex::reserve(int count)
+{
+    d->nameOffsets.reserve(count + 1);
+    d->lastModifieds.reserve(count);
+    d->sizes.reserve(count);
+    d->order.reserve(count);
+}
+
+void QVFolderIndex::append(const QString &fileName, qint64 lastModified, qint64 size)
+{
+    const auto entry = static_cast<quint32>(d->order.size());
+    d->appendEntry(fileName, lastModified, size);
+
+    // New files land at the end of the order, so only the new position needs hashing
+    if (d->order.size() * 2 > d->positionTable.size())
+        d->rebuildPositionTable();
+    else
+        d->insertPosition(entry);
+}
+
+void QVFolderIndex::sort(int sortMode, bool descending, unsigned randomSeed)
+{
+    d->sortFrom(0, sortMode, descending, randomSeed);
+}
+
+void QVFolderIndex::merge(const QList<QVFolderIndex> &others, int sortMode, bool descending, unsigned randomSeed)
+{
+    const int firstNewPosition = count();
+
+    int newCount = 0;
+    for (const QVFolderIndex &other : others)
+        newCount += other.count();
+    reserve(firstNewPosition + newCount);
+
+    // Positions are only hashed once, after the merge
+    for (const QVFolderIndex &other : others)
+    {
+        if (!other.d->dirPrefix.startsWith(d->dirPrefix))
+            continue;
+
+        const QString relativePrefix = other.d->dirPrefix.mid(d->dirPrefix.length());
+        for (int entry = 0; entry < other.count(); entry++)
+        {
+            d->appendEntry(relativePrefix + other.d->name(static_cast<quint32>(entry)),
+                           other.d->lastModifieds.at(entry),
+                           other.d->sizes.at(entry));
+        }
+    }
+
+    if (count() == firstNewPosition)
+        return;
+
+    d->sortFrom(firstNewPosition, sortMode, descending, randomSeed ^ static_cast<unsigned>(firstNewPosition));
+}
+
+int QVFolderIndex::count() const
+{
+    return d->order.size();
+}
+
+QString QVFolderIndex::getDirPath() const
+{
+    if (d->dirPrefix.length() > 1)
+        return d->dirPrefix.left(d->dirPrefix.length() - 1);
+
+    return d->dirPrefix;
+}
+
+QString QVFolderIndex::fileName(int index) const
+{
+    if (index < 0 || index >= d->order.size())
+        return QString();
+
+    // Strip the subfolder part of the relative path, if any
+    const QString name = d->name(d->order.at(index));
+    return name.mid(name.lastIndexOf('/') + 1);
+}
+
+QString QVFolderIndex::absoluteFilePath(int index) const
+{
+    if (index < 0 || index >= d->order.size())
+        return QString();
+
+    const quint32 entry = d->order.at(index);
+    QString path;
+    path.reserve(d->dirPrefix.length() + d->nameLength(entry));
+    path += d->dirPrefix;
+    path.append(d->nameData(entry), d->nameLength(entry));
+    return path;
+}
+
+qint64 QVFolderIndex::lastModified(int index) const
+{
+    if (index < 0 || index >= d->order.size())
+        return -1;
+
+    return d->lastModifieds.at(d->order.at(index));
+}
+
+qint64 QVFolderIndex::size(int index) const
+{
+    if (index < 0 || index >= d->order.size())
+        return -1;
+
+    return d->sizes.at(d->order.at(index));
+}
+
+int QVFolderIndex::indexOf(const QString &absoluteFilePath) const
+{
+    if (!absoluteFilePath.startsWith(d->dirPrefix))
+        return -1;
+
+    const QChar *name = absoluteFilePath.constData() + d->dirPrefix.length();
+    const int nameLength = absoluteFilePath.length() - d->dirPrefix.length();
+
+    return d->findPosition(name, nameLength);
+}
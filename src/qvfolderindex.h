@@ -0,0 +1,55 @@
+#ifndef QVFOLDERINDEX_H
+#define QVFOLDERINDEX_H
+
+#include <QSharedDataPointer>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class QVFolderIndexData;
+
+// Compact, implicitly shared list of the compatible files in a folder.
+// Names live in one string arena and per-file data in parallel arrays,
+// so even folders with hundreds of thousands of files stay small and cheap to copy.
+// Files from subfolders are stored by their path relative to the root folder.
+class QVFolderIndex
+{
+public:
+    QVFolderIndex();
+    explicit QVFolderIndex(const QString &dirPath);
+    QVFolderIndex(const QVFolderIndex &other);
+    QVFolderIndex &operator=(const QVFolderIndex &other);
+    ~QVFolderIndex();
+
+    void reserve(int count);
+
+    void append(const QString &fileName, qint64 lastModified = -1, qint64 size = -1);
+
+    void sort(int sortMode, bool descending, unsigned randomSeed);
+
+    // Adds the files of folders below this one, keeping the existing order sorted.
+    // Only the new files are sorted, then merged in all at once, so streaming in a tree stays cheap
+    void merge(const QList<QVFolderIndex> &others, int sortMode, bool descending, unsigned randomSeed);
+
+    int count() const;
+
+    bool isEmpty() const { return count() == 0; }
+
+    QString getDirPath() const;
+
+    QString fileName(int index) const;
+
+    QString absoluteFilePath(int index) const;
+
+    qint64 lastModified(int index) const;
+
+    qint64 size(int index) const;
+
+    // Constant time, positions are hashed by name whenever the order changes
+    int indexOf(const QString &absoluteFilePath) const;
+
+private:
+    QSharedDataPointer<QVFolderIndexData> d;
+};
+
+#endif // QVFOLDERINDEX_H
@@ -0,0 +1,229 @@
+#include "qvfolderwalker.h"
+#include "qvimagecore.h"
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+
+namespace
+{
+    // Shared by every walk and never waited on, a walk that was dropped may still have a worker stuck on a slow mount
+    QThreadPool *getWorkerPool()
+    {
+        static QThreadPool *workerPool = []{
+            auto *threadPool = new QThreadPool();
+            // Scanning is mostly waiting on the filesystem, so use at least a couple of workers even on one core
+            threadPool->setMaxThreadCount(qMax(2, QThread::idealThreadCount()));
+            return threadPool;
+        }();
+        return workerPool;
+    }
+}
+
+class QVFolderWalker::WalkState
+{
+public:
+    struct Queue
+    {
+        QMutex mutex;
+        QStringList dirPaths;
+    };
+
+    WalkState(QVFolderWalker *walker, int sortMode, int workerCount) : walker(walker), sortMode(sortMode)
+    {
+        for (int i = 0; i < workerCount; i++)
+            queues.append(new Queue());
+    }
+
+    ~WalkState()
+    {
+        qDeleteAll(queues);
+    }
+
+    void push(int workerIndex, const QStringList &dirPaths)
+    {
+        {
+            QMutexLocker locker(&queues.at(workerIndex)->mutex);
+            queues.at(workerIndex)->dirPaths.append(dirPaths);
+        }
+
+        // Taking the idle lock after the push means a worker about to wait either sees the folders or gets woken
+        QMutexLocker locker(&idleMutex);
+        workAvailable.wakeAll();
+    }
+
+    bool take(int workerIndex, QString &dirPath)
+    {
+        // Own queue from the back, which keeps a worker deep in the subtree it's already in
+        {
+            Queue *ownQueue = queues.at(workerIndex);
+            QMutexLocker locker(&ownQueue->mutex);
+            if (!ownQueue->dirPaths.isEmpty())
+            {
+                dirPath = ownQueue->dirPaths.takeLast();
+                return true;
+            }
+        }
+
+        // Steal from the front of someone else's, those folders are closest to the root and likely hold the most work
+        for (int i = 1; i < queues.length(); i++)
+        {
+            Queue *otherQueue = queues.at((workerIndex + i) % queues.length());
+            QMutexLocker locker(&otherQueue->mutex);
+            if (!otherQueue->dirPaths.isEmpty())
+            {
+                dirPath = otherQueue->dirPaths.takeFirst();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void run(int workerIndex)
+    {
+        while (!cancelled.loadAcquire())
+        {
+            QString dirPath;
+            if (!take(workerIndex, dirPath))
+            {
+                QMutexLocker locker(&idleMutex);
+                if (cancelled.loadAcquire() || pendingDirectories.loadAcquire() == 0)
+                    break;
+
+                // Others are still scanning and may turn up more folders
+                if (!take(workerIndex, dirPath))
+                {
+                    workAvailable.wait(&idleMutex);
+                    continue;
+                }
+            }
+
+            QStringList subdirPaths;
+            const QVFolderIndex folderIndex = QVImageCore::getCompatibleFiles(dirPath, sortMode, &subdirPaths);
+
+            if (!subdirPaths.isEmpty())
+            {
+                pendingDirectories.fetchAndAddOrdered(subdirPaths.length());
+                push(workerIndex, subdirPaths);
+            }
+
+            // The last folder wakes everyone up to leave
+            if (pendingDirectories.fetchAndAddOrdered(-1) == 1)
+            {
+                QMutexLocker locker(&idleMutex);
+                workAvailable.wakeAll();
+            }
+
+            if (!folderIndex.isEmpty())
+            {
+                QMutexLocker locker(&resultsMutex);
+                results.append(folderIndex);
+                if (walker && resultsSignalPending.testAndSetOrdered(0, 1))
+                    emit walker->resultsReady();
+            }
+        }
+
+        // Last one out reports the walk as done
+        if (runningWorkers.fetchAndAddOrdered(-1) == 1)
+        {
+            QMutexLocker locker(&resultsMutex);
+            if (walker)
+                emit walker->finished();
+        }
+    }
+
+    // Guarded by resultsMutex, cleared once the walker is gone
+    QVFolderWalker *walker;
+    const int sortMode;
+
+    // One per worker, so workers only meet on a lock when one steals
+    QList<Queue *> queues;
+    QAtomicInt pendingDirectories;
+    QAtomicInt cancelled;
+
+    // Only for idle workers to wait on, nothing else is held with it
+    QMutex idleMutex;
+    QWaitCondition workAvailable;
+
+    QMutex resultsMutex;
+    QList<QVFolderIndex> results;
+    QAtomicInt resultsSignalPending;
+    QAtomicInt runningWorkers;
+};
+
+class QVFolderWalker::Worker : public QRunnable
+{
+public:
+    Worker(const QSharedPointer<WalkState> &state, int workerIndex) : state(state), workerIndex(workerIndex) {}
+
+    void run() override
+    {
+        state->run(workerIndex);
+    }
+
+private:
+    // The last worker to finish frees the state, the walker may be long gone by then
+    QSharedPointer<WalkState> state;
+    int workerIndex;
+};
+
+QVFolderWalker::QVFolderWalker(int sortMode, QObject *parent) : QObject(parent)
+{
+    state = QSharedPointer<WalkState>::create(this, sortMode, getWorkerPool()->maxThreadCount());
+}
+
+QVFolderWalker::~QVFolderWalker()
+{
+    // Workers stop after the folder they are on, but a slow filesystem could keep them there a while, so don't wait
+    cancel();
+
+    QMutexLocker locker(&state->resultsMutex);
+    state->walker = nullptr;
+}
+
+void QVFolderWalker::start(const QStringList &dirPaths)
+{
+    if (dirPaths.isEmpty())
+    {
+        emit finished();
+        return;
+    }
+
+    // Deal the starting folders out so every worker has something before it needs to steal
+    const int workerCount = state->queues.length();
+    for (int i = 0; i < dirPaths.length(); i++)
+        state->queues.at(i % workerCount)->dirPaths.append(dirPaths.at(i));
+
+    state->pendingDirectories.storeRelease(dirPaths.length());
+    state->runningWorkers.storeRelease(workerCount);
+    for (int i = 0; i < workerCount; i++)
+        getWorkerPool()->start(new Worker(state, i));
+}
+
+void QVFolderWalker::cancel()
+{
+    state->cancelled.storeRelease(1);
+
+    QMutexLocker locker(&state->idleMutex);
+    state->workAvailable.wakeAll();
+}
+
+bool QVFolderWalker::isFinished() const
+{
+    return state->runningWorkers.loadAcquire() == 0;
+}
+
+QList<QVFolderIndex> QVFolderWalker::takeResults()
+{
+    QMutexLocker locker(&state->resultsMutex);
+
+    // Cleared along with taking, so a folder finished after this still gets its own signal
+    state->resultsSignalPending.storeRelease(0);
+    QList<QVFolderIndex> takenResults;
+    takenResults.swap(state->results);
+    return takenResults;
+}
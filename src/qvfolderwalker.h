@@ -0,0 +1,45 @@
+#ifndef QVFOLDERWALKER_H
+#define QVFOLDERWALKER_H
+
+#include "qvfolderindex.h"
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QList>
+#include <QStringList>
+
+// Scans a folder tree for compatible files on a pool of workers.
+// Each worker keeps its own queue of folders behind its own lock and steals from the others when it runs dry,
+// and every scanned folder is handed back as soon as it's done instead of after the whole walk.
+// The workers share their state with the walker rather than pointing at it, so deleting a walker never waits on one
+class QVFolderWalker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QVFolderWalker(int sortMode, QObject *parent = nullptr);
+    ~QVFolderWalker() override;
+
+    void start(const QStringList &dirPaths);
+
+    void cancel();
+
+    bool isFinished() const;
+
+    // One unsorted index per folder, in no particular order
+    QList<QVFolderIndex> takeResults();
+
+signals:
+    // Coalesced, so there may be several folders waiting by the time this is handled
+    void resultsReady();
+
+    void finished();
+
+private:
+    class WalkState;
+    class Worker;
+
+    QSharedPointer<WalkState> state;
+};
+
+#endif // QVFOLDERWALKER_H
@@ -0,0 +1,190 @@
+#include "qvframeexporter.h"
+#include "qvanimationindex.h"
+
+#include <QImageReader>
+#include <QImageWriter>
+#include <QBuffer>
+#include <QDir>
+#include <QMutex>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QThread>
+
+namespace
+{
+    // Frames decoded but not yet written, per encoding thread
+    const int QUEUED_FRAMES_PER_THREAD = 2;
+
+    // Qt's PNG writer only takes a quality, which it turns back into a level as (100 - quality) * 9 / 91
+    int getPngQuality(int compressionLevel)
+    {
+        return 100 - (qBound(0, compressionLevel, 9) * 91 + 8) / 9;
+    }
+}
+
+class QVFrameExporter::ExportState
+{
+public:
+    explicit ExportState(int queuedFrameLimit) : freeSlots(queuedFrameLimit) {}
+
+    void fail(const QString &error)
+    {
+        QMutexLocker locker(&mutex);
+        if (errorString.isEmpty())
+            errorString = error;
+        cancelled.storeRelease(1);
+    }
+
+    QSemaphore freeSlots;
+    QAtomicInt cancelled;
+    QAtomicInt framesWritten;
+    QAtomicInt running;
+
+    QMutex mutex;
+    QString errorString;
+};
+
+class QVFrameExporter::Encoder : public QRunnable
+{
+public:
+    Encoder(QVFrameExporter *exporter, const QSharedPointer<ExportState> &state, const QImage &image,
+            const QString &fileName, int quality, int frameTotal) :
+        exporter(exporter), state(state), image(image), fileName(fileName), quality(quality), frameTotal(frameTotal) {}
+
+    void run() override
+    {
+        if (!state->cancelled.loadAcquire())
+        {
+            QImageWriter writer(fileName, "png");
+            writer.setQuality(quality);
+            if (writer.write(image))
+                emit exporter->progressChanged(state->framesWritten.fetchAndAddOrdered(1) + 1, frameTotal);
+            else
+                state->fail(QVFrameExporter::tr("Could not write %1:\n%2").arg(QDir::toNativeSeparators(fileName), writer.errorString()));
+        }
+
+        state->freeSlots.release();
+    }
+
+private:
+    QVFrameExporter *exporter;
+    QSharedPointer<ExportState> state;
+    QImage image;
+    QString fileName;
+    int quality;
+    int frameTotal;
+};
+
+class QVFrameExporter::Decoder : public QRunnable
+{
+public:
+    Decoder(QVFrameExporter *exporter, const QSharedPointer<ExportState> &state, QThreadPool *encodePool,
+            const QByteArray &data, const QByteArray &format, const QString &directory, const QString &baseName,
+            int firstFrame, int lastFrame, int compressionLevel) :
+        exporter(exporter), state(state), encodePool(encodePool), data(data), format(format), directory(directory),
+        baseName(baseName), firstFrame(firstFrame), lastFrame(lastFrame), compressionLevel(compressionLevel) {}
+
+    void run() override
+    {
+        // Frames before the range only need decoding from the keyframe before it
+        const QVAnimationIndex index = QVAnimationIndex::build(data);
+        const int keyframe = index.getKeyframe(firstFrame);
+
+        QBuffer buffer;
+        buffer.setData(index.getStreamFrom(data, keyframe));
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer, format);
+
+        const int frameTotal = lastFrame >= 0 ? lastFrame - firstFrame + 1 : 0;
+        // Files are numbered from 1 like the frames in the export dialog, padded to the widest number in the range
+        const int fieldWidth = QString::number(lastFrame >= 0 ? lastFrame + 1 : qMax(firstFrame + 1, index.frameCount())).length();
+        const int quality = getPngQuality(compressionLevel);
+
+        int frameNumber = keyframe;
+        while (!state->cancelled.loadAcquire() && (lastFrame < 0 || frameNumber <= lastFrame))
+        {
+            const QImage image = reader.read();
+            if (image.isNull())
+            {
+                if (frameNumber == keyframe)
+                    state->fail(QVFrameExporter::tr("Could not decode the animation:\n%1").arg(reader.errorString()));
+                break;
+            }
+
+            if (frameNumber >= firstFrame)
+            {
+                // Waits here while the encoders are behind
+                state->freeSlots.acquire();
+                if (state->cancelled.loadAcquire())
+                {
+                    state->freeSlots.release();
+                    break;
+                }
+
+                const QString fileName = QDir(directory).filePath(QString("%1-%2.png").arg(baseName).arg(frameNumber + 1, fieldWidth, 10, QChar('0')));
+                encodePool->start(new Encoder(exporter, state, image, fileName, quality, frameTotal));
+            }
+            frameNumber++;
+        }
+
+        encodePool->waitForDone();
+
+        QString errorString;
+        {
+            QMutexLocker locker(&state->mutex);
+            errorString = state->errorString;
+        }
+        state->running.storeRelease(0);
+        emit exporter->finished(state->framesWritten.loadAcquire(), errorString);
+    }
+
+private:
+    QVFrameExporter *exporter;
+    QSharedPointer<ExportState> state;
+    QThreadPool *encodePool;
+    QByteArray data;
+    QByteArray format;
+    QString directory;
+    QString baseName;
+    int firstFrame;
+    int lastFrame;
+    int compressionLevel;
+};
+
+QVFrameExporter::QVFrameExporter(QObject *parent) : QObject(parent)
+{
+    decodePool.setMaxThreadCount(1);
+    encodePool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+QVFrameExporter::~QVFrameExporter()
+{
+    // Workers emit our signals, so none may outlive the exporter
+    cancel();
+    decodePool.waitForDone();
+    encodePool.waitForDone();
+}
+
+void QVFrameExporter::start(const QByteArray &data, const QByteArray &format, const QString &directory, const QString &baseName,
+                            int firstFrame, int lastFrame, int compressionLevel)
+{
+    if (isRunning())
+        return;
+
+    state = QSharedPointer<ExportState>::create(encodePool.maxThreadCount() * QUEUED_FRAMES_PER_THREAD);
+    state->running.storeRelease(1);
+    decodePool.start(new Decoder(this, state, &encodePool, data, format, directory, baseName,
+                                 qMax(0, firstFrame), lastFrame, compressionLevel));
+}
+
+void QVFrameExporter::cancel()
+{
+    if (state)
+        state->cancelled.storeRelease(1);
+}
+
+bool QVFrameExporter::isRunning() const
+{
+    return state && state->running.loadAcquire();
+}
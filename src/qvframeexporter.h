@@ -0,0 +1,45 @@
+#ifndef QVFRAMEEXPORTER_H
+#define QVFRAMEEXPORTER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QSharedPointer>
+
+// Writes a range of an animation's frames out as PNGs. Frames have to be decoded in order, so one worker
+// decodes while the encoding and writing, which is where the time goes, is spread across every core.
+// Only a few frames per core are let through ahead of the encoders, so memory stays flat however long the animation is
+class QVFrameExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QVFrameExporter(QObject *parent = nullptr);
+    ~QVFrameExporter() override;
+
+    // firstFrame and lastFrame count from 0, lastFrame -1 goes on to the end.
+    // Files are written as baseName-<frame>.png with the frame counted from 1, the way the export dialog shows it.
+    // compressionLevel is zlib's, 0 for the fastest and 9 for the smallest files
+    void start(const QByteArray &data, const QByteArray &format, const QString &directory, const QString &baseName,
+               int firstFrame, int lastFrame, int compressionLevel);
+
+    // Frames already being written are finished, nothing new is started
+    void cancel();
+
+    bool isRunning() const;
+
+signals:
+    // Both are emitted from worker threads. frameTotal is 0 when the end of the range isn't known
+    void progressChanged(int framesWritten, int frameTotal);
+    void finished(int framesWritten, const QString &errorString);
+
+private:
+    class ExportState;
+    class Decoder;
+    class Encoder;
+
+    QThreadPool decodePool;
+    QThreadPool encodePool;
+    QSharedPointer<ExportState> state;
+};
+
+#endif // QVFRAMEEXPORTER_H
@@ -7,10 +7,11 @@
 #include <QGraphicsScene>
 #include <QSettings>
 #include <QMessageBox>
-#include <QMovie>
 #include <QtMath>
 #include <QGestureEvent>
 #include <QScrollBar>
+#include <QPainter>
+#include <QDebug>
 
 QVGraphicsView::QVGraphicsView(QWidget *parent) : QGraphicsView(parent)
 {
@@ -49,8 +50,11 @@ QVGraphicsView::QVGraphicsView(QWidget *parent) : QGraphicsView(parent)
 
     connect(&imageCore, &QVImageCore::animatedFrameChanged, this, &QVGraphicsView::animatedFrameChanged);
     connect(&imageCore, &QVImageCore::fileChanged, this, &QVGraphicsView::postLoad);
+    connect(&imageCore, &QVImageCore::folderInfoChanged, this, &QVGraphicsView::folderInfoChanged);
     connect(&imageCore, &QVImageCore::updateLoadedPixmapItem, this, &QVGraphicsView::updateLoadedPixmapItem);
     connect(&imageCore, &QVImageCore::readError, this, &QVGraphicsView::error);
+    connect(&imageCore, &QVImageCore::scalingFinished, this, &QVGraphicsView::scalingFinished);
+    connect(&imageCore, &QVImageCore::animatedFrameScaled, this, &QVGraphicsView::animatedFrameScaled);
 
     // Should replace the other timer eventually
     expensiveScaleTimerNew = new QTimer(this);
@@ -59,17 +63,117 @@ QVGraphicsView::QVGraphicsView(QWidget *parent) : QGraphicsView(parent)
     connect(expensiveScaleTimerNew, &QTimer::timeout, this, [this]{scaleExpensively();});
 
 
-    loadedPixmapItem = new QGraphicsPixmapItem();
+    loadedPixmapItem = new QVPixmapItem();
     scene->addItem(loadedPixmapItem);
 
+    // QV_RENDER_STATS=1 shows the timing overlay, any other value is a path every window appends its samples to as CSV on close
+    const QByteArray renderStatsSetting = qgetenv("QV_RENDER_STATS");
+    pendingInputTime = -1;
+    pendingFrameDueTime = -1;
+    nextFrameDueTime = -1;
+    if (!renderStatsSetting.isEmpty())
+    {
+        renderStats.reset(new QVRenderStats());
+        if (renderStatsSetting != "1")
+            renderStatsCsvPath = QString::fromLocal8Bit(renderStatsSetting);
+
+        // The overlay only changes when it's repainted, and nothing else may repaint that corner for a while
+        auto *renderStatsTimer = new QTimer(this);
+        renderStatsTimer->setInterval(1000);
+        connect(renderStatsTimer, &QTimer::timeout, this, [this]{viewport()->update(renderStats->getOverlayRect());});
+        renderStatsTimer->start();
+    }
+
+    scaledTileItem = new QGraphicsPixmapItem();
+    scaledTileItem->setZValue(1);
+    scaledTileItem->hide();
+    scene->addItem(scaledTileItem);
+
     // Connect to settings signal
     connect(&qvApp->getSettingsManager(), &SettingsManager::settingsUpdated, this, &QVGraphicsView::settingsUpdated);
     settingsUpdated();
 }
 
 
+QVGraphicsView::~QVGraphicsView()
+{
+    if (renderStats && !renderStatsCsvPath.isEmpty() && !renderStats->exportCsv(renderStatsCsvPath))
+        qWarning() << "Failed to write render stats to" << renderStatsCsvPath;
+}
+
 // Events
 
+void QVGraphicsView::paintEvent(QPaintEvent *event)
+{
+    if (!renderStats)
+    {
+        QGraphicsView::paintEvent(event);
+        return;
+    }
+
+    const qint64 paintStart = renderStats->now();
+    QGraphicsView::paintEvent(event);
+    const qint64 paintEnd = renderStats->now();
+
+    // Refreshes of just the overlay would only measure the overlay
+    if (renderStats->getOverlayRect().contains(event->rect()))
+        return;
+
+    renderStats->addSample(QVRenderStats::Metric::Paint, paintEnd - paintStart);
+
+    if (pendingInputTime >= 0)
+    {
+        renderStats->addSample(pendingInputMetric, paintEnd - pendingInputTime);
+        pendingInputTime = -1;
+    }
+
+    if (pendingFrameDueTime >= 0)
+    {
+        renderStats->addSample(QVRenderStats::Metric::FrameLateness, paintEnd - pendingFrameDueTime);
+        pendingFrameDueTime = -1;
+    }
+}
+
+void QVGraphicsView::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsView::drawForeground(painter, rect);
+
+    if (!renderStats)
+        return;
+
+    painter->save();
+    painter->resetTransform();
+    renderStats->drawOverlay(painter);
+    painter->restore();
+}
+
+bool QVGraphicsView::viewportEvent(QEvent *event)
+{
+    // Wheel and resize events arrive on the viewport, not the view
+    if (event->type() == QEvent::Wheel)
+        recordInput(QVRenderStats::Metric::WheelLatency);
+    else if (event->type() == QEvent::Resize)
+        recordInput(QVRenderStats::Metric::ResizeLatency);
+
+    return QGraphicsView::viewportEvent(event);
+}
+
+void QVGraphicsView::recordInput(QVRenderStats::Metric metric)
+{
+    // Latency counts from the first input that hasn't been painted yet
+    if (!renderStats || pendingInputTime >= 0)
+        return;
+
+    pendingInputTime = renderStats->now();
+    pendingInputMetric = metric;
+}
+
+void QVGraphicsView::scrollContentsBy(int dx, int dy)
+{
+    QGraphicsView::scrollContentsBy(dx, dy);
+    updateScaledTile();
+}
+
 void QVGraphicsView::resizeEvent(QResizeEvent *event)
 {
     QGraphicsView::resizeEvent(event);
@@ -124,6 +228,10 @@ void QVGraphicsView::mouseReleaseEvent(QMouseEvent *event)
 
 bool QVGraphicsView::event(QEvent *event)
 {
+    // Shortcuts are matched before the key press ever gets here, but the override check always comes first
+    if (event->type() == QEvent::ShortcutOverride || event->type() == QEvent::KeyPress)
+        recordInput(QVRenderStats::Metric::KeyLatency);
+
     //this is for touchpad pinch gestures
     if (event->type() == QEvent::Gesture)
     {
@@ -195,7 +303,8 @@ QMimeData *QVGraphicsView::getMimeData() const
         return mimeData;
 
     mimeData->setUrls({QUrl::fromLocalFile(imageCore.getCurrentFileDetails().fileInfo.absoluteFilePath())});
-    mimeData->setImageData(imageCore.getLoadedPixmap().toImage());
+    // The only place the pixels themselves need turning
+    mimeData->setImageData(imageCore.matchCurrentRotation(imageCore.getLoadedImage()));
     return mimeData;
 }
 
@@ -230,6 +339,7 @@ void QVGraphicsView::loadFile(const QString &fileName)
 
 void QVGraphicsView::postLoad()
 {
+    nextFrameDueTime = -1;
     updateLoadedPixmapItem();
     qvApp->getActionManager().addFileToRecentsList(getCurrentFileDetails().fileInfo);
 
@@ -258,6 +368,9 @@ void QVGraphicsView::zoom(qreal scaleFactor, const QPoint &pos)
 
     const QPointF scenePos = mapToScene(pos);
 
+    // A scale still in progress was for the old zoom level
+    imageCore.cancelScaling();
+
     zoomBasisScaleFactor *= scaleFactor;
     setTransform(QTransform(zoomBasis).scale(zoomBasisScaleFactor, zoomBasisScaleFactor));
     absoluteTransform.scale(scaleFactor, scaleFactor);
@@ -283,15 +396,6 @@ void QVGraphicsView::zoom(qreal scaleFactor, const QPoint &pos)
 
 void QVGraphicsView::scaleExpensively()
 {
-    // Determine if mirrored or flipped
-    bool mirrored = false;
-    if (transform().m11() < 0)
-        mirrored = true;
-
-    bool flipped = false;
-    if (transform().m22() < 0)
-        flipped = true;
-
     // If we are above maximum scaling size
     if ((currentScale >= maxScalingTwoSize) ||
         (!isScalingTwoEnabled && currentScale > 1.00001))
@@ -305,15 +409,31 @@ void QVGraphicsView::scaleExpensively()
     const QRectF mappedRect = absoluteTransform.mapRect(QRectF({}, getCurrentFileDetails().loadedPixmapSize));
     const QSizeF mappedPixmapSize = mappedRect.size() * devicePixelRatioF();
 
-    // Undo mirror/flip before new transform
-    if (mirrored)
-        scale(-1, 1);
+    // The current pixmap stays up with the fast transform until the smooth one is ready
+    imageCore.requestScaling(mappedPixmapSize, getScalingRect());
+}
 
-    if (flipped)
-        scale(1, -1);
+void QVGraphicsView::scalingFinished(const QPixmap &scaledPixmap, const QRect &sourceRect)
+{
+    if (!sourceRect.isNull())
+    {
+        showScaledTile(scaledPixmap, sourceRect);
+        return;
+    }
+
+    hideScaledTile();
+
+    // Determine if mirrored or flipped
+    bool mirrored = false;
+    if (transform().m11() < 0)
+        mirrored = true;
+
+    bool flipped = false;
+    if (transform().m22() < 0)
+        flipped = true;
 
     // Set image to scaled version
-    loadedPixmapItem->setPixmap(imageCore.scaleExpensively(mappedPixmapSize));
+    loadedPixmapItem->setPixmap(scaledPixmap);
 
     // Reset transformation
     setTransform(QTransform::fromScale(qPow(devicePixelRatioF(), -1), qPow(devicePixelRatioF(), -1)));
@@ -330,8 +450,107 @@ void QVGraphicsView::scaleExpensively()
     zoomBasisScaleFactor = 1.0;
 }
 
+void QVGraphicsView::animatedFrameScaled(const QPixmap &scaledPixmap, const QRect &changedRect)
+{
+    const qreal scale = qPow(devicePixelRatioF(), -1);
+    const QTransform scaledTransform = QTransform::fromScale(transform().m11() < 0 ? -scale : scale,
+                                                             transform().m22() < 0 ? -scale : scale);
+
+    // Still at the zoom the last frame was scaled for, so only the part that changed needs painting
+    if (!scaledTileItem->isVisible() && transform() == scaledTransform && loadedPixmapItem->pixmap().size() == scaledPixmap.size())
+    {
+        loadedPixmapItem->setFramePixmap(scaledPixmap, changedRect);
+        return;
+    }
+
+    scalingFinished(scaledPixmap, QRect());
+}
+
+QRectF QVGraphicsView::getVisibleImageRect() const
+{
+    // The item holds either the original or a scaled copy of the whole image, so go through its size.
+    // Mapping into the item takes its rotation back out, so this is in unrotated image pixels
+    const QRectF itemRect = loadedPixmapItem->mapRectFromScene(mapToScene(viewport()->rect()).boundingRect());
+    const QSizeF itemSize = loadedPixmapItem->boundingRect().size();
+    if (itemSize.isEmpty())
+        return QRectF();
+
+    const QSize imageSize = getLoadedPixmap().size();
+    const qreal xRatio = imageSize.width() / itemSize.width();
+    const qreal yRatio = imageSize.height() / itemSize.height();
+    return QRectF(itemRect.x() * xRatio, itemRect.y() * yRatio, itemRect.width() * xRatio, itemRect.height() * yRatio)
+            & QRectF(QPointF(), imageSize);
+}
+
+QRect QVGraphicsView::getScalingRect() const
+{
+    if (getCurrentFileDetails().isMovieLoaded)
+        return QRect();
+
+    const QRect imageRect = getLoadedPixmap().rect();
+    const QRectF visibleRect = getVisibleImageRect();
+    if (visibleRect.isEmpty())
+        return QRect();
+
+    const qreal xMargin = visibleRect.width() * SCALED_TILE_MARGIN;
+    const qreal yMargin = visibleRect.height() * SCALED_TILE_MARGIN;
+    const QRect tileRect = visibleRect.adjusted(-xMargin, -yMargin, xMargin, yMargin).toAlignedRect() & imageRect;
+
+    // Everything would be scaled anyway, so skip the tile
+    if (tileRect == imageRect)
+        return QRect();
+
+    return tileRect;
+}
+
+void QVGraphicsView::showScaledTile(const QPixmap &scaledPixmap, const QRect &sourceRect)
+{
+    // The item goes back to the original so the scene is in image pixels, and the tile sits on top of its part of it
+    if (scaledTileRect.isNull())
+        makeUnscaled();
+
+    // Placed within the unrotated image, then turned along with it
+    scaledTileRect = sourceRect;
+    scaledTileItem->setPixmap(scaledPixmap);
+    const QSizeF tileSize = scaledTileItem->boundingRect().size();
+    scaledTileItem->setTransform(QTransform::fromScale(sourceRect.width() / tileSize.width(), sourceRect.height() / tileSize.height()) *
+                                 QTransform::fromTranslate(sourceRect.left(), sourceRect.top()) * loadedPixmapItem->transform());
+    scaledTileItem->show();
+
+    updateScaledTile();
+}
+
+void QVGraphicsView::hideScaledTile()
+{
+    scaledTileRect = QRect();
+    scaledTileItem->hide();
+    scaledTileItem->setPixmap(QPixmap());
+    loadedPixmapItem->show();
+}
+
+void QVGraphicsView::updateScaledTile()
+{
+    if (scaledTileRect.isNull())
+        return;
+
+    const QRectF visibleRect = getVisibleImageRect();
+
+    // The fast transformed original only needs drawing where the tile doesn't reach
+    loadedPixmapItem->setVisible(!QRectF(scaledTileRect).contains(visibleRect));
+
+    // Render the next tile once half the margin is used up, so it's usually ready before the edge shows
+    const qreal xMargin = visibleRect.width() * SCALED_TILE_MARGIN / 2;
+    const qreal yMargin = visibleRect.height() * SCALED_TILE_MARGIN / 2;
+    const QRectF neededRect = visibleRect.adjusted(-xMargin, -yMargin, xMargin, yMargin) & QRectF(getLoadedPixmap().rect());
+    if (!QRectF(scaledTileRect).contains(neededRect) && !expensiveScaleTimerNew->isActive())
+        expensiveScaleTimerNew->start();
+}
+
 void QVGraphicsView::makeUnscaled()
 {
+    imageCore.cancelScaling();
+    hideScaledTile();
+
     // Determine if mirrored or flipped
     bool mirrored = false;
     if (transform().m11() < 0)
@@ -363,24 +582,40 @@ void QVGraphicsView::makeUnscaled()
 
 void QVGraphicsView::animatedFrameChanged(QRect rect)
 {
-    Q_UNUSED(rect)
+    // Each frame is due one frame delay after the previous one arrived, lateness is measured to when it's painted
+    if (renderStats)
+    {
+        const qint64 now = renderStats->now();
+        if (nextFrameDueTime >= 0)
+            pendingFrameDueTime = nextFrameDueTime;
+        nextFrameDueTime = now + static_cast<qint64>(getLoadedMovie().nextFrameDelay()) * 1000000;
+    }
 
-    if (isScalingEnabled)
+    // A frame shown at its own size, unscaled or at 1:1, goes straight up without a smooth pass
+    if (isScalingEnabled && loadedPixmapItem->pixmap().size() != getLoadedPixmap().size())
     {
         scaleExpensively();
     }
     else
     {
-        loadedPixmapItem->setPixmap(getLoadedMovie().currentPixmap());
+        // rect is what changed since the last frame, in the frame's own pixels like the item
+        loadedPixmapItem->setFramePixmap(getLoadedMovie().currentPixmap(), rect);
     }
 }
 
 void QVGraphicsView::updateLoadedPixmapItem()
 {
-    //set pixmap and offset
-    loadedPixmapItem->setPixmap(getLoadedPixmap());
+    hideScaledTile();
+
+    //set pixmap and offset, a paused animation keeps the frame it's on when turned
+    const QPixmap framePixmap = getCurrentFileDetails().isMovieLoaded ? getLoadedMovie().currentPixmap() : QPixmap();
+    loadedPixmapItem->setPixmap(framePixmap.isNull() ? getLoadedPixmap() : framePixmap);
     scaledSize = loadedPixmapItem->boundingRect().size().toSize();
 
+    // Rotation is only a transform on the item, about its origin so it holds for scaled copies too.
+    // Mirroring and flipping stay on the view, so they keep going along the screen's axes
+    loadedPixmapItem->setTransform(QTransform().rotate(imageCore.getCurrentRotation()));
+
     resetScale();
 
     emit updatedLoadedPixmapItem();
@@ -424,7 +659,7 @@ void QVGraphicsView::originalSize()
 void QVGraphicsView::goToFile(const GoToFileMode &mode, int index)
 {
     imageCore.updateFolderInfo();
-    if (getCurrentFileDetails().folderFileInfoList.isEmpty())
+    if (getCurrentFileDetails().folderIndex.isEmpty())
         return;
 
     int newIndex = getCurrentFileDetails().loadedIndexInFolder;
@@ -445,7 +680,7 @@ void QVGraphicsView::goToFile(const GoToFileMode &mode, int index)
         if (newIndex == 0)
         {
             if (isLoopFoldersEnabled)
-                newIndex = getCurrentFileDetails().folderFileInfoList.size()-1;
+                newIndex = getCurrentFileDetails().folderIndex.count()-1;
             else
                 emit cancelSlideshow();
         }
@@ -455,7 +690,7 @@ void QVGraphicsView::goToFile(const GoToFileMode &mode, int index)
     }
     case GoToFileMode::next:
     {
-        if (getCurrentFileDetails().folderFileInfoList.size()-1 == newIndex)
+        if (getCurrentFileDetails().folderIndex.count()-1 == newIndex)
         {
             if (isLoopFoldersEnabled)
                 newIndex = 0;
@@ -468,13 +703,13 @@ void QVGraphicsView::goToFile(const GoToFileMode &mode, int index)
     }
     case GoToFileMode::last:
     {
-        newIndex = getCurrentFileDetails().folderFileInfoList.size()-1;
+        newIndex = getCurrentFileDetails().folderIndex.count()-1;
         break;
     }
     }
 
-    const QFileInfo nextImage = getCurrentFileDetails().folderFileInfoList.value(newIndex);
-    if (!nextImage.isFile())
+    const QFileInfo nextImage(getCurrentFileDetails().folderIndex.absoluteFilePath(newIndex));
+    if (!nextImage.isFile() && !QVArchive::isArchiveEntryPath(nextImage.absoluteFilePath()))
         return;
 
     loadFile(nextImage.absoluteFilePath());
@@ -557,6 +792,7 @@ void QVGraphicsView::fitInViewMarginless(const QRectF &rect)
     qreal absoluteRatio = qMin(viewRect.width() / sceneRect2.width(),
                                viewRect.height() / sceneRect2.height());
 
+    imageCore.cancelScaling();
     absoluteTransform = QTransform::fromScale(absoluteRatio, absoluteRatio);
 
     // Scale and center on the center of \a rect.
@@ -647,6 +883,7 @@ void QVGraphicsView::settingsUpdated()
         loadedPixmapItem->setTransformationMode(Qt::SmoothTransformation);
     else
         loadedPixmapItem->setTransformationMode(Qt::FastTransformation);
+    scaledTileItem->setTransformationMode(loadedPixmapItem->transformationMode());
 
     //scaling
     isScalingEnabled = settingsManager.getBoolean("scalingenabled");
@@ -683,16 +920,25 @@ void QVGraphicsView::settingsUpdated()
 
 void QVGraphicsView::closeImage()
 {
+    hideScaledTile();
     imageCore.closeImage();
 }
 
 void QVGraphicsView::jumpToNextFrame()
 {
+    nextFrameDueTime = -1;
     imageCore.jumpToNextFrame();
 }
 
+void QVGraphicsView::jumpToFrame(int frameNumber)
+{
+    nextFrameDueTime = -1;
+    imageCore.jumpToFrame(frameNumber);
+}
+
 void QVGraphicsView::setPaused(const bool &desiredState)
 {
+    nextFrameDueTime = -1;
     imageCore.setPaused(desiredState);
 }
 
@@ -705,3 +951,8 @@ void QVGraphicsView::rotateImage(int rotation)
 {
     imageCore.rotateImage(rotation);
 }
+
+void QVGraphicsView::removeFromCache(const QString &filePath)
+{
+    imageCore.removeFromCache(filePath);
+}
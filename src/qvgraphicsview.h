@@ -2,6 +2,8 @@
 #define QVGRAPHICSVIEW_H
 
 #include "qvimagecore.h"
+#include "qvrenderstats.h"
+#include "qvpixmapitem.h"
 #include <QGraphicsView>
 #include <QImageReader>
 #include <QMimeData>
@@ -15,6 +17,7 @@ class QVGraphicsView : public QGraphicsView
 
 public:
     QVGraphicsView(QWidget *parent = nullptr);
+    ~QVGraphicsView() override;
 
     enum class ScaleMode
     {
@@ -56,19 +59,30 @@ public:
 
     void closeImage();
     void jumpToNextFrame();
+    void jumpToFrame(int frameNumber);
     void setPaused(const bool &desiredState);
     void setSpeed(const int &desiredSpeed);
     void rotateImage(int rotation);
+    int getCurrentRotation() const { return imageCore.getCurrentRotation(); }
+
+    // Mirroring and flipping live in the view's own transform, unlike rotation
+    bool isMirrored() const { return transform().m11() < 0; }
+    bool isFlipped() const { return transform().m22() < 0; }
+
+    // For when the file has changed on disk
+    void removeFromCache(const QString &filePath);
 
     const QVImageCore::FileDetails& getCurrentFileDetails() const { return imageCore.getCurrentFileDetails(); }
     const QPixmap& getLoadedPixmap() const { return imageCore.getLoadedPixmap(); }
-    const QMovie& getLoadedMovie() const { return imageCore.getLoadedMovie(); }
+    const QVAnimationPlayer& getLoadedMovie() const { return imageCore.getLoadedMovie(); }
 
 signals:
     void cancelSlideshow();
 
     void fileChanged();
 
+    void folderInfoChanged();
+
     void updatedLoadedPixmapItem();
 
 protected:
@@ -76,6 +90,14 @@ protected:
 
     void resizeEvent(QResizeEvent *event) override;
 
+    void paintEvent(QPaintEvent *event) override;
+
+    void drawForeground(QPainter *painter, const QRectF &rect) override;
+
+    bool viewportEvent(QEvent *event) override;
+
+    void scrollContentsBy(int dx, int dy) override;
+
     void dropEvent(QDropEvent *event) override;
 
     void dragEnterEvent(QDragEnterEvent *event) override;
@@ -103,10 +125,23 @@ protected:
 
     void centerOn(const QGraphicsItem *item);
 
+    QRectF getVisibleImageRect() const;
+    QRect getScalingRect() const;
+
+    void showScaledTile(const QPixmap &scaledPixmap, const QRect &sourceRect);
+    void hideScaledTile();
+    void updateScaledTile();
+
+    void recordInput(QVRenderStats::Metric metric);
+
 
 private slots:
     void animatedFrameChanged(QRect rect);
 
+    void scalingFinished(const QPixmap &scaledPixmap, const QRect &sourceRect);
+
+    void animatedFrameScaled(const QPixmap &scaledPixmap, const QRect &changedRect);
+
     void postLoad();
 
     void updateLoadedPixmapItem();
@@ -116,7 +151,11 @@ private slots:
 private:
 
 
-    QGraphicsPixmapItem *loadedPixmapItem;
+    QVPixmapItem *loadedPixmapItem;
+
+    // When zoomed in far enough, only the visible part of the image plus a margin is smoothly scaled
+    QGraphicsPixmapItem *scaledTileItem;
+    QRect scaledTileRect;
 
     bool isFilteringEnabled;
     bool isScalingEnabled;
@@ -130,6 +169,9 @@ private:
 
     const int MARGIN = -2;
 
+    // Extra scaled area around the viewport on each side, as a fraction of the visible size
+    const qreal SCALED_TILE_MARGIN = 0.5;
+
     qreal currentScale;
     QSize scaledSize;
     bool isOriginalSize;
@@ -142,6 +184,14 @@ private:
     QVImageCore imageCore;
 
     QTimer *expensiveScaleTimerNew;
+
+    // Only set when QV_RENDER_STATS is, timestamps are from its clock and -1 when nothing is pending
+    QScopedPointer<QVRenderStats> renderStats;
+    QString renderStatsCsvPath;
+    qint64 pendingInputTime;
+    QVRenderStats::Metric pendingInputMetric;
+    qint64 pendingFrameDueTime;
+    qint64 nextFrameDueTime;
     QPointF centerPoint;
 };
 #endif // QVGRAPHICSVIEW_H
@@ -1,17 +1,73 @@
 #include "qvimagecore.h"
 #include "qvapplication.h"
+#include "qvimagescaler.h"
+#include "qvcolormanager.h"
+#ifdef LINUX_LOADED
+#include "qvlinuxfunctions.h"
+#endif
 #include <random>
+#include <cstring>
 #include <QMessageBox>
 #include <QDir>
 #include <QUrl>
 #include <QSettings>
 #include <QCollator>
 #include <QtConcurrent/QtConcurrentRun>
-#include <QPixmapCache>
 #include <QIcon>
 #include <QGuiApplication>
 #include <QScreen>
 
+namespace
+{
+    // Below this the original is scaled directly, a pyramid wouldn't pay for itself
+    const int MIPMAP_MIN_IMAGE_SIZE = 2048;
+
+    // No point keeping levels smaller than a thumbnail
+    const int MIPMAP_MIN_LEVEL_SIZE = 256;
+
+    // Preloaded images allowed in each preloading mode, in KiB
+    const int IMAGE_CACHE_LIMIT_NORMAL = 51200;
+    const int IMAGE_CACHE_LIMIT_EXTENDED = 204800;
+
+    // Memory allowed for each of the player's kept frames and our scaled copies of them
+    const qint64 ANIMATION_CACHE_LIMIT = 256 * 1024 * 1024;
+
+    // Most a preloaded animation may spend on frames decoded ahead, further bounded to a quarter of the cache
+    const qint64 ANIMATION_PRELOAD_LIMIT = 32 * 1024 * 1024;
+
+    // Files inside an archive have no size or date of their own on disk, so they are as current as the archive
+    QFileInfo getSourceFileInfo(const QString &filePath)
+    {
+        QString archivePath;
+        QString entryName;
+        if (QVArchive::splitPath(filePath, archivePath, entryName))
+            return QFileInfo(archivePath);
+
+        return QFileInfo(filePath);
+    }
+
+    // The part of a copy of an image scaled to scaledSize that reads from rect of the original.
+    // Lanczos-3 reaches three pixels of the copy either side, enlarging one pixel of the original
+    QRect getScaledRect(const QRect &rect, const QSize &imageSize, const QSize &scaledSize)
+    {
+        if (rect.isEmpty() || imageSize == scaledSize || imageSize.isEmpty())
+            return rect;
+
+        const qreal xScale = static_cast<qreal>(scaledSize.width()) / imageSize.width();
+        const qreal yScale = static_cast<qreal>(scaledSize.height()) / imageSize.height();
+        const qreal xMargin = qMax<qreal>(3, xScale);
+        const qreal yMargin = qMax<qreal>(3, yScale);
+        const QRectF scaledRect(rect.x() * xScale - xMargin, rect.y() * yScale - yMargin,
+                                rect.width() * xScale + xMargin * 2, rect.height() * yScale + yMargin * 2);
+        return scaledRect.toAlignedRect() & QRect(QPoint(), scaledSize);
+    }
+
+    int getImageCost(const QImage &image)
+    {
+        return static_cast<int>(qMax<qint64>(1, static_cast<qint64>(image.bytesPerLine()) * image.height() / 1024));
+    }
+}
+
 QVImageCore::QVImageCore(QObject *parent) : QObject(parent)
 {
 // Set allocation limit to 8 GiB on Qt6
@@ -20,17 +76,24 @@ QVImageCore::QVImageCore(QObject *parent) : QObject(parent)
 #endif
 
     isLoopFoldersEnabled = true;
+    isRecursiveFoldersEnabled = false;
     preloadingMode = 1;
     sortMode = 0;
     sortDescending = false;
+    archiveSortMode = 0;
+    archiveSortDescending = false;
+    isColorManagementEnabled = true;
 
     randomSortSeed = 0;
 
+    folderWalker = nullptr;
+    loadFirstWalkedFile = false;
+
     currentRotation = 0;
 
-    QPixmapCache::setCacheLimit(51200);
+    imageCache.setMaxCost(IMAGE_CACHE_LIMIT_NORMAL);
 
-    connect(&loadedMovie, &QMovie::updated, this, &QVImageCore::animatedFrameChanged);
+    connect(&loadedMovie, &QVAnimationPlayer::updated, this, &QVImageCore::movieUpdated);
 
     connect(&loadFutureWatcher, &QFutureWatcher<ReadData>::finished, this, [this](){
         loadPixmap(loadFutureWatcher.result(), false);
@@ -58,6 +121,11 @@ QVImageCore::QVImageCore(QObject *parent) : QObject(parent)
 
     waitingOnLoad = false;
 
+    mipmapGeneration = 0;
+    scaleGeneration = 0;
+    scaledFrameCacheBytes = 0;
+    shownFrameChangedFromKey = 0;
+
     // Connect to settings signal
     connect(&qvApp->getSettingsManager(), &SettingsManager::settingsUpdated, this, &QVImageCore::settingsUpdated);
     settingsUpdated();
@@ -80,6 +148,20 @@ void QVImageCore::loadFile(const QString &fileName)
     QFileInfo fileInfo(sanitaryFileName);
     sanitaryFileName = fileInfo.absoluteFilePath();
 
+    // In recursive mode a folder opens as a playlist of everything below it
+    if (isRecursiveFoldersEnabled && fileInfo.isDir())
+    {
+        loadFolder(sanitaryFileName);
+        return;
+    }
+
+    // Archives open like a folder, starting with their first image
+    if (QVArchive::isArchive(sanitaryFileName))
+    {
+        loadArchive(sanitaryFileName);
+        return;
+    }
+
     // Pause playing movie because it feels better that way
     setPaused(true);
 
@@ -89,16 +171,24 @@ void QVImageCore::loadFile(const QString &fileName)
 
     //check if cached already before loading the long way
     auto previouslyRecordedFileSize = qvApp->getPreviouslyRecordedFileSize(sanitaryFileName);
-    auto *cachedPixmap = new QPixmap();
-    if (QPixmapCache::find(sanitaryFileName, cachedPixmap) &&
-        !cachedPixmap->isNull() &&
-        previouslyRecordedFileSize == fileInfo.size())
+    const QFileInfo sourceFileInfo = getSourceFileInfo(sanitaryFileName);
+    ReadData cachedData;
+    {
+        QMutexLocker locker(&imageCacheMutex);
+        if (const ReadData *cached = imageCache.object(sanitaryFileName))
+            cachedData = *cached;
+    }
+    if (!cachedData.image.isNull() &&
+        previouslyRecordedFileSize == sourceFileInfo.size() &&
+        cachedData.sourceLastModified == sourceFileInfo.lastModified().toMSecsSinceEpoch())
     {
-        QSize previouslyRecordedImageSize = qvApp->getPreviouslyRecordedImageSize(sanitaryFileName);
         ReadData readData = {
-            matchCurrentRotation(*cachedPixmap),
+            cachedData.image,
             fileInfo,
-            previouslyRecordedImageSize
+            qvApp->getPreviouslyRecordedImageSize(sanitaryFileName),
+            cachedData.animation,
+            cachedData.sourceSize,
+            cachedData.sourceLastModified
         };
         loadPixmap(readData, true);
     }
@@ -110,41 +200,91 @@ void QVImageCore::loadFile(const QString &fileName)
         loadFutureWatcher.setFuture(QtConcurrent::run(&QVImageCore::readFile, this, sanitaryFileName, false));
 #endif
     }
-    delete cachedPixmap;
 }
 
 QVImageCore::ReadData QVImageCore::readFile(const QString &fileName, bool forCache)
 {
+    // Archive entries are decoded from memory, the archive stays alive until we're done with its data
+    QString archivePath;
+    QString entryName;
+    QSharedPointer<QVArchive> archive;
+    QBuffer archiveBuffer;
+    const bool isArchiveEntry = QVArchive::splitPath(fileName, archivePath, entryName);
+
+    // Taken before reading, so a file replaced while it's being read doesn't look current afterwards
+    const QFileInfo sourceFileInfo = getSourceFileInfo(fileName);
+
     QImageReader imageReader;
     imageReader.setDecideFormatFromContent(true);
     imageReader.setAutoTransform(true);
 
-    imageReader.setFileName(fileName);
+    if (isArchiveEntry)
+    {
+        archive = QVArchive::open(archivePath);
+        if (archive)
+            archiveBuffer.setData(archive->readEntry(entryName));
+        imageReader.setDevice(&archiveBuffer);
+    }
+    else
+    {
+        imageReader.setFileName(fileName);
+    }
 
-    QPixmap readPixmap;
-    if (imageReader.format() == "svg" || imageReader.format() == "svgz")
+    QImage readImage;
+    if (!isArchiveEntry && (imageReader.format() == "svg" || imageReader.format() == "svgz"))
     {
         // Render vectors into a high resolution
         QIcon icon;
         icon.addFile(fileName);
-        readPixmap = icon.pixmap(largestDimension);
+        readImage = icon.pixmap(largestDimension).toImage();
         // If this fails, try reading the normal way so that a proper error message is given
-        if (readPixmap.isNull())
-            readPixmap = QPixmap::fromImageReader(&imageReader);
+        if (readImage.isNull())
+            readImage = imageReader.read();
     }
     else
     {
-        readPixmap = QPixmap::fromImageReader(&imageReader);
+        readImage = imageReader.read();
+        if (isColorManagementEnabled)
+            QVColorManager::convertToDisplay(readImage);
+
+        // Done once here on the worker, otherwise every paint and scale converts to premultiplied on the fly
+        QVImageScaler::convertToRasterFormat(readImage);
     }
 
+    // Animations are read into memory here as well, and preloaded ones get their first frames decoded
+    // so they start playing the moment they're shown
+    QVAnimationPlayer::Preload animation;
+    if (!readImage.isNull() && (isArchiveEntry || (imageReader.format() != "svg" && imageReader.format() != "svgz")))
+    {
+        qint64 maxFrameBytes = 0;
+        if (forCache)
+        {
+            QMutexLocker locker(&imageCacheMutex);
+            maxFrameBytes = qMin(ANIMATION_PRELOAD_LIMIT, static_cast<qint64>(imageCache.maxCost()) * 1024 / 4);
+        }
+
+        animation = QVAnimationPlayer::preload(fileName, archiveBuffer.data(), QByteArray(), maxFrameBytes);
+
+        // APNG workaround
+        if (animation.format == "png")
+            animation = QVAnimationPlayer::preload(fileName, archiveBuffer.data(), "apng", maxFrameBytes);
+
+        // Stored archive entries point into the archive's mapping, which goes away with the archive at the end of this
+        // function, while the player keeps the data for as long as the animation plays
+        if (isArchiveEntry && !animation.data.isEmpty())
+            animation.data = QByteArray(animation.data.constData(), animation.data.size());
+    }
 
     ReadData readData = {
-        readPixmap,
+        readImage,
         QFileInfo(fileName),
         imageReader.size(),
+        animation,
+        sourceFileInfo.size(),
+        sourceFileInfo.lastModified().toMSecsSinceEpoch()
     };
     // Only error out when not loading for cache
-    if (readPixmap.isNull() && !forCache)
+    if (readImage.isNull() && !forCache)
     {
         emit readError(imageReader.error(), imageReader.errorString(), readData.fileInfo.fileName());
     }
@@ -161,57 +301,67 @@ void QVImageCore::loadPixmap(const ReadData &readData, bool fromCache)
     // Reset mechanism to avoid stalling while loading
     waitingOnLoad = false;
 
-    if (readData.pixmap.isNull())
+    if (readData.image.isNull())
         return;
 
-    loadedPixmap = matchCurrentRotation(readData.pixmap);
+    // Pixels stay the way they were decoded, rotation is up to the view
+    loadedImage = readData.image;
+    loadedPixmap = QPixmap::fromImage(loadedImage);
 
     // Set file details
     currentFileDetails.isPixmapLoaded = true;
     currentFileDetails.baseImageSize = readData.size;
-    currentFileDetails.loadedPixmapSize = loadedPixmap.size();
+    currentFileDetails.loadedPixmapSize = matchCurrentRotation(loadedPixmap.size());
     if (currentFileDetails.baseImageSize == QSize(-1, -1))
     {
         qInfo() << "QImageReader::size gave an invalid size for " + currentFileDetails.fileInfo.fileName() + ", using size from loaded pixmap";
-        currentFileDetails.baseImageSize = currentFileDetails.loadedPixmapSize;
+        currentFileDetails.baseImageSize = loadedPixmap.size();
     }
 
     // If this image isnt originally from the cache, add it to the cache
     if (!fromCache)
         addToCache(readData);
 
-    // Animation detection
-    loadedMovie.setFormat("");
-    loadedMovie.stop();
-    loadedMovie.setFileName(currentFileDetails.fileInfo.absoluteFilePath());
-
-    // APNG workaround
-    if (loadedMovie.format() == "png")
-    {
-        loadedMovie.setFormat("apng");
-        loadedMovie.setFileName(currentFileDetails.fileInfo.absoluteFilePath());
-    }
+    // Animation detection was done along with reading the file
+    loadedMovie.load(readData.animation);
 
     currentFileDetails.isMovieLoaded = loadedMovie.isValid() && loadedMovie.frameCount() != 1;
 
+    // Keep decoded frames so later loops don't decode again, as long as the whole animation fits the budget
+    const qint64 decodedBytes = static_cast<qint64>(loadedPixmap.width()) * loadedPixmap.height() * 4 * loadedMovie.frameCount();
+    loadedMovie.setKeepAllFrames(currentFileDetails.isMovieLoaded && loadedMovie.frameCount() > 0 && decodedBytes <= ANIMATION_CACHE_LIMIT);
+
+    // Starting the movie shows the first frame right away, which must not come from the last animation's cache
+    // or be compared against its last frame
+    clearScaledFrames();
+    shownFrame = QImage();
+    shownFrameChangedRect = QRect();
+    shownFrameChangedFromKey = 0;
+
     if (currentFileDetails.isMovieLoaded)
         loadedMovie.start();
-    else if (auto device = loadedMovie.device())
-        device->close();
+
+    requestMipmaps();
 
     emit fileChanged();
 
-    QtConcurrent::run(&QVImageCore::requestCaching, this);
+    // The worker gets its own copy of the index, the walker keeps replacing currentFileDetails.folderIndex on this thread
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    QtConcurrent::run(this, &QVImageCore::requestCaching, currentFileDetails.folderIndex, currentFileDetails.loadedIndexInFolder);
+#else
+    QtConcurrent::run(&QVImageCore::requestCaching, this, currentFileDetails.folderIndex, currentFileDetails.loadedIndexInFolder);
+#endif
 }
 
 void QVImageCore::closeImage()
 {
+    loadedImage = QImage();
     loadedPixmap = QPixmap();
-    loadedMovie.stop();
-    loadedMovie.setFileName("");
+    loadedMovie.clear();
+    requestMipmaps();
     currentFileDetails = {
         QFileInfo(),
-        currentFileDetails.folderFileInfoList,
+        currentFileDetails.folderIndex,
         currentFileDetails.loadedIndexInFolder,
         false,
         false,
@@ -224,42 +374,147 @@ void QVImageCore::closeImage()
 }
 
 // All file logic, sorting, etc should be moved to a different class or file
-QFileInfoList QVImageCore::getCompatibleFiles()
+QVFolderIndex QVImageCore::getCompatibleFiles(const QString &dirPath, int sortMode, QStringList *subdirPaths)
 {
-    QFileInfoList fileInfoList;
+    QVFolderIndex folderIndex(dirPath);
 
     QMimeDatabase mimeDb;
     const auto &regs = qvApp->getFilterRegExpList();
     const auto &mimeTypes = qvApp->getMimeTypeNameList();
 
-    const QFileInfoList currentFolder = currentFileDetails.fileInfo.dir().entryInfoList();
-    for (const QFileInfo &fileInfo : currentFolder)
-    {
-        bool matched = false;
-        const QString name = fileInfo.fileName();
+    auto isCompatible = [&regs, &mimeTypes, &mimeDb](const QString &name, const QString &absoluteFilePath){
         for (const QRegularExpression &reg : regs)
         {
-            if (reg.match(name).hasMatch()) {
-                matched = true;
-                break;
+            if (reg.match(name).hasMatch())
+                return true;
+        }
+        return mimeTypes.contains(mimeDb.mimeTypeForFile(absoluteFilePath).name());
+    };
+
+    // Archives list like a folder, with the stats coming from their central directory
+    if (QVArchive::isArchive(dirPath))
+    {
+        const auto archive = QVArchive::open(dirPath);
+        if (!archive)
+            return folderIndex;
+
+        const auto &entries = archive->getEntries();
+        folderIndex.reserve(entries.length());
+        for (const QVArchive::Entry &entry : entries)
+        {
+            // Skip resource forks and hidden files the way a folder scan would
+            if (!archive->isEntryReadable(entry) || entry.name.startsWith("__MACOSX/") ||
+                entry.name.startsWith('.') || entry.name.contains("/."))
+                continue;
+
+            const QString name = entry.name.mid(entry.name.lastIndexOf('/') + 1);
+            bool matched = false;
+            for (const QRegularExpression &reg : regs)
+            {
+                if (reg.match(name).hasMatch()) {
+                    matched = true;
+                    break;
+                }
             }
+            if (matched || mimeTypes.contains(mimeDb.mimeTypeForFile(name, QMimeDatabase::MatchExtension).name()))
+                folderIndex.append(entry.name, entry.lastModified, entry.uncompressedSize);
         }
-        if (matched || mimeTypes.contains(mimeDb.mimeTypeForFile(fileInfo).name().toUtf8()))
+        return folderIndex;
+    }
+
+    // Only stat for what the sort mode actually compares
+    const bool wantModified = sortMode == 1;
+    const bool wantSize = sortMode == 2;
+
+    const QString dirPrefix = dirPath.endsWith('/') ? dirPath : dirPath + '/';
+
+#ifdef LINUX_LOADED
+    // Read names straight out of getdents64 and only stat the ones that pass the filter
+    QStringList fileNames;
+    QStringList subdirNames;
+    if (QVLinuxFunctions::listFileNames(dirPath, fileNames, subdirPaths ? &subdirNames : nullptr))
+    {
+        QStringList compatibleFileNames;
+        compatibleFileNames.reserve(fileNames.length());
+        for (const QString &name : qAsConst(fileNames))
         {
-            fileInfoList.append(fileInfo);
+            if (isCompatible(name, dirPrefix + name))
+                compatibleFileNames.append(name);
+        }
+
+        QVector<qint64> lastModifieds;
+        QVector<qint64> sizes;
+        if (QVLinuxFunctions::statFiles(dirPath, compatibleFileNames, wantModified ? &lastModifieds : nullptr, wantSize ? &sizes : nullptr))
+        {
+            folderIndex.reserve(compatibleFileNames.length());
+            for (int i = 0; i < compatibleFileNames.length(); i++)
+            {
+                folderIndex.append(compatibleFileNames.at(i),
+                                   wantModified ? lastModifieds.at(i) : -1,
+                                   wantSize ? sizes.at(i) : -1);
+            }
+
+            if (subdirPaths)
+            {
+                for (const QString &name : qAsConst(subdirNames))
+                    subdirPaths->append(dirPrefix + name);
+            }
+            return folderIndex;
+        }
+    }
+#endif
+
+    if (subdirPaths)
+    {
+        const QStringList subdirEntries = QDir(dirPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+        for (const QString &name : subdirEntries)
+            subdirPaths->append(dirPrefix + name);
+    }
+
+    const QFileInfoList currentFolder = QDir(dirPath).entryInfoList(QDir::Files);
+    folderIndex.reserve(currentFolder.length());
+    for (const QFileInfo &fileInfo : currentFolder)
+    {
+        const QString name = fileInfo.fileName();
+        if (isCompatible(name, dirPrefix + name))
+        {
+            folderIndex.append(name,
+                               wantModified ? fileInfo.lastModified().toMSecsSinceEpoch() : -1,
+                               wantSize ? fileInfo.size() : -1);
         }
     }
 
-    return fileInfoList;
+    return folderIndex;
 }
 
 void QVImageCore::updateFolderInfo()
 {
+    const QString filePath = currentFileDetails.fileInfo.absoluteFilePath();
+
+    QString archivePath;
+    QString entryName;
+    if (QVArchive::splitPath(filePath, archivePath, entryName))
+    {
+        updateArchiveInfo(archivePath);
+        return;
+    }
+
     if (!currentFileDetails.fileInfo.isFile())
         return;
 
-    QPair<QString, uint> dirInfo = {currentFileDetails.fileInfo.absoluteDir().path(),
-                                    currentFileDetails.fileInfo.dir().count()};
+    // Anything below the root of the current walk is already in the playlist
+    if (isRecursiveFoldersEnabled && !recursiveRootPrefix.isEmpty() && filePath.startsWith(recursiveRootPrefix))
+    {
+        currentFileDetails.loadedIndexInFolder = currentFileDetails.folderIndex.indexOf(filePath);
+        if (currentFileDetails.loadedIndexInFolder != -1)
+            return;
+    }
+
+    const QString dirPath = currentFileDetails.fileInfo.absolutePath();
+    QStringList subdirPaths;
+    QVFolderIndex folderIndex = getCompatibleFiles(dirPath, sortMode, isRecursiveFoldersEnabled ? &subdirPaths : nullptr);
+
+    QPair<QString, uint> dirInfo = {dirPath, static_cast<uint>(folderIndex.count())};
     // If the current folder changed since the last image, assign a new seed for random sorting
     if (lastDirInfo != dirInfo)
     {
@@ -267,81 +522,155 @@ void QVImageCore::updateFolderInfo()
     }
     lastDirInfo = dirInfo;
 
+    folderIndex.sort(sortMode, sortDescending, randomSortSeed);
+    currentFileDetails.folderIndex = folderIndex;
 
-    currentFileDetails.folderFileInfoList = getCompatibleFiles();
+    // Set current file index variable
+    currentFileDetails.loadedIndexInFolder = currentFileDetails.folderIndex.indexOf(filePath);
 
-    // Sorting
+    // Subfolders stream in behind the current folder, which is browsable right away
+    if (isRecursiveFoldersEnabled)
+        startFolderWalk(dirPath, subdirPaths);
+    else
+        stopFolderWalk();
+}
 
-    if (sortMode == 0) // Natural sorting
+void QVImageCore::updateArchiveInfo(const QString &archivePath)
+{
+    const QString filePath = currentFileDetails.fileInfo.absoluteFilePath();
+
+    // Archives are indexed once, stepping through them only needs the new position
+    if (currentFileDetails.folderIndex.getDirPath() != archivePath || currentFileDetails.folderIndex.indexOf(filePath) == -1)
     {
-        QCollator collator;
-        collator.setNumericMode(true);
-        std::sort(currentFileDetails.folderFileInfoList.begin(),
-                  currentFileDetails.folderFileInfoList.end(),
-                  [&collator, this](const QFileInfo &file1, const QFileInfo &file2)
-        {
-            if (sortDescending)
-                return collator.compare(file1.fileName(), file2.fileName()) > 0;
-            else
-                return collator.compare(file1.fileName(), file2.fileName()) < 0;
-        });
+        QVFolderIndex folderIndex = getCompatibleFiles(archivePath, sortMode);
+
+        const QPair<QString, uint> dirInfo = {archivePath, static_cast<uint>(folderIndex.count())};
+        if (lastDirInfo != dirInfo)
+            randomSortSeed = std::chrono::system_clock::now().time_since_epoch().count();
+        lastDirInfo = dirInfo;
+
+        folderIndex.sort(sortMode, sortDescending, randomSortSeed);
+        currentFileDetails.folderIndex = folderIndex;
+        stopFolderWalk();
     }
-    else if (sortMode == 1) // last modified
+    else if (archiveSortMode != sortMode || archiveSortDescending != sortDescending)
     {
-        std::sort(currentFileDetails.folderFileInfoList.begin(),
-                  currentFileDetails.folderFileInfoList.end(),
-                  [this](const QFileInfo &file1, const QFileInfo &file2)
-        {
-            if (sortDescending)
-                return file1.lastModified() < file2.lastModified();
-            else
-                return file1.lastModified() > file2.lastModified();
-        });
+        // Entries keep the dates and sizes from the central directory, so they can be sorted again as they are
+        currentFileDetails.folderIndex.sort(sortMode, sortDescending, randomSortSeed);
     }
-    else if (sortMode == 2) // size
+    archiveSortMode = sortMode;
+    archiveSortDescending = sortDescending;
+
+    currentFileDetails.loadedIndexInFolder = currentFileDetails.folderIndex.indexOf(filePath);
+}
+
+void QVImageCore::loadArchive(const QString &archivePath)
+{
+    QVFolderIndex folderIndex = getCompatibleFiles(archivePath, sortMode);
+    if (folderIndex.isEmpty())
     {
-        std::sort(currentFileDetails.folderFileInfoList.begin(),
-                  currentFileDetails.folderFileInfoList.end(),
-                  [this](const QFileInfo &file1, const QFileInfo &file2)
-        {
-            if (sortDescending)
-                return file1.size() < file2.size();
-            else
-                return file1.size() > file2.size();
-        });
+        emit readError(QImageReader::InvalidDataError, tr("No images found in archive"), QFileInfo(archivePath).fileName());
+        return;
     }
-    else if (sortMode == 3) // type
-    {
-        QMimeDatabase mimeDb;
 
-        QCollator collator;
-        std::sort(currentFileDetails.folderFileInfoList.begin(),
-                  currentFileDetails.folderFileInfoList.end(),
-                  [&mimeDb, &collator, this](const QFileInfo &file1, const QFileInfo &file2)
-        {
-            QMimeType mime1 = mimeDb.mimeTypeForFile(file1);
-            QMimeType mime2 = mimeDb.mimeTypeForFile(file2);
+    randomSortSeed = std::chrono::system_clock::now().time_since_epoch().count();
+    lastDirInfo = {archivePath, static_cast<uint>(folderIndex.count())};
 
-            if (sortDescending)
-                return collator.compare(mime1.name(), mime2.name()) > 0;
-            else
-                return collator.compare(mime1.name(), mime2.name()) < 0;
-        });
-    }
-    else if (sortMode == 4) // Random
+    folderIndex.sort(sortMode, sortDescending, randomSortSeed);
+    archiveSortMode = sortMode;
+    archiveSortDescending = sortDescending;
+    currentFileDetails.folderIndex = folderIndex;
+    currentFileDetails.loadedIndexInFolder = -1;
+    stopFolderWalk();
+
+    loadFile(folderIndex.absoluteFilePath(0));
+}
+
+void QVImageCore::loadFolder(const QString &dirPath)
+{
+    QStringList subdirPaths;
+    QVFolderIndex folderIndex = getCompatibleFiles(dirPath, sortMode, &subdirPaths);
+
+    randomSortSeed = std::chrono::system_clock::now().time_since_epoch().count();
+    lastDirInfo = {dirPath, static_cast<uint>(folderIndex.count())};
+
+    folderIndex.sort(sortMode, sortDescending, randomSortSeed);
+    currentFileDetails.folderIndex = folderIndex;
+    currentFileDetails.loadedIndexInFolder = -1;
+
+    startFolderWalk(dirPath, subdirPaths);
+
+    // With no images at the top level, wait for the walk to turn one up
+    if (!folderIndex.isEmpty())
+        loadFile(folderIndex.absoluteFilePath(0));
+    else
+        loadFirstWalkedFile = true;
+}
+
+void QVImageCore::startFolderWalk(const QString &rootPath, const QStringList &subdirPaths)
+{
+    stopFolderWalk();
+
+    recursiveRootPrefix = rootPath.endsWith('/') ? rootPath : rootPath + '/';
+
+    if (subdirPaths.isEmpty())
+        return;
+
+    QVFolderWalker *walker = new QVFolderWalker(sortMode, this);
+    connect(walker, &QVFolderWalker::resultsReady, this, [this, walker](){
+        mergeFolderWalkResults(walker);
+    });
+    folderWalker = walker;
+    walker->start(subdirPaths);
+}
+
+void QVImageCore::stopFolderWalk()
+{
+    recursiveRootPrefix.clear();
+    loadFirstWalkedFile = false;
+
+    if (!folderWalker)
+        return;
+
+    // Results still queued for the old walker are ignored once it's no longer current
+    folderWalker->cancel();
+    folderWalker->deleteLater();
+    folderWalker = nullptr;
+}
+
+void QVImageCore::mergeFolderWalkResults(QVFolderWalker *walker)
+{
+    if (walker != folderWalker)
+        return;
+
+    const QList<QVFolderIndex> results = walker->takeResults();
+    if (results.isEmpty())
+        return;
+
+    // Everything that came in since the last time goes in with one merge
+    QVFolderIndex folderIndex = currentFileDetails.folderIndex;
+    folderIndex.merge(results, sortMode, sortDescending, randomSortSeed);
+    currentFileDetails.folderIndex = folderIndex;
+
+    if (loadFirstWalkedFile && !folderIndex.isEmpty() && !waitingOnLoad)
     {
-        std::shuffle(currentFileDetails.folderFileInfoList.begin(), currentFileDetails.folderFileInfoList.end(), std::default_random_engine(randomSortSeed));
+        loadFirstWalkedFile = false;
+        loadFile(folderIndex.absoluteFilePath(0));
+        return;
     }
 
-    // Set current file index variable
-    currentFileDetails.loadedIndexInFolder = currentFileDetails.folderFileInfoList.indexOf(currentFileDetails.fileInfo);
+    if (currentFileDetails.fileInfo.isFile())
+        currentFileDetails.loadedIndexInFolder = folderIndex.indexOf(currentFileDetails.fileInfo.absoluteFilePath());
+
+    emit folderInfoChanged();
 }
 
-void QVImageCore::requestCaching()
+void QVImageCore::requestCaching(const QVFolderIndex &folderIndex, int loadedIndexInFolder)
 {
     if (preloadingMode == 0)
     {
-        QPixmapCache::clear();
+        QMutexLocker locker(&imageCacheMutex);
+        imageCache.clear();
         return;
     }
 
@@ -351,32 +680,34 @@ void QVImageCore::requestCaching()
         preloadingDistance = 4;
 
     QStringList filesToPreload;
-    for (int i = currentFileDetails.loadedIndexInFolder-preloadingDistance; i <= currentFileDetails.loadedIndexInFolder+preloadingDistance; i++)
+    for (int i = loadedIndexInFolder-preloadingDistance; i <= loadedIndexInFolder+preloadingDistance; i++)
     {
         int index = i;
 
         // Don't try to cache the currently loaded image
-        if (index == currentFileDetails.loadedIndexInFolder)
+        if (index == loadedIndexInFolder)
             continue;
 
         //keep within index range
         if (isLoopFoldersEnabled)
         {
-            if (index > currentFileDetails.folderFileInfoList.length()-1)
-                index = index-(currentFileDetails.folderFileInfoList.length());
+            if (index > folderIndex.count()-1)
+                index = index-(folderIndex.count());
             else if (index < 0)
-                index = index+(currentFileDetails.folderFileInfoList.length());
+                index = index+(folderIndex.count());
         }
 
         //if still out of range after looping, just cancel the cache for this index
-        if (index > currentFileDetails.folderFileInfoList.length()-1 || index < 0 || currentFileDetails.folderFileInfoList.isEmpty())
+        if (index > folderIndex.count()-1 || index < 0 || folderIndex.isEmpty())
             continue;
 
-        QString filePath = currentFileDetails.folderFileInfoList[index].absoluteFilePath();
+        QString filePath = folderIndex.absoluteFilePath(index);
         filesToPreload.append(filePath);
 
         requestCachingFile(filePath);
     }
+
+    QMutexLocker locker(&imageCacheMutex);
     lastFilesPreloaded = filesToPreload;
 
 }
@@ -384,11 +715,33 @@ void QVImageCore::requestCaching()
 void QVImageCore::requestCachingFile(const QString &filePath)
 {
     //check if image is already loaded or requested
-    if (QPixmapCache::find(filePath, nullptr) || lastFilesPreloaded.contains(filePath))
-        return;
+    int cacheLimit;
+    {
+        QMutexLocker locker(&imageCacheMutex);
+        if (imageCache.contains(filePath) || lastFilesPreloaded.contains(filePath))
+            return;
+        cacheLimit = imageCache.maxCost();
+    }
+
+    // The limit is in KiB, and for an archive entry it's what it takes once it's out of the archive
+    qint64 fileSize = 0;
+    QString archivePath;
+    QString entryName;
+    if (QVArchive::splitPath(filePath, archivePath, entryName))
+    {
+        const auto archive = QVArchive::open(archivePath);
+        const int entryIndex = archive ? archive->indexOf(entryName) : -1;
+        if (entryIndex == -1)
+            return;
+
+        fileSize = archive->getEntries().at(entryIndex).uncompressedSize;
+    }
+    else
+    {
+        fileSize = QFile(filePath).size();
+    }
 
-    QFile imgFile(filePath);
-    if (imgFile.size() > QPixmapCache::cacheLimit()/2)
+    if (fileSize / 1024 > cacheLimit/2)
         return;
 
     auto *cacheFutureWatcher = new QFutureWatcher<ReadData>();
@@ -405,22 +758,42 @@ void QVImageCore::requestCachingFile(const QString &filePath)
 
 void QVImageCore::addToCache(const ReadData &readData)
 {
-    if (readData.pixmap.isNull())
+    if (readData.image.isNull())
         return;
 
-    QPixmapCache::insert(readData.fileInfo.absoluteFilePath(), readData.pixmap);
+    {
+        QMutexLocker locker(&imageCacheMutex);
+        // readFile copies archive entries out of their mapping, so these are bytes the cache really holds
+        const int animationCost = static_cast<int>(readData.animation.byteCount() / 1024);
+        imageCache.insert(readData.fileInfo.absoluteFilePath(), new ReadData(readData), getImageCost(readData.image) + animationCost);
+    }
 
-    auto *size = new qint64(readData.fileInfo.size());
+    auto *size = new qint64(readData.sourceSize);
     qvApp->setPreviouslyRecordedFileSize(readData.fileInfo.absoluteFilePath(), size);
     qvApp->setPreviouslyRecordedImageSize(readData.fileInfo.absoluteFilePath(), new QSize(readData.size));
 }
 
+void QVImageCore::removeFromCache(const QString &filePath)
+{
+    QMutexLocker locker(&imageCacheMutex);
+    imageCache.remove(filePath);
+
+    // Lets the next round of preloading read it again
+    lastFilesPreloaded.removeAll(filePath);
+}
+
 void QVImageCore::jumpToNextFrame()
 {
     if (currentFileDetails.isMovieLoaded)
         loadedMovie.jumpToNextFrame();
 }
 
+void QVImageCore::jumpToFrame(int frameNumber)
+{
+    if (currentFileDetails.isMovieLoaded)
+        loadedMovie.jumpToFrame(frameNumber);
+}
+
 void QVImageCore::setPaused(bool desiredState)
 {
     if (currentFileDetails.isMovieLoaded)
@@ -441,31 +814,17 @@ void QVImageCore::setSpeed(int desiredSpeed)
 
 void QVImageCore::rotateImage(int rotation)
 {
-        currentRotation += rotation;
-
-        // normalize between 360 and 0
-        currentRotation = (currentRotation % 360 + 360) % 360;
-        QTransform transform;
-
-        QImage transformedImage;
-        if (currentFileDetails.isMovieLoaded)
-        {
-            transform.rotate(currentRotation);
-            transformedImage = loadedMovie.currentImage().transformed(transform);
-        }
-        else
-        {
-            transform.rotate(rotation);
-            transformedImage = loadedPixmap.toImage().transformed(transform);
-        }
+    currentRotation += rotation;
 
-        loadedPixmap.convertFromImage(transformedImage);
+    // normalize between 360 and 0
+    currentRotation = (currentRotation % 360 + 360) % 360;
 
-        currentFileDetails.loadedPixmapSize = QSize(loadedPixmap.width(), loadedPixmap.height());
-        emit updateLoadedPixmapItem();
+    // The view turns the picture, so the pixels, their mipmaps and scaled copies all stay as they are
+    currentFileDetails.loadedPixmapSize = matchCurrentRotation(loadedPixmap.size());
+    emit updateLoadedPixmapItem();
 }
 
-QImage QVImageCore::matchCurrentRotation(const QImage &imageToRotate)
+QImage QVImageCore::matchCurrentRotation(const QImage &imageToRotate) const
 {
     if (!currentRotation)
         return imageToRotate;
@@ -475,7 +834,7 @@ QImage QVImageCore::matchCurrentRotation(const QImage &imageToRotate)
     return imageToRotate.transformed(transform);
 }
 
-QPixmap QVImageCore::matchCurrentRotation(const QPixmap &pixmapToRotate)
+QPixmap QVImageCore::matchCurrentRotation(const QPixmap &pixmapToRotate) const
 {
     if (!currentRotation)
         return pixmapToRotate;
@@ -483,39 +842,333 @@ QPixmap QVImageCore::matchCurrentRotation(const QPixmap &pixmapToRotate)
     return QPixmap::fromImage(matchCurrentRotation(pixmapToRotate.toImage()));
 }
 
-QPixmap QVImageCore::scaleExpensively(const int desiredWidth, const int desiredHeight)
+QSizeF QVImageCore::matchCurrentRotation(const QSizeF &sizeToRotate) const
 {
-    return scaleExpensively(QSizeF(desiredWidth, desiredHeight));
+    // A quarter turn either way swaps the sides, which also turns a rotated size back
+    return currentRotation % 180 ? sizeToRotate.transposed() : sizeToRotate;
 }
 
-QPixmap QVImageCore::scaleExpensively(const QSizeF desiredSize)
+QSize QVImageCore::matchCurrentRotation(const QSize &sizeToRotate) const
 {
+    return currentRotation % 180 ? sizeToRotate.transposed() : sizeToRotate;
+}
+
+void QVImageCore::requestScaling(const QSizeF desiredSize, const QRect &sourceRect)
+{
+    // Whatever is still running was asked for at another zoom level
+    cancelScaling();
+
     if (!currentFileDetails.isPixmapLoaded)
-        return QPixmap();
+        return;
+
+    // Animation frames change faster than a worker could keep up, and the frame would be stale by the time it's done
+    if (currentFileDetails.isMovieLoaded)
+    {
+        QRect changedRect;
+        const QPixmap scaledPixmap = scaleAnimatedFrame(desiredSize, changedRect);
+        emit animatedFrameScaled(scaledPixmap, changedRect);
+        return;
+    }
 
+    // The view asks in screen orientation, the pixels and sourceRect are unrotated
+    const QSizeF unrotatedSize = matchCurrentRotation(desiredSize);
     QSize size = QSize(loadedPixmap.width(), loadedPixmap.height());
-    size.scale(desiredSize.toSize(), Qt::KeepAspectRatio);
+    size.scale(unrotatedSize.toSize(), Qt::KeepAspectRatio);
 
-    // Get the current frame of the animation if this is an animation
-    QPixmap relevantPixmap;
-    if (!currentFileDetails.isMovieLoaded)
+    if (abs(unrotatedSize.width() - loadedPixmap.width()) < 1 &&
+        abs(unrotatedSize.height() - loadedPixmap.height()) < 1)
     {
-        relevantPixmap = loadedPixmap;
+        emit scalingFinished(loadedPixmap, QRect());
+        return;
+    }
+
+    QImage source = getScalingSource(loadedImage, size);
+    QRect scaledRect;
+    QRect sourceCropRect;
+    QSize scaledSize = size;
+
+    if (!sourceRect.isNull() && !sourceRect.contains(loadedPixmap.rect()))
+    {
+        // A mip level covers an exact power of two of original pixels, so snap the rect outwards to that grid
+        // and the crop from the level lines up with the same area of the original
+        const int step = qMax(1, loadedPixmap.width() / qMax(1, source.width()));
+        const QRect clippedRect = sourceRect & loadedPixmap.rect();
+        const int left = clippedRect.left() / step;
+        const int top = clippedRect.top() / step;
+        const int right = qMin(source.width(), (clippedRect.right() + step) / step);
+        const int bottom = qMin(source.height(), (clippedRect.bottom() + step) / step);
+
+        sourceCropRect = QRect(left, top, right - left, bottom - top);
+        scaledRect = QRect(left * step, top * step, sourceCropRect.width() * step, sourceCropRect.height() * step);
+
+        const qreal xScale = static_cast<qreal>(size.width()) / loadedPixmap.width();
+        const qreal yScale = static_cast<qreal>(size.height()) / loadedPixmap.height();
+        scaledSize = QSize(qMax(1, qRound(scaledRect.width() * xScale)), qMax(1, qRound(scaledRect.height() * yScale)));
+    }
+
+    const quint64 generation = scaleGeneration;
+    auto *scaleFutureWatcher = new QFutureWatcher<QImage>();
+    connect(scaleFutureWatcher, &QFutureWatcher<QImage>::finished, this, [scaleFutureWatcher, generation, scaledRect, this](){
+        if (generation == scaleGeneration)
+            emit scalingFinished(QPixmap::fromImage(scaleFutureWatcher->result()), scaledRect);
+        scaleFutureWatcher->deleteLater();
+    });
+    scaleFutureWatcher->setFuture(QtConcurrent::run(&QVImageCore::scaleImage, source, scaledSize, sourceCropRect));
+}
+
+QPixmap QVImageCore::scaleAnimatedFrame(const QSizeF desiredSize, QRect &changedRect)
+{
+    const QSizeF unrotatedSize = matchCurrentRotation(desiredSize);
+    QSize size = loadedPixmap.size();
+    size.scale(unrotatedSize.toSize(), Qt::KeepAspectRatio);
+
+    const QImage &frame = loadedMovie.currentImage();
+
+    // Close enough to 1:1 that the frame can go up as it is
+    if (abs(unrotatedSize.width() - loadedPixmap.width()) < 1 &&
+        abs(unrotatedSize.height() - loadedPixmap.height()) < 1)
+    {
+        changedRect = shownFrameChangedRect;
+        return loadedMovie.currentPixmap();
+    }
+
+    changedRect = getScaledRect(shownFrameChangedRect, frame.size(), size);
+
+    // After the first loop at this zoom level every frame is already here
+    if (scaledFrameCacheSize != size)
+    {
+        scaledFrameCache.clear();
+        scaledFrameCacheBytes = 0;
+        scaledFrameCacheSize = size;
+    }
+
+    const int frameNumber = loadedMovie.currentFrameNumber();
+    if (frameNumber >= 0 && frameNumber < scaledFrameCache.size() && !scaledFrameCache.at(frameNumber).isNull())
+        return scaledFrameCache.at(frameNumber);
+
+    QPixmap scaledPixmap;
+
+    if (size.width() > frame.width() || size.height() > frame.height())
+    {
+        // Qt does the enlarging, and it can't redo just part of an image
+        scaledPixmap = QPixmap::fromImage(scaleImage(frame, size, QRect()));
     }
     else
     {
-        relevantPixmap = loadedMovie.currentPixmap();
-        relevantPixmap = matchCurrentRotation(relevantPixmap);
+        // Most frames only change a small part of the picture, and only the output pixels reading from that need redoing.
+        // previousFrame and scaledFrame are always replaced together, so the diff is against what scaledFrame shows.
+        // That's usually the frame shown before, which was already compared with this one
+        const bool isShownPair = previousFrame.cacheKey() == shownFrameChangedFromKey && frame.cacheKey() == shownFrame.cacheKey();
+        const QRect frameChangedRect = isShownPair ? shownFrameChangedRect : getChangedRect(previousFrame, frame);
+        previousFrame = frame;
+        if (scaledFrame.size() != size || !QVImageScaler::rescaleRect(frame, scaledFrame, frameChangedRect))
+            scaledFrame = QVImageScaler::scale(frame, size);
+
+        scaledPixmap = QPixmap::fromImage(scaledFrame);
     }
 
-    // If we are really close to the original size, just return the original
-    if (abs(desiredSize.width() - relevantPixmap.width()) < 1 &&
-        abs(desiredSize.height() - relevantPixmap.height()) < 1)
+    // Frames past the budget are scaled every time they come up, like before
+    const qint64 frameBytes = static_cast<qint64>(scaledPixmap.width()) * scaledPixmap.height() * scaledPixmap.depth() / 8;
+    if (frameNumber >= 0 && scaledFrameCacheBytes + frameBytes <= ANIMATION_CACHE_LIMIT)
     {
-        return relevantPixmap;
+        if (frameNumber >= scaledFrameCache.size())
+            scaledFrameCache.resize(frameNumber + 1);
+        scaledFrameCache[frameNumber] = scaledPixmap;
+        scaledFrameCacheBytes += frameBytes;
     }
 
-    return relevantPixmap.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);;
+    return scaledPixmap;
+}
+
+void QVImageCore::movieUpdated()
+{
+    // The player hands over the whole frame every time, so find what actually changed for the view to repaint
+    const QImage &frame = loadedMovie.currentImage();
+    shownFrameChangedRect = getChangedRect(shownFrame, frame);
+    shownFrameChangedFromKey = shownFrame.cacheKey();
+    shownFrame = frame;
+
+    emit animatedFrameChanged(shownFrameChangedRect);
+}
+
+void QVImageCore::clearScaledFrames()
+{
+    previousFrame = QImage();
+    scaledFrame = QImage();
+    scaledFrameCache.clear();
+    scaledFrameCacheBytes = 0;
+    scaledFrameCacheSize = QSize();
+}
+
+QRect QVImageCore::getChangedRect(const QImage &before, const QImage &after)
+{
+    if (before.size() != after.size() || before.format() != after.format() || after.depth() < 8)
+        return after.rect();
+
+    // The player reports the whole frame as updated every time, so find what actually differs
+    const int bytesPerPixel = after.depth() / 8;
+    const int rowBytes = after.width() * bytesPerPixel;
+    int top = -1;
+    int bottom = -1;
+    int left = after.width();
+    int right = -1;
+    for (int y = 0; y < after.height(); y++)
+    {
+        const uchar *beforeLine = before.constScanLine(y);
+        const uchar *afterLine = after.constScanLine(y);
+        if (memcmp(beforeLine, afterLine, rowBytes) == 0)
+            continue;
+
+        if (top < 0)
+            top = y;
+        bottom = y;
+
+        // Only columns outside what's already known to have changed are worth checking
+        int x = 0;
+        while (x < left && memcmp(beforeLine + x * bytesPerPixel, afterLine + x * bytesPerPixel, bytesPerPixel) == 0)
+            x++;
+        left = qMin(left, x);
+
+        x = after.width() - 1;
+        while (x > right && memcmp(beforeLine + x * bytesPerPixel, afterLine + x * bytesPerPixel, bytesPerPixel) == 0)
+            x--;
+        right = qMax(right, x);
+    }
+
+    if (top < 0)
+        return QRect();
+
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+void QVImageCore::cancelScaling()
+{
+    scaleGeneration++;
+}
+
+QImage QVImageCore::getScalingSource(const QImage &relevantImage, const QSize &size) const
+{
+    // Start from the smallest mip level that is still at least as big as the target,
+    // so the smooth scale only ever has to cover less than a halving
+    if (!currentFileDetails.isMovieLoaded)
+    {
+        for (int i = mipmapLevels.size() - 1; i >= 0; i--)
+        {
+            const QImage &level = mipmapLevels.at(i);
+            if (level.width() >= size.width() && level.height() >= size.height())
+                return level;
+        }
+    }
+
+    return relevantImage;
+}
+
+QImage QVImageCore::scaleImage(const QImage &source, const QSize &size, const QRect &sourceRect)
+{
+    // Cropping here keeps the copy off the GUI thread
+    const QImage cropped = sourceRect.isNull() ? source : source.copy(sourceRect);
+
+    // The resampler only reduces, enlarging is left to Qt
+    if (size.width() <= cropped.width() && size.height() <= cropped.height())
+        return QVImageScaler::scale(cropped, size);
+
+    return cropped.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+void QVImageCore::requestMipmaps()
+{
+    // Scaled copies of the old pixels are no use either
+    cancelScaling();
+    clearScaledFrames();
+
+    // Anything still being built belongs to an older image
+    mipmapGeneration++;
+    mipmapLevels.clear();
+
+    // Small images scale fast enough directly, and animations change every frame
+    if (!currentFileDetails.isPixmapLoaded || currentFileDetails.isMovieLoaded ||
+        qMax(loadedPixmap.width(), loadedPixmap.height()) < MIPMAP_MIN_IMAGE_SIZE)
+        return;
+
+    const quint64 generation = mipmapGeneration;
+    auto *mipmapFutureWatcher = new QFutureWatcher<QVector<QImage>>();
+    connect(mipmapFutureWatcher, &QFutureWatcher<QVector<QImage>>::finished, this, [mipmapFutureWatcher, generation, this](){
+        if (generation == mipmapGeneration)
+            mipmapLevels = mipmapFutureWatcher->result();
+        mipmapFutureWatcher->deleteLater();
+    });
+    mipmapFutureWatcher->setFuture(QtConcurrent::run(&QVImageCore::buildMipmaps, loadedImage));
+}
+
+QVector<QImage> QVImageCore::buildMipmaps(const QImage &image)
+{
+    // Every level is a 2x2 box average of the one above, which is exact for halvings
+    // and cheap enough to build the whole chain in less time than one smooth scale of the original
+    QVector<QImage> levels;
+
+    // Gray images keep a quarter of the memory as 8-bit levels, the scaler takes those as they are
+    if (image.depth() <= 8 && !image.hasAlphaChannel() && image.isGrayscale())
+    {
+        QImage previous = image.convertToFormat(QImage::Format_Grayscale8);
+        while (qMax(previous.width(), previous.height()) / 2 >= MIPMAP_MIN_LEVEL_SIZE)
+        {
+            const int width = qMax(1, previous.width() / 2);
+            const int height = qMax(1, previous.height() / 2);
+            QImage level(width, height, QImage::Format_Grayscale8);
+            level.setDevicePixelRatio(previous.devicePixelRatio());
+
+            for (int y = 0; y < height; y++)
+            {
+                const uchar *row0 = previous.constScanLine(y * 2);
+                const uchar *row1 = previous.constScanLine(qMin(y * 2 + 1, previous.height() - 1));
+                uchar *out = level.scanLine(y);
+                for (int x = 0; x < width; x++)
+                {
+                    const int x0 = x * 2;
+                    const int x1 = qMin(x0 + 1, previous.width() - 1);
+                    out[x] = static_cast<uchar>((row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) >> 2);
+                }
+            }
+
+            levels.append(level);
+            previous = level;
+        }
+
+        return levels;
+    }
+
+    QImage previous = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+
+    while (qMax(previous.width(), previous.height()) / 2 >= MIPMAP_MIN_LEVEL_SIZE)
+    {
+        const int width = qMax(1, previous.width() / 2);
+        const int height = qMax(1, previous.height() / 2);
+        QImage level(width, height, previous.format());
+        level.setDevicePixelRatio(previous.devicePixelRatio());
+
+        for (int y = 0; y < height; y++)
+        {
+            const auto *row0 = reinterpret_cast<const quint32 *>(previous.constScanLine(y * 2));
+            const auto *row1 = reinterpret_cast<const quint32 *>(previous.constScanLine(qMin(y * 2 + 1, previous.height() - 1)));
+            auto *out = reinterpret_cast<quint32 *>(level.scanLine(y));
+            for (int x = 0; x < width; x++)
+            {
+                const int x0 = x * 2;
+                const int x1 = qMin(x0 + 1, previous.width() - 1);
+
+                // Average two channels at a time, 0x00ff00ff masks leave room for the carries
+                const quint32 p00 = row0[x0], p01 = row0[x1], p10 = row1[x0], p11 = row1[x1];
+                const quint32 redBlue = ((p00 & 0x00ff00ff) + (p01 & 0x00ff00ff) + (p10 & 0x00ff00ff) + (p11 & 0x00ff00ff) + 0x00020002) >> 2;
+                const quint32 alphaGreen = (((p00 >> 8) & 0x00ff00ff) + ((p01 >> 8) & 0x00ff00ff) + ((p10 >> 8) & 0x00ff00ff) + ((p11 >> 8) & 0x00ff00ff) + 0x00020002) >> 2;
+                out[x] = (redBlue & 0x00ff00ff) | ((alphaGreen & 0x00ff00ff) << 8);
+            }
+        }
+
+        levels.append(level);
+        previous = level;
+    }
+
+    return levels;
 }
 
 
@@ -526,17 +1179,26 @@ void QVImageCore::settingsUpdated()
     //loop folders
     isLoopFoldersEnabled = settingsManager.getBoolean("loopfoldersenabled");
 
+    const bool wasRecursiveFoldersEnabled = isRecursiveFoldersEnabled;
+    const int previousSortMode = sortMode;
+    const bool previousSortDescending = sortDescending;
+
+    //recursive folders
+    isRecursiveFoldersEnabled = settingsManager.getBoolean("recursivefoldersenabled");
+
     //preloading mode
     preloadingMode = settingsManager.getInteger("preloadingmode");
     switch (preloadingMode) {
     case 1:
     {
-        QPixmapCache::setCacheLimit(51200);
+        QMutexLocker locker(&imageCacheMutex);
+        imageCache.setMaxCost(IMAGE_CACHE_LIMIT_NORMAL);
         break;
     }
     case 2:
     {
-        QPixmapCache::setCacheLimit(204800);
+        QMutexLocker locker(&imageCacheMutex);
+        imageCache.setMaxCost(IMAGE_CACHE_LIMIT_EXTENDED);
         break;
     }
     }
@@ -547,6 +1209,20 @@ void QVImageCore::settingsUpdated()
     //sort ascending
     sortDescending = settingsManager.getBoolean("sortdescending");
 
+    //color management
+    const bool wasColorManagementEnabled = isColorManagementEnabled;
+    isColorManagementEnabled = settingsManager.getBoolean("colormanagementenabled");
+    // Cached images were converted (or not) under the old setting
+    if (isColorManagementEnabled != wasColorManagementEnabled)
+    {
+        QMutexLocker locker(&imageCacheMutex);
+        imageCache.clear();
+    }
+
+    // A walk already running was sorted for the old settings, so start over
+    if (isRecursiveFoldersEnabled && (!wasRecursiveFoldersEnabled || sortMode != previousSortMode || sortDescending != previousSortDescending))
+        recursiveRootPrefix.clear();
+
     //update folder info to re-sort
     updateFolderInfo();
 }
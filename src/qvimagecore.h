@@ -1,24 +1,31 @@
 ﻿#ifndef QVIMAGECORE_H
 #define QVIMAGECORE_H
 
+#include "qvfolderindex.h"
+#include "qvfolderwalker.h"
+#include "qvarchive.h"
+#include "qvanimationplayer.h"
+
 #include <QObject>
 #include <QImageReader>
 #include <QPixmap>
-#include <QMovie>
 #include <QFileInfo>
+#include <QBuffer>
 #include <QFutureWatcher>
 #include <QTimer>
 #include <QCache>
+#include <QMutex>
 
 class QVImageCore : public QObject
 {
     Q_OBJECT
 
 public:
+    // loadedPixmapSize is the size as shown, with the current rotation applied
     struct FileDetails
     {
         QFileInfo fileInfo;
-        QFileInfoList folderFileInfoList;
+        QVFolderIndex folderIndex;
         int loadedIndexInFolder = -1;
         bool isLoadRequested = false;
         bool isPixmapLoaded = false;
@@ -27,11 +34,17 @@ public:
         QSize loadedPixmapSize;
     };
 
+    // Images stay in the format they were decoded to, so grayscale, indexed and 1-bit ones
+    // only become 32-bit when they are put on screen.
+    // The source is the file as it was on disk when it was read, the archive for files inside one
     struct ReadData
     {
-        QPixmap pixmap;
+        QImage image;
         QFileInfo fileInfo;
         QSize size;
+        QVAnimationPlayer::Preload animation;
+        qint64 sourceSize;
+        qint64 sourceLastModified;
     };
 
     explicit QVImageCore(QObject *parent = nullptr);
@@ -40,58 +53,130 @@ public:
     ReadData readFile(const QString &fileName, bool forCache);
     void loadPixmap(const ReadData &readData, bool fromCache);
     void closeImage();
-    QFileInfoList getCompatibleFiles();
+    static QVFolderIndex getCompatibleFiles(const QString &dirPath, int sortMode, QStringList *subdirPaths = nullptr);
     void updateFolderInfo();
-    void requestCaching();
+    void updateArchiveInfo(const QString &archivePath);
+    void loadArchive(const QString &archivePath);
+    void loadFolder(const QString &dirPath);
+    void startFolderWalk(const QString &rootPath, const QStringList &subdirPaths);
+    void stopFolderWalk();
+    void mergeFolderWalkResults(QVFolderWalker *walker);
+    void requestCaching(const QVFolderIndex &folderIndex, int loadedIndexInFolder);
     void requestCachingFile(const QString &filePath);
     void addToCache(const ReadData &readImageAndFileInfo);
+    void removeFromCache(const QString &filePath);
 
     void settingsUpdated();
 
     void jumpToNextFrame();
+    void jumpToFrame(int frameNumber);
     void setPaused(bool desiredState);
     void setSpeed(int desiredSpeed);
 
+    // Only changes how the view turns the image, the pixels are rotated on demand by matchCurrentRotation
     void rotateImage(int rotation);
-    QImage matchCurrentRotation(const QImage &imageToRotate);
-    QPixmap matchCurrentRotation(const QPixmap &pixmapToRotate);
-
-    QPixmap scaleExpensively(const int desiredWidth, const int desiredHeight);
-    QPixmap scaleExpensively(const QSizeF desiredSize);
+    QImage matchCurrentRotation(const QImage &imageToRotate) const;
+    QPixmap matchCurrentRotation(const QPixmap &pixmapToRotate) const;
+    QSizeF matchCurrentRotation(const QSizeF &sizeToRotate) const;
+    QSize matchCurrentRotation(const QSize &sizeToRotate) const;
+
+    // Scales on a worker and emits scalingFinished, unless another request or cancelScaling comes first.
+    // desiredSize is as shown on screen, the result comes back unrotated like the item it goes on.
+    // With a sourceRect only that part of the image is scaled, the rect it was snapped to comes back with the result
+    void requestScaling(const QSizeF desiredSize, const QRect &sourceRect = QRect());
+    void cancelScaling();
+    // changedRect comes back as the part of the result that differs from the frame shown before
+    QPixmap scaleAnimatedFrame(const QSizeF desiredSize, QRect &changedRect);
+    void clearScaledFrames();
+    static QRect getChangedRect(const QImage &before, const QImage &after);
+    QImage getScalingSource(const QImage &relevantImage, const QSize &size) const;
+    static QImage scaleImage(const QImage &source, const QSize &size, const QRect &sourceRect);
+
+    void requestMipmaps();
+    static QVector<QImage> buildMipmaps(const QImage &image);
 
     //returned const reference is read-only
     const QPixmap& getLoadedPixmap() const {return loadedPixmap; }
-    const QMovie& getLoadedMovie() const {return loadedMovie; }
+    const QImage& getLoadedImage() const {return loadedImage; }
+    const QVAnimationPlayer& getLoadedMovie() const {return loadedMovie; }
     const FileDetails& getCurrentFileDetails() const {return currentFileDetails; }
     int getCurrentRotation() const {return currentRotation; }
 
 signals:
+    // rect is the part of the frame that differs from the one shown before
     void animatedFrameChanged(QRect rect);
 
+    // A scaled animation frame, changedRect is in the scaled pixmap's pixels
+    void animatedFrameScaled(const QPixmap &scaledPixmap, const QRect &changedRect);
+
     void updateLoadedPixmapItem();
 
+    void scalingFinished(const QPixmap &scaledPixmap, const QRect &sourceRect);
+
     void fileChanged();
 
+    void folderInfoChanged();
+
     void readError(int errorNum, const QString &errorString, const QString &fileName);
 
 private:
+    void movieUpdated();
+
+    // loadedImage is the decoded image, loadedPixmap the copy of it shown on screen
+    QImage loadedImage;
     QPixmap loadedPixmap;
-    QMovie loadedMovie;
+    QVAnimationPlayer loadedMovie;
 
     FileDetails currentFileDetails;
     int currentRotation;
 
     QFutureWatcher<ReadData> loadFutureWatcher;
 
+    // Successive halvings of loadedPixmap, mipmapLevels[0] is half size
+    QVector<QImage> mipmapLevels;
+    quint64 mipmapGeneration;
+
+    // Bumped whenever an in-flight scale stops matching what is on screen
+    quint64 scaleGeneration;
+
+    // The last animation frame that was scaled down, and the result, for redoing only what the next frame changes
+    QImage previousFrame;
+    QImage scaledFrame;
+
+    // The frame last sent to the view and what changed in it, which is only worked out again for a different pair
+    QImage shownFrame;
+    QRect shownFrameChangedRect;
+    qint64 shownFrameChangedFromKey;
+
+    // Every frame of the animation scaled to scaledFrameCacheSize, indexed by frame number, up to a memory limit
+    QVector<QPixmap> scaledFrameCache;
+    QSize scaledFrameCacheSize;
+    qint64 scaledFrameCacheBytes;
+
     bool isLoopFoldersEnabled;
+    bool isRecursiveFoldersEnabled;
     int preloadingMode;
     int sortMode;
     bool sortDescending;
+    bool isColorManagementEnabled;
 
     QPair<QString, uint> lastDirInfo;
     unsigned randomSortSeed;
 
+    // What the archive's index was last sorted by, it isn't listed again while stepping through it
+    int archiveSortMode;
+    bool archiveSortDescending;
+
+    QVFolderWalker *folderWalker;
+    QString recursiveRootPrefix;
+    bool loadFirstWalkedFile;
+
+    // Decoded neighbours of the current image, costed in KiB of their actual pixel data.
+    // Animated ones keep their file and first frames too, so they start playing without going back to disk.
+    // Preloading works from a worker, so every access to the cache and the files last requested holds the mutex
+    QCache<QString, ReadData> imageCache;
     QStringList lastFilesPreloaded;
+    QMutex imageCacheMutex;
 
     int largestDimension;
 
@@ -0,0 +1,736 @@
+#include "qvimagescaler.h"
+
+#include <QVector>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtMath>
+#include <algorithm>
+#include <cstring>
+
+#if defined(Q_PROCESSOR_X86) && (defined(Q_CC_GNU) || defined(Q_CC_MSVC))
+#define QV_SCALER_X86
+#include <immintrin.h>
+#ifdef Q_CC_MSVC
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang need the instruction set enabled per function, MSVC allows the intrinsics anywhere
+#if defined(Q_CC_GNU)
+#define QV_TARGET(isa) __attribute__((target(isa)))
+#else
+#define QV_TARGET(isa)
+#endif
+
+namespace
+{
+    // Weights are 2.14 fixed point, so a sum over a whole row of 255s still fits comfortably in 32 bits
+    const int WEIGHT_BITS = 14;
+    const int WEIGHT_ONE = 1 << WEIGHT_BITS;
+    const int WEIGHT_ROUND = 1 << (WEIGHT_BITS - 1);
+
+    // Reductions of at least this much per axis use area averaging, smaller ones Lanczos-3
+    const double AREA_FILTER_THRESHOLD = 2.0;
+
+    // Below about a megapixel of source the thread pool costs more than it saves
+    const qint64 PARALLEL_PIXEL_THRESHOLD = 1024 * 1024;
+    const int MIN_STRIPE_HEIGHT = 16;
+
+    // A few stripes per thread so one slow stripe doesn't hold up the rest
+    const int STRIPES_PER_THREAD = 3;
+
+    using Filter = QVImageScaler::Filter;
+    using InstructionSet = QVImageScaler::InstructionSet;
+    using Threading = QVImageScaler::Threading;
+
+    // For every output pixel along one axis: the first source pixel and a fixed number of weights from it
+    struct Coefficients
+    {
+        int taps = 0;
+        QVector<int> starts;
+        QVector<qint16> weights;
+    };
+
+    using HorizontalPass = void (*)(const uchar *src, uchar *dst, int dstWidth, const int *starts, const qint16 *weights, int taps);
+    using VerticalPass = void (*)(const uchar *const *rows, const qint16 *weights, int taps, uchar *dst, int byteCount);
+    using OpaqueScan = bool (*)(const quint32 *line, int width);
+
+    struct Kernels
+    {
+        HorizontalPass horizontal4;
+        HorizontalPass horizontal1;
+        VerticalPass vertical;
+        OpaqueScan isOpaque;
+    };
+
+    inline uchar clampToByte(int value)
+    {
+        return static_cast<uchar>(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+
+    // Scalar kernels, the reference every other version has to match bit for bit
+
+    void horizontalPass4Scalar(const uchar *src, uchar *dst, int dstWidth, const int *starts, const qint16 *weights, int taps)
+    {
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const uchar *pixel = src + starts[x] * 4;
+            const qint16 *weight = weights + x * taps;
+            int acc0 = WEIGHT_ROUND, acc1 = WEIGHT_ROUND, acc2 = WEIGHT_ROUND, acc3 = WEIGHT_ROUND;
+            for (int k = 0; k < taps; k++)
+            {
+                acc0 += weight[k] * pixel[k * 4];
+                acc1 += weight[k] * pixel[k * 4 + 1];
+                acc2 += weight[k] * pixel[k * 4 + 2];
+                acc3 += weight[k] * pixel[k * 4 + 3];
+            }
+            dst[x * 4] = clampToByte(acc0 >> WEIGHT_BITS);
+            dst[x * 4 + 1] = clampToByte(acc1 >> WEIGHT_BITS);
+            dst[x * 4 + 2] = clampToByte(acc2 >> WEIGHT_BITS);
+            dst[x * 4 + 3] = clampToByte(acc3 >> WEIGHT_BITS);
+        }
+    }
+
+    void horizontalPass1Scalar(const uchar *src, uchar *dst, int dstWidth, const int *starts, const qint16 *weights, int taps)
+    {
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const uchar *pixel = src + starts[x];
+            const qint16 *weight = weights + x * taps;
+            int acc = WEIGHT_ROUND;
+            for (int k = 0; k < taps; k++)
+                acc += weight[k] * pixel[k];
+            dst[x] = clampToByte(acc >> WEIGHT_BITS);
+        }
+    }
+
+    void verticalPassScalar(const uchar *const *rows, const qint16 *weights, int taps, uchar *dst, int byteCount)
+    {
+        for (int i = 0; i < byteCount; i++)
+        {
+            int acc = WEIGHT_ROUND;
+            for (int k = 0; k < taps; k++)
+                acc += weights[k] * rows[k][i];
+            dst[i] = clampToByte(acc >> WEIGHT_BITS);
+        }
+    }
+
+    // ANDing every pixel together leaves the alpha byte at 255 only if all of them are opaque
+    bool isOpaqueScalar(const quint32 *line, int width)
+    {
+        quint32 acc = 0xffffffff;
+        for (int x = 0; x < width; x++)
+            acc &= line[x];
+        return (acc & 0xff000000) == 0xff000000;
+    }
+
+#ifdef QV_SCALER_X86
+    // Two weights side by side, for _mm_madd_epi16 against interleaved 16-bit samples
+    inline int weightPair(qint16 weight0, qint16 weight1)
+    {
+        return static_cast<int>(static_cast<quint32>(static_cast<quint16>(weight0)) |
+                                (static_cast<quint32>(static_cast<quint16>(weight1)) << 16));
+    }
+
+    QV_TARGET("sse4.1")
+    inline void storePixelSSE41(__m128i acc, uchar *dst)
+    {
+        acc = _mm_srai_epi32(acc, WEIGHT_BITS);
+        acc = _mm_packs_epi32(acc, acc);
+        acc = _mm_packus_epi16(acc, acc);
+        const int pixel = _mm_cvtsi128_si32(acc);
+        std::memcpy(dst, &pixel, 4);
+    }
+
+    QV_TARGET("sse4.1")
+    inline int horizontalSumSSE41(__m128i acc)
+    {
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+        acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(acc);
+    }
+
+    QV_TARGET("sse4.1")
+    void horizontalPass4SSE41(const uchar *src, uchar *dst, int dstWidth, const int *starts, const qint16 *weights, int taps)
+    {
+        // Interleaves two pixels channel by channel so one madd applies a pair of taps to all four channels
+        const __m128i interleave = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const uchar *pixel = src + starts[x] * 4;
+            const qint16 *weight = weights + x * taps;
+            __m128i acc = _mm_set1_epi32(WEIGHT_ROUND);
+
+            int k = 0;
+            for (; k + 1 < taps; k += 2)
+            {
+                const __m128i pixels = _mm_shuffle_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel + k * 4)), interleave);
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_cvtepu8_epi16(pixels), _mm_set1_epi32(weightPair(weight[k], weight[k + 1]))));
+            }
+            if (k < taps)
+            {
+                int lastPixel;
+                std::memcpy(&lastPixel, pixel + k * 4, 4);
+                acc = _mm_add_epi32(acc, _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(lastPixel)), _mm_set1_epi32(weight[k])));
+            }
+
+            storePixelSSE41(acc, dst + x * 4);
+        }
+    }
+
+    QV_TARGET("sse4.1")
+    void horizontalPass1SSE41(const uchar *src, uchar *dst, int dstWidth, const int *starts, const qint16 *weights, int taps)
+    {
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const uchar *pixel = src + starts[x];
+            const qint16 *weight = weights + x * taps;
+            __m128i acc = _mm_setzero_si128();
+
+            int k = 0;
+            for (; k + 8 <= taps; k += 8)
+            {
+                const __m128i samples = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel + k)));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(samples, _mm_loadu_si128(reinterpret_cast<const __m128i *>(weight + k))));
+            }
+
+            int sum = WEIGHT_ROUND + horizontalSumSSE41(acc);
+            for (; k < taps; k++)
+                sum += weight[k] * pixel[k];
+            dst[x] = clampToByte(sum >> WEIGHT_BITS);
+        }
+    }
+
+    QV_TARGET("sse4.1")
+    void verticalPassSSE41(const uchar *const *rows, const qint16 *weights, int taps, uchar *dst, int byteCount)
+    {
+        int i = 0;
+        for (; i + 8 <= byteCount; i += 8)
+        {
+            __m128i accLow = _mm_set1_epi32(WEIGHT_ROUND);
+            __m128i accHigh = _mm_set1_epi32(WEIGHT_ROUND);
+
+            // Rows go in pairs, interleaved so each madd applies two weights at once
+            for (int k = 0; k < taps; k += 2)
+            {
+                const __m128i row0 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[k] + i)));
+                const __m128i row1 = k + 1 < taps ? _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[k + 1] + i)))
+                                                  : _mm_setzero_si128();
+                const __m128i weightPairs = _mm_set1_epi32(weightPair(weights[k], k + 1 < taps ? weights[k + 1] : 0));
+                accLow = _mm_add_epi32(accLow, _mm_madd_epi16(_mm_unpacklo_epi16(row0, row1), weightPairs));
+                accHigh = _mm_add_epi32(accHigh, _mm_madd_epi16(_mm_unpackhi_epi16(row0, row1), weightPairs));
+            }
+
+            const __m128i packed = _mm_packs_epi32(_mm_srai_epi32(accLow, WEIGHT_BITS), _mm_srai_epi32(accHigh, WEIGHT_BITS));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(packed, packed));
+        }
+
+        for (; i < byteCount; i++)
+        {
+            int acc = WEIGHT_ROUND;
+            for (int k = 0; k < taps; k++)
+                acc += weights[k] * rows[k][i];
+            dst[i] = clampToByte(acc >> WEIGHT_BITS);
+        }
+    }
+
+    QV_TARGET("avx2")
+    void horizontalPass4AVX2(const uchar *src, uchar *dst, int dstWidth, const int *starts, const qint16 *weights, int taps)
+    {
+        const __m128i interleave4 = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, 8, 12, 9, 13, 10, 14, 11, 15);
+        const __m128i interleave2 = _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const uchar *pixel = src + starts[x] * 4;
+            const qint16 *weight = weights + x * taps;
+            __m256i wideAcc = _mm256_setzero_si256();
+
+            // Four taps per step, two in each 128-bit lane
+            int k = 0;
+            for (; k + 3 < taps; k += 4)
+            {
+                const __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixel + k * 4)), interleave4);
+                const __m256i weightPairs = _mm256_setr_epi32(weightPair(weight[k], weight[k + 1]), weightPair(weight[k], weight[k + 1]),
+                                                              weightPair(weight[k], weight[k + 1]), weightPair(weight[k], weight[k + 1]),
+                                                              weightPair(weight[k + 2], weight[k + 3]), weightPair(weight[k + 2], weight[k + 3]),
+                                                              weightPair(weight[k + 2], weight[k + 3]), weightPair(weight[k + 2], weight[k + 3]));
+                wideAcc = _mm256_add_epi32(wideAcc, _mm256_madd_epi16(_mm256_cvtepu8_epi16(pixels), weightPairs));
+            }
+
+            __m128i acc = _mm_add_epi32(_mm_set1_epi32(WEIGHT_ROUND),
+                                        _mm_add_epi32(_mm256_castsi256_si128(wideAcc), _mm256_extracti128_si256(wideAcc, 1)));
+            for (; k + 1 < taps; k += 2)
+            {
+                const __m128i pixels = _mm_shuffle_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel + k * 4)), interleave2);
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_cvtepu8_epi16(pixels), _mm_set1_epi32(weightPair(weight[k], weight[k + 1]))));
+            }
+            if (k < taps)
+            {
+                int lastPixel;
+                std::memcpy(&lastPixel, pixel + k * 4, 4);
+                acc = _mm_add_epi32(acc, _mm_mullo_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(lastPixel)), _mm_set1_epi32(weight[k])));
+            }
+
+            acc = _mm_srai_epi32(acc, WEIGHT_BITS);
+            acc = _mm_packs_epi32(acc, acc);
+            acc = _mm_packus_epi16(acc, acc);
+            const int result = _mm_cvtsi128_si32(acc);
+            std::memcpy(dst + x * 4, &result, 4);
+        }
+    }
+
+    QV_TARGET("avx2")
+    void horizontalPass1AVX2(const uchar *src, uchar *dst, int dstWidth, const int *starts, const qint16 *weights, int taps)
+    {
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const uchar *pixel = src + starts[x];
+            const qint16 *weight = weights + x * taps;
+            __m256i wideAcc = _mm256_setzero_si256();
+
+            int k = 0;
+            for (; k + 16 <= taps; k += 16)
+            {
+                const __m256i samples = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pixel + k)));
+                wideAcc = _mm256_add_epi32(wideAcc, _mm256_madd_epi16(samples, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weight + k))));
+            }
+
+            __m128i acc = _mm_add_epi32(_mm256_castsi256_si128(wideAcc), _mm256_extracti128_si256(wideAcc, 1));
+            for (; k + 8 <= taps; k += 8)
+            {
+                const __m128i samples = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixel + k)));
+                acc = _mm_add_epi32(acc, _mm_madd_epi16(samples, _mm_loadu_si128(reinterpret_cast<const __m128i *>(weight + k))));
+            }
+
+            acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+            acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+            int sum = WEIGHT_ROUND + _mm_cvtsi128_si32(acc);
+            for (; k < taps; k++)
+                sum += weight[k] * pixel[k];
+            dst[x] = clampToByte(sum >> WEIGHT_BITS);
+        }
+    }
+
+    QV_TARGET("avx2")
+    void verticalPassAVX2(const uchar *const *rows, const qint16 *weights, int taps, uchar *dst, int byteCount)
+    {
+        int i = 0;
+        for (; i + 16 <= byteCount; i += 16)
+        {
+            __m256i accLow = _mm256_set1_epi32(WEIGHT_ROUND);
+            __m256i accHigh = _mm256_set1_epi32(WEIGHT_ROUND);
+
+            for (int k = 0; k < taps; k += 2)
+            {
+                const __m256i row0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + i)));
+                const __m256i row1 = k + 1 < taps ? _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k + 1] + i)))
+                                                  : _mm256_setzero_si256();
+                const __m256i weightPairs = _mm256_set1_epi32(weightPair(weights[k], k + 1 < taps ? weights[k + 1] : 0));
+                accLow = _mm256_add_epi32(accLow, _mm256_madd_epi16(_mm256_unpacklo_epi16(row0, row1), weightPairs));
+                accHigh = _mm256_add_epi32(accHigh, _mm256_madd_epi16(_mm256_unpackhi_epi16(row0, row1), weightPairs));
+            }
+
+            // Unpacking and packing both work per 128-bit lane, so the bytes come back in order
+            // apart from the duplicate halves packus leaves, which the permute drops
+            const __m256i packed = _mm256_packs_epi32(_mm256_srai_epi32(accLow, WEIGHT_BITS), _mm256_srai_epi32(accHigh, WEIGHT_BITS));
+            const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(packed, packed), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(bytes));
+        }
+
+        for (; i < byteCount; i++)
+        {
+            int acc = WEIGHT_ROUND;
+            for (int k = 0; k < taps; k++)
+                acc += weights[k] * rows[k][i];
+            dst[i] = clampToByte(acc >> WEIGHT_BITS);
+        }
+    }
+
+    QV_TARGET("sse4.1")
+    bool isOpaqueSSE41(const quint32 *line, int width)
+    {
+        __m128i acc = _mm_set1_epi32(-1);
+        int x = 0;
+        for (; x + 4 <= width; x += 4)
+            acc = _mm_and_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(line + x)));
+
+        quint32 tail = 0xffffffff;
+        for (; x < width; x++)
+            tail &= line[x];
+
+        return _mm_testc_si128(acc, _mm_set1_epi32(static_cast<int>(0xff000000))) && (tail & 0xff000000) == 0xff000000;
+    }
+
+    QV_TARGET("avx2")
+    bool isOpaqueAVX2(const quint32 *line, int width)
+    {
+        __m256i acc = _mm256_set1_epi32(-1);
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+            acc = _mm256_and_si256(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(line + x)));
+
+        quint32 tail = 0xffffffff;
+        for (; x < width; x++)
+            tail &= line[x];
+
+        return _mm256_testc_si256(acc, _mm256_set1_epi32(static_cast<int>(0xff000000))) && (tail & 0xff000000) == 0xff000000;
+    }
+
+    bool cpuSupports(InstructionSet instructionSet)
+    {
+#if defined(Q_CC_GNU)
+        __builtin_cpu_init();
+        if (instructionSet == InstructionSet::AVX2)
+            return __builtin_cpu_supports("avx2");
+        return __builtin_cpu_supports("sse4.1");
+#else
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool hasSSE41 = info[2] & (1 << 19);
+        if (instructionSet == InstructionSet::SSE41)
+            return hasSSE41;
+
+        // AVX2 also needs the OS to save the upper halves of the registers
+        const bool hasOSXSAVE = info[2] & (1 << 27);
+        const bool hasAVX = info[2] & (1 << 28);
+        if (maxLeaf < 7 || !hasOSXSAVE || !hasAVX || (_xgetbv(0) & 6) != 6)
+            return false;
+
+        __cpuidex(info, 7, 0);
+        return info[1] & (1 << 5);
+#endif
+    }
+#endif
+
+    Kernels kernelsFor(InstructionSet instructionSet)
+    {
+#ifdef QV_SCALER_X86
+        if (instructionSet == InstructionSet::AVX2)
+            return {horizontalPass4AVX2, horizontalPass1AVX2, verticalPassAVX2, isOpaqueAVX2};
+        if (instructionSet == InstructionSet::SSE41)
+            return {horizontalPass4SSE41, horizontalPass1SSE41, verticalPassSSE41, isOpaqueSSE41};
+#else
+        Q_UNUSED(instructionSet)
+#endif
+        return {horizontalPass4Scalar, horizontalPass1Scalar, verticalPassScalar, isOpaqueScalar};
+    }
+
+    InstructionSet bestInstructionSet()
+    {
+        static const InstructionSet best = []{
+            if (QVImageScaler::isSupported(InstructionSet::AVX2))
+                return InstructionSet::AVX2;
+            if (QVImageScaler::isSupported(InstructionSet::SSE41))
+                return InstructionSet::SSE41;
+            return InstructionSet::Scalar;
+        }();
+        return best;
+    }
+
+    double lanczos3(double x)
+    {
+        x = std::abs(x);
+        if (x < 1e-8)
+            return 1.0;
+        if (x >= 3.0)
+            return 0.0;
+
+        const double pix = M_PI * x;
+        return 3.0 * std::sin(pix) * std::sin(pix / 3.0) / (pix * pix);
+    }
+
+    struct StripeJob
+    {
+        const uchar *sourceBits;
+        qptrdiff sourceBytesPerLine;
+        uchar *resultBits;
+        qptrdiff resultBytesPerLine;
+        int firstColumn;
+        int columnCount;
+        int rowBytes;
+        HorizontalPass horizontalPass;
+        VerticalPass verticalPass;
+        const Coefficients *horizontal;
+        const Coefficients *vertical;
+        bool isPremultiplied;
+    };
+
+    // Output rows [firstRow, lastRow), with a horizontal pass over just the source rows they read
+    void scaleStripe(const StripeJob &job, int firstRow, int lastRow)
+    {
+        if (firstRow >= lastRow)
+            return;
+
+        const Coefficients &horizontal = *job.horizontal;
+        const Coefficients &vertical = *job.vertical;
+        const int firstSourceRow = vertical.starts.at(firstRow);
+        const int lastSourceRow = vertical.starts.at(lastRow - 1) + vertical.taps;
+
+        QVector<uchar> intermediate((lastSourceRow - firstSourceRow) * job.rowBytes);
+        for (int y = firstSourceRow; y < lastSourceRow; y++)
+        {
+            job.horizontalPass(job.sourceBits + y * job.sourceBytesPerLine, intermediate.data() + (y - firstSourceRow) * job.rowBytes,
+                               job.columnCount, horizontal.starts.constData() + job.firstColumn,
+                               horizontal.weights.constData() + job.firstColumn * horizontal.taps, horizontal.taps);
+        }
+
+        QVector<const uchar *> rows(vertical.taps);
+        for (int y = firstRow; y < lastRow; y++)
+        {
+            const int start = vertical.starts.at(y) - firstSourceRow;
+            for (int k = 0; k < vertical.taps; k++)
+                rows[k] = intermediate.constData() + (start + k) * job.rowBytes;
+
+            uchar *line = job.resultBits + y * job.resultBytesPerLine;
+            job.verticalPass(rows.constData(), vertical.weights.constData() + y * vertical.taps, vertical.taps, line, job.rowBytes);
+
+            // Lanczos can ring past the alpha of a pixel, keep premultiplied colors valid
+            if (job.isPremultiplied)
+            {
+                auto *pixels = reinterpret_cast<QRgb *>(line);
+                for (int x = 0; x < job.rowBytes / 4; x++)
+                {
+                    const QRgb pixel = pixels[x];
+                    const int alpha = qAlpha(pixel);
+                    pixels[x] = qRgba(qMin(qRed(pixel), alpha), qMin(qGreen(pixel), alpha), qMin(qBlue(pixel), alpha), alpha);
+                }
+            }
+        }
+    }
+
+    // Output pixels [first, last) along one axis whose taps reach into source pixels [changedFirst, changedLast]
+    QPair<int, int> affectedRange(const Coefficients &coefficients, int changedFirst, int changedLast)
+    {
+        const int *starts = coefficients.starts.constData();
+        const int *end = starts + coefficients.starts.size();
+        const int first = static_cast<int>(std::lower_bound(starts, end, changedFirst - coefficients.taps + 1) - starts);
+        const int last = static_cast<int>(std::upper_bound(starts, end, changedLast) - starts);
+        return {first, last};
+    }
+
+    // Work in a format the kernels understand, resampling straight alpha would bleed color out of transparent areas
+    QImage normalizeFormat(const QImage &image)
+    {
+        switch (image.format()) {
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32_Premultiplied:
+        case QImage::Format_Grayscale8:
+            return image;
+        default:
+            // 1-bit and gray palette images stay a single channel
+            if (image.depth() <= 8 && !image.hasAlphaChannel() && image.isGrayscale())
+                return image.convertToFormat(QImage::Format_Grayscale8);
+            return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+        }
+    }
+
+    Coefficients computeCoefficients(int srcSize, int dstSize, Filter filter)
+    {
+        const double scale = static_cast<double>(srcSize) / dstSize;
+        if (filter == Filter::Automatic)
+            filter = scale >= AREA_FILTER_THRESHOLD ? Filter::Area : Filter::Lanczos3;
+
+        // Lanczos is stretched by the reduction so it still low-passes, area covers exactly one output pixel
+        const double filterScale = qMax(1.0, scale);
+        const double support = filter == Filter::Area ? scale / 2.0 : 3.0 * filterScale;
+
+        Coefficients coefficients;
+        coefficients.taps = qMin(srcSize, static_cast<int>(std::ceil(support * 2.0)) + 2);
+        coefficients.starts.resize(dstSize);
+        coefficients.weights.resize(dstSize * coefficients.taps);
+
+        QVector<double> weights(coefficients.taps);
+        for (int i = 0; i < dstSize; i++)
+        {
+            const double center = (i + 0.5) * scale;
+
+            // Starts never decrease along the axis, which lets a stripe of output know which input rows it needs
+            const int start = qBound(0, static_cast<int>(std::floor(center - support)), srcSize - coefficients.taps);
+            coefficients.starts[i] = start;
+
+            double sum = 0.0;
+            for (int k = 0; k < coefficients.taps; k++)
+            {
+                const double position = start + k;
+                double weight;
+                if (filter == Filter::Area)
+                    weight = qMax(0.0, qMin(position + 1.0, center + support) - qMax(position, center - support));
+                else
+                    weight = lanczos3((position + 0.5 - center) / filterScale);
+
+                weights[k] = weight;
+                sum += weight;
+            }
+
+            // Quantize, then put the rounding error on the biggest weight so every row sums to exactly one
+            qint16 *fixedWeights = coefficients.weights.data() + i * coefficients.taps;
+            int fixedSum = 0;
+            int largest = 0;
+            for (int k = 0; k < coefficients.taps; k++)
+            {
+                fixedWeights[k] = static_cast<qint16>(std::lround(weights.at(k) / sum * WEIGHT_ONE));
+                fixedSum += fixedWeights[k];
+                if (fixedWeights[k] > fixedWeights[largest])
+                    largest = k;
+            }
+            fixedWeights[largest] = static_cast<qint16>(fixedWeights[largest] + WEIGHT_ONE - fixedSum);
+        }
+
+        return coefficients;
+    }
+}
+
+QImage QVImageScaler::scale(const QImage &image, const QSize &size, Filter filter, InstructionSet instructionSet, Threading threading)
+{
+    if (image.isNull() || size.isEmpty())
+        return QImage();
+
+    const QImage source = normalizeFormat(image);
+    if (size == source.size())
+        return source;
+
+    if (instructionSet == InstructionSet::Automatic || !isSupported(instructionSet))
+        instructionSet = bestInstructionSet();
+    const Kernels kernels = kernelsFor(instructionSet);
+
+    const int channels = source.format() == QImage::Format_Grayscale8 ? 1 : 4;
+    const HorizontalPass horizontalPass = channels == 4 ? kernels.horizontal4 : kernels.horizontal1;
+
+    const Coefficients horizontal = computeCoefficients(source.width(), size.width(), filter);
+    const Coefficients vertical = computeCoefficients(source.height(), size.height(), filter);
+
+    QImage result(size, source.format());
+    if (result.isNull())
+        return QImage();
+    result.setDevicePixelRatio(source.devicePixelRatio());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    result.setColorSpace(source.colorSpace());
+#endif
+
+    // Stripes of output rows are independent, so big images are split across the thread pool.
+    // Each output pixel is computed the same way whichever stripe it lands in, so the result doesn't change
+    const qint64 sourcePixels = static_cast<qint64>(source.width()) * source.height();
+    int stripeCount = 1;
+    if (threading == Threading::Parallel || (threading == Threading::Automatic && sourcePixels >= PARALLEL_PIXEL_THRESHOLD))
+        stripeCount = qBound(1, size.height() / MIN_STRIPE_HEIGHT, QThreadPool::globalInstance()->maxThreadCount() * STRIPES_PER_THREAD);
+
+    // Resolve the pixel pointers before any threads see the images, scanLine() may detach
+    const StripeJob job = {
+        source.constBits(),
+        source.bytesPerLine(),
+        result.bits(),
+        result.bytesPerLine(),
+        0,
+        size.width(),
+        size.width() * channels,
+        horizontalPass,
+        kernels.vertical,
+        &horizontal,
+        &vertical,
+        source.format() == QImage::Format_ARGB32_Premultiplied
+    };
+
+    QVector<QPair<int, int>> stripes;
+    stripes.reserve(stripeCount);
+    for (int i = 0; i < stripeCount; i++)
+        stripes.append({size.height() * i / stripeCount, size.height() * (i + 1) / stripeCount});
+
+    if (stripes.length() == 1)
+    {
+        scaleStripe(job, 0, size.height());
+    }
+    else
+    {
+        QtConcurrent::blockingMap(stripes, [&job](const QPair<int, int> &stripe){
+            scaleStripe(job, stripe.first, stripe.second);
+        });
+    }
+
+    return result;
+}
+
+bool QVImageScaler::rescaleRect(const QImage &image, QImage &scaled, const QRect &changedRect, Filter filter)
+{
+    const QImage source = normalizeFormat(image);
+    if (source.isNull() || scaled.isNull() || scaled.format() != source.format() || scaled.size() == source.size())
+        return false;
+
+    const QRect rect = changedRect & source.rect();
+    if (rect.isEmpty())
+        return true;
+
+    const Coefficients horizontal = computeCoefficients(source.width(), scaled.width(), filter);
+    const Coefficients vertical = computeCoefficients(source.height(), scaled.height(), filter);
+    const QPair<int, int> columns = affectedRange(horizontal, rect.left(), rect.right());
+    const QPair<int, int> rows = affectedRange(vertical, rect.top(), rect.bottom());
+    if (columns.first >= columns.second || rows.first >= rows.second)
+        return true;
+
+    const Kernels kernels = kernelsFor(bestInstructionSet());
+    const int channels = source.format() == QImage::Format_Grayscale8 ? 1 : 4;
+    const int columnCount = columns.second - columns.first;
+
+    // Same coefficients and kernels as a full scale, so the pixels come out exactly as scale() would make them
+    const StripeJob job = {
+        source.constBits(),
+        source.bytesPerLine(),
+        scaled.bits() + columns.first * channels,
+        scaled.bytesPerLine(),
+        columns.first,
+        columnCount,
+        columnCount * channels,
+        channels == 4 ? kernels.horizontal4 : kernels.horizontal1,
+        kernels.vertical,
+        &horizontal,
+        &vertical,
+        source.format() == QImage::Format_ARGB32_Premultiplied
+    };
+    scaleStripe(job, rows.first, rows.second);
+
+    return true;
+}
+
+void QVImageScaler::convertToRasterFormat(QImage &image, InstructionSet instructionSet)
+{
+    if (image.format() == QImage::Format_RGBA8888)
+        image = image.convertToFormat(QImage::Format_ARGB32);
+    else if (image.format() != QImage::Format_ARGB32)
+        return;
+
+    if (instructionSet == InstructionSet::Automatic || !isSupported(instructionSet))
+        instructionSet = bestInstructionSet();
+    const OpaqueScan isOpaque = kernelsFor(instructionSet).isOpaque;
+
+    bool opaque = true;
+    for (int y = 0; y < image.height() && opaque; y++)
+        opaque = isOpaque(reinterpret_cast<const quint32 *>(image.constScanLine(y)), image.width());
+
+    // Same bytes either way when nothing is see-through, so there's nothing to convert
+    if (opaque)
+        image.reinterpretAsFormat(QImage::Format_RGB32);
+    else
+        image = std::move(image).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+bool QVImageScaler::isSupported(InstructionSet instructionSet)
+{
+    switch (instructionSet) {
+    case InstructionSet::Automatic:
+    case InstructionSet::Scalar:
+        return true;
+#ifdef QV_SCALER_X86
+    case InstructionSet::SSE41:
+    case InstructionSet::AVX2:
+        return cpuSupports(instructionSet);
+#else
+    default:
+        return false;
+#endif
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+#ifndef QVIMAGESCALER_H
+#define QVIMAGESCALER_H
+
+#include <QImage>
+
+// Separable fixed-point resampler for downscaling, used in place of Qt::SmoothTransformation.
+// Big reductions use area averaging, small ones Lanczos-3. The inner loops have SSE4.1 and AVX2
+// versions picked at runtime, and every version produces exactly the same pixels.
+// Large images are processed in stripes of output rows on the global thread pool.
+class QVImageScaler
+{
+public:
+    enum class Filter
+    {
+        Automatic,
+        Area,
+        Lanczos3
+    };
+
+    enum class InstructionSet
+    {
+        Automatic,
+        Scalar,
+        SSE41,
+        AVX2
+    };
+
+    // Automatic only splits the work across threads for images big enough to benefit
+    enum class Threading
+    {
+        Automatic,
+        SingleThreaded,
+        Parallel
+    };
+
+    // Works on RGB32, ARGB32_Premultiplied and Grayscale8 directly, anything else is converted first,
+    // other gray images to Grayscale8.
+    // ARGB32 is scaled premultiplied, like QImage::scaled does, so the result is ARGB32_Premultiplied
+    static QImage scale(const QImage &image, const QSize &size, Filter filter = Filter::Automatic,
+                        InstructionSet instructionSet = InstructionSet::Automatic,
+                        Threading threading = Threading::Automatic);
+
+    // Redoes only the part of scaled, a previous scale() of an image this size, that reads from changedRect.
+    // Returns false when scaled doesn't fit the image, the caller should scale it all again then
+    static bool rescaleRect(const QImage &image, QImage &scaled, const QRect &changedRect, Filter filter = Filter::Automatic);
+
+    // Turns ARGB32 and RGBA8888 into the formats the raster engine blends fastest: RGB32 when every pixel
+    // is opaque, ARGB32_Premultiplied otherwise. Any other format is left alone
+    static void convertToRasterFormat(QImage &image, InstructionSet instructionSet = InstructionSet::Automatic);
+
+    static bool isSupported(InstructionSet instructionSet);
+};
+
+#endif // QVIMAGESCALER_H
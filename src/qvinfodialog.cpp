@@ -35,6 +35,13 @@ void QVInfoDialog::setInfo(const QFileInfo &value, const int &value2, const int
     window()->adjustSize();
 }
 
+void QVInfoDialog::setPlaybackStats(const QVAnimationPlayer::Stats &value)
+{
+    playbackStats = value;
+    updateInfo();
+    window()->adjustSize();
+}
+
 void QVInfoDialog::updateInfo()
 {
     QLocale locale = QLocale::system();
@@ -63,4 +70,34 @@ void QVInfoDialog::updateInfo()
         ui->framesLabel2->hide();
         ui->framesLabel->hide();
     }
+
+    // Average interval between frames against what their delays ask for, to tell whether the file keeps up in real time
+    if (frameCount != 0 && playbackStats.timedFrames > 0)
+    {
+        const double actualInterval = static_cast<double>(playbackStats.actualTime) / playbackStats.timedFrames;
+        const double targetInterval = static_cast<double>(playbackStats.targetTime) / playbackStats.timedFrames;
+        ui->playbackLabel2->show();
+        ui->playbackLabel->show();
+        ui->playbackLabel->setText(tr("%1 ms per frame (target %2 ms), %n dropped", nullptr, playbackStats.droppedFrames)
+                                   .arg(QString::number(actualInterval, 'f', 1), QString::number(targetInterval, 'f', 1)));
+    }
+    else
+    {
+        ui->playbackLabel2->hide();
+        ui->playbackLabel->hide();
+    }
+
+    if (frameCount != 0 && playbackStats.decodedFrames > 0)
+    {
+        const double averageDecodeTime = static_cast<double>(playbackStats.decodeTime) / playbackStats.decodedFrames / 1000000;
+        ui->decodingLabel2->show();
+        ui->decodingLabel->show();
+        ui->decodingLabel->setText(tr("%1 ms per frame (max %2 ms)")
+                                   .arg(QString::number(averageDecodeTime, 'f', 1), QString::number(playbackStats.maxDecodeTime / 1000000.0, 'f', 1)));
+    }
+    else
+    {
+        ui->decodingLabel2->hide();
+        ui->decodingLabel->hide();
+    }
 }
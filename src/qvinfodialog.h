@@ -1,6 +1,8 @@
 #ifndef QVINFODIALOG_H
 #define QVINFODIALOG_H
 
+#include "qvanimationplayer.h"
+
 #include <QDialog>
 #include <QFileInfo>
 #include <QLocale>
@@ -19,6 +21,9 @@ public:
 
     void setInfo(const QFileInfo &value, const int &value2, const int &value3, const int &value4);
 
+    // Shown along with the frame count, for animations that have played a while
+    void setPlaybackStats(const QVAnimationPlayer::Stats &value);
+
     void updateInfo();
 
 private:
@@ -30,6 +35,8 @@ private:
 
     int frameCount;
 
+    QVAnimationPlayer::Stats playbackStats;
+
 public:
     // If Qt 5.10 is available, the built-in function will be used--for Qt 5.9, a custom solution will be used
     static QString formatBytes(qint64 bytes)
@@ -0,0 +1,619 @@
+#include "qvjpegtransform.h"
+
+#ifdef LIBJPEG_LOADED
+
+#include <QDir>
+#include <QFile>
+#include <QImageReader>
+#include <QSaveFile>
+
+#include <csetjmp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include <jpeglib.h>
+#include <jerror.h>
+}
+
+namespace
+{
+    // Orientations are 2x2 matrices taking centered pixel coordinates in the file to where they end up on screen
+    struct Matrix
+    {
+        int m[2][2];
+    };
+
+    Matrix multiply(const Matrix &a, const Matrix &b)
+    {
+        Matrix result;
+        for (int row = 0; row < 2; row++)
+        {
+            for (int column = 0; column < 2; column++)
+                result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column];
+        }
+        return result;
+    }
+
+    const Matrix IDENTITY = {{{1, 0}, {0, 1}}};
+    const Matrix ROTATE_90 = {{{0, -1}, {1, 0}}};
+    const Matrix MIRROR = {{{-1, 0}, {0, 1}}};
+    const Matrix FLIP = {{{1, 0}, {0, -1}}};
+
+    Matrix getExifMatrix(int orientation)
+    {
+        switch (orientation)
+        {
+        case 2: return MIRROR;
+        case 3: return multiply(ROTATE_90, ROTATE_90);
+        case 4: return FLIP;
+        case 5: return {{{0, 1}, {1, 0}}};
+        case 6: return ROTATE_90;
+        case 7: return {{{0, -1}, {-1, 0}}};
+        case 8: return {{{0, 1}, {-1, 0}}};
+        default: return IDENTITY;
+        }
+    }
+
+    Matrix getViewMatrix(int rotation, bool mirrored, bool flipped)
+    {
+        Matrix matrix = IDENTITY;
+        for (int quarterTurns = ((rotation / 90) % 4 + 4) % 4; quarterTurns > 0; quarterTurns--)
+            matrix = multiply(ROTATE_90, matrix);
+        if (mirrored)
+            matrix = multiply(MIRROR, matrix);
+        if (flipped)
+            matrix = multiply(FLIP, matrix);
+        return matrix;
+    }
+
+    // Any orientation is a transpose followed by mirroring the result along either axis,
+    // which is how it's applied to the blocks and to the coefficients inside them
+    struct Orientation
+    {
+        bool transpose;
+        bool mirrorX;
+        bool mirrorY;
+    };
+
+    Orientation toOrientation(const Matrix &matrix)
+    {
+        if (matrix.m[0][0] != 0)
+            return {false, matrix.m[0][0] < 0, matrix.m[1][1] < 0};
+        return {true, matrix.m[0][1] < 0, matrix.m[1][0] < 0};
+    }
+
+    void transformBlock(const JCOEF *source, JCOEF *destination, const Orientation &orientation)
+    {
+        for (int row = 0; row < DCTSIZE; row++)
+        {
+            for (int column = 0; column < DCTSIZE; column++)
+            {
+                JCOEF value = orientation.transpose ? source[column * DCTSIZE + row] : source[row * DCTSIZE + column];
+                // Mirroring a block flips the sign of its odd frequencies along that axis
+                if ((orientation.mirrorX && (column & 1)) != (orientation.mirrorY && (row & 1)))
+                    value = -value;
+                destination[row * DCTSIZE + column] = value;
+            }
+        }
+    }
+
+    // EXIF is a small TIFF file inside APP1, in either byte order
+    struct Tiff
+    {
+        JOCTET *data;
+        unsigned int length;
+        bool bigEndian;
+    };
+
+    const unsigned int ORIENTATION_TAG = 0x0112;
+    const unsigned int EXIF_IFD_TAG = 0x8769;
+    const unsigned int PIXEL_X_DIMENSION_TAG = 0xA002;
+    const unsigned int PIXEL_Y_DIMENSION_TAG = 0xA003;
+    const unsigned int SHORT_TYPE = 3;
+    const unsigned int LONG_TYPE = 4;
+
+    unsigned int read16(const Tiff &tiff, unsigned int offset)
+    {
+        const JOCTET *bytes = tiff.data + offset;
+        return tiff.bigEndian ? (bytes[0] << 8 | bytes[1]) : (bytes[1] << 8 | bytes[0]);
+    }
+
+    unsigned int read32(const Tiff &tiff, unsigned int offset)
+    {
+        return tiff.bigEndian ? (read16(tiff, offset) << 16 | read16(tiff, offset + 2))
+                              : (read16(tiff, offset + 2) << 16 | read16(tiff, offset));
+    }
+
+    void write16(const Tiff &tiff, unsigned int offset, unsigned int value)
+    {
+        JOCTET *bytes = tiff.data + offset;
+        bytes[tiff.bigEndian ? 0 : 1] = static_cast<JOCTET>(value >> 8);
+        bytes[tiff.bigEndian ? 1 : 0] = static_cast<JOCTET>(value);
+    }
+
+    void write32(const Tiff &tiff, unsigned int offset, unsigned int value)
+    {
+        write16(tiff, offset + (tiff.bigEndian ? 0 : 2), value >> 16);
+        write16(tiff, offset + (tiff.bigEndian ? 2 : 0), value & 0xFFFF);
+    }
+
+    bool openExif(jpeg_saved_marker_ptr marker, Tiff &tiff)
+    {
+        if (marker->marker != JPEG_APP0 + 1 || marker->data_length < 14 || memcmp(marker->data, "Exif\0\0", 6) != 0)
+            return false;
+
+        tiff.data = marker->data + 6;
+        tiff.length = marker->data_length - 6;
+        if (memcmp(tiff.data, "MM", 2) == 0)
+            tiff.bigEndian = true;
+        else if (memcmp(tiff.data, "II", 2) == 0)
+            tiff.bigEndian = false;
+        else
+            return false;
+        return read16(tiff, 2) == 42;
+    }
+
+    // Returns the offset of the tag's 12-byte entry in the directory, or 0 if it isn't there
+    unsigned int findEntry(const Tiff &tiff, unsigned int directory, unsigned int tag)
+    {
+        if (directory < 8 || directory > tiff.length - 2)
+            return 0;
+
+        const unsigned int entryCount = read16(tiff, directory);
+        for (unsigned int i = 0; i < entryCount; i++)
+        {
+            const unsigned int entry = directory + 2 + i * 12;
+            if (entry > tiff.length - 12)
+                return 0;
+            if (read16(tiff, entry) == tag)
+                return entry;
+        }
+        return 0;
+    }
+
+    int readExifOrientation(jpeg_saved_marker_ptr markers)
+    {
+        Tiff tiff;
+        for (jpeg_saved_marker_ptr marker = markers; marker; marker = marker->next)
+        {
+            if (!openExif(marker, tiff))
+                continue;
+
+            const unsigned int entry = findEntry(tiff, read32(tiff, 4), ORIENTATION_TAG);
+            if (entry == 0 || read16(tiff, entry + 2) != SHORT_TYPE)
+                return 1;
+            const unsigned int orientation = read16(tiff, entry + 8);
+            return orientation >= 1 && orientation <= 8 ? static_cast<int>(orientation) : 1;
+        }
+        return 1;
+    }
+
+    void writeDimension(const Tiff &tiff, unsigned int entry, unsigned int value)
+    {
+        if (entry == 0)
+            return;
+        if (read16(tiff, entry + 2) == SHORT_TYPE)
+            write16(tiff, entry + 8, value);
+        else if (read16(tiff, entry + 2) == LONG_TYPE)
+            write32(tiff, entry + 8, value);
+    }
+
+    // The orientation is now in the pixels, and the size may have changed with it.
+    // The thumbnail in the second directory would still be the old way around with the orientation reset, so it's unlinked.
+    // Its bytes stay behind unreferenced, since other data may come after them
+    void updateExif(jpeg_saved_marker_ptr marker, unsigned int width, unsigned int height)
+    {
+        Tiff tiff;
+        if (!openExif(marker, tiff))
+            return;
+
+        const unsigned int firstDirectory = read32(tiff, 4);
+        const unsigned int orientationEntry = findEntry(tiff, firstDirectory, ORIENTATION_TAG);
+        if (orientationEntry != 0 && read16(tiff, orientationEntry + 2) == SHORT_TYPE)
+            write16(tiff, orientationEntry + 8, 1);
+
+        if (firstDirectory >= 8 && firstDirectory <= tiff.length - 2)
+        {
+            const unsigned int nextDirectoryLink = firstDirectory + 2 + read16(tiff, firstDirectory) * 12;
+            if (nextDirectoryLink <= tiff.length - 4)
+                write32(tiff, nextDirectoryLink, 0);
+        }
+
+        const unsigned int exifEntry = findEntry(tiff, firstDirectory, EXIF_IFD_TAG);
+        if (exifEntry == 0)
+            return;
+        const unsigned int exifDirectory = read32(tiff, exifEntry + 8);
+        writeDimension(tiff, findEntry(tiff, exifDirectory, PIXEL_X_DIMENSION_TAG), width);
+        writeDimension(tiff, findEntry(tiff, exifDirectory, PIXEL_Y_DIMENSION_TAG), height);
+    }
+
+    // libjpeg reports errors by calling error_exit, which must not return, so it jumps back to where the work started
+    struct ErrorManager
+    {
+        jpeg_error_mgr manager;
+        jmp_buf jump;
+        char message[JMSG_LENGTH_MAX];
+    };
+
+    void exitWithError(j_common_ptr info)
+    {
+        auto *error = reinterpret_cast<ErrorManager *>(info->err);
+        (*info->err->format_message)(info, error->message);
+        longjmp(error->jump, 1);
+    }
+
+    void ignoreMessage(j_common_ptr info)
+    {
+        Q_UNUSED(info)
+    }
+
+    // Our own source and destination, since jpeg_mem_src and jpeg_mem_dest aren't in every libjpeg
+    // and the destination's buffer has to stay ours to free when something fails halfway
+    void initSource(j_decompress_ptr info)
+    {
+        Q_UNUSED(info)
+    }
+
+    boolean fillInputBuffer(j_decompress_ptr info)
+    {
+        // The whole file was handed over at the start, so this is a truncated file. End it where it stops
+        static const JOCTET endOfImage[] = {0xFF, JPEG_EOI};
+        WARNMS(info, JWRN_JPEG_EOF);
+        info->src->next_input_byte = endOfImage;
+        info->src->bytes_in_buffer = sizeof(endOfImage);
+        return TRUE;
+    }
+
+    void skipInputData(j_decompress_ptr info, long byteCount)
+    {
+        if (byteCount <= 0)
+            return;
+        if (static_cast<unsigned long>(byteCount) > info->src->bytes_in_buffer)
+        {
+            fillInputBuffer(info);
+            return;
+        }
+        info->src->next_input_byte += byteCount;
+        info->src->bytes_in_buffer -= static_cast<size_t>(byteCount);
+    }
+
+    void termSource(j_decompress_ptr info)
+    {
+        Q_UNUSED(info)
+    }
+
+    struct MemoryDestination
+    {
+        jpeg_destination_mgr manager;
+        JOCTET *buffer;
+        size_t capacity;
+        size_t size;
+    };
+
+    void initDestination(j_compress_ptr info)
+    {
+        auto *destination = reinterpret_cast<MemoryDestination *>(info->dest);
+        destination->buffer = static_cast<JOCTET *>(malloc(destination->capacity));
+        if (!destination->buffer)
+            ERREXIT1(info, JERR_OUT_OF_MEMORY, 0);
+        destination->manager.next_output_byte = destination->buffer;
+        destination->manager.free_in_buffer = destination->capacity;
+    }
+
+    boolean emptyOutputBuffer(j_compress_ptr info)
+    {
+        auto *destination = reinterpret_cast<MemoryDestination *>(info->dest);
+        auto *buffer = static_cast<JOCTET *>(realloc(destination->buffer, destination->capacity * 2));
+        if (!buffer)
+            ERREXIT1(info, JERR_OUT_OF_MEMORY, 1);
+        destination->buffer = buffer;
+        destination->manager.next_output_byte = buffer + destination->capacity;
+        destination->manager.free_in_buffer = destination->capacity;
+        destination->capacity *= 2;
+        return TRUE;
+    }
+
+    void termDestination(j_compress_ptr info)
+    {
+        auto *destination = reinterpret_cast<MemoryDestination *>(info->dest);
+        destination->size = destination->capacity - destination->manager.free_in_buffer;
+    }
+
+    JDIMENSION roundUp(JDIMENSION value, int multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    void abandon(j_decompress_ptr source, j_compress_ptr destination, JOCTET *buffer)
+    {
+        jpeg_destroy_compress(destination);
+        jpeg_destroy_decompress(source);
+        free(buffer);
+    }
+
+    // Everything here is plain data, since a longjmp out of libjpeg would skip any destructors.
+    // On success *output is malloc'd and belongs to the caller
+    bool transformJpeg(const JOCTET *data, size_t size, int rotation, bool mirrored, bool flipped,
+                       JOCTET **output, size_t *outputSize, char *errorMessage)
+    {
+        jpeg_decompress_struct source;
+        jpeg_compress_struct destination;
+        jpeg_source_mgr memorySource;
+        MemoryDestination memoryDestination;
+        ErrorManager error;
+        memset(&source, 0, sizeof(source));
+        memset(&destination, 0, sizeof(destination));
+        memset(&memorySource, 0, sizeof(memorySource));
+        memset(&memoryDestination, 0, sizeof(memoryDestination));
+
+        source.err = jpeg_std_error(&error.manager);
+        destination.err = &error.manager;
+        error.manager.error_exit = exitWithError;
+        error.manager.output_message = ignoreMessage;
+        error.message[0] = '\0';
+
+        if (setjmp(error.jump))
+        {
+            strcpy(errorMessage, error.message);
+            abandon(&source, &destination, memoryDestination.buffer);
+            return false;
+        }
+
+        jpeg_create_decompress(&source);
+        jpeg_create_compress(&destination);
+
+        memorySource.init_source = initSource;
+        memorySource.fill_input_buffer = fillInputBuffer;
+        memorySource.skip_input_data = skipInputData;
+        memorySource.resync_to_restart = jpeg_resync_to_restart;
+        memorySource.term_source = termSource;
+        memorySource.next_input_byte = data;
+        memorySource.bytes_in_buffer = size;
+        source.src = &memorySource;
+
+        // Every APPn and COM marker is written back out as it was, apart from the EXIF fields updated below
+        jpeg_save_markers(&source, JPEG_COM, 0xFFFF);
+        for (int i = 0; i < 16; i++)
+            jpeg_save_markers(&source, JPEG_APP0 + i, 0xFFFF);
+        jpeg_read_header(&source, TRUE);
+
+        const Orientation orientation = toOrientation(multiply(getViewMatrix(rotation, mirrored, flipped),
+                                                               getExifMatrix(readExifOrientation(source.marker_list))));
+
+        jvirt_barray_ptr *sourceCoefficients = jpeg_read_coefficients(&source);
+
+        // A truncated or corrupt file still reads, with the damage filled in, but it shouldn't be written back over itself
+        if (error.manager.num_warnings > 0)
+        {
+            strcpy(errorMessage, "The file is damaged");
+            abandon(&source, &destination, nullptr);
+            return false;
+        }
+
+        // An edge with a partial MCU stays put unless its axis is mirrored, where it would land inside the image, so it goes
+        const int mcuWidth = source.max_h_samp_factor * DCTSIZE;
+        const int mcuHeight = source.max_v_samp_factor * DCTSIZE;
+        const bool mirrorSourceX = orientation.transpose ? orientation.mirrorY : orientation.mirrorX;
+        const bool mirrorSourceY = orientation.transpose ? orientation.mirrorX : orientation.mirrorY;
+        JDIMENSION sourceWidth = source.image_width;
+        JDIMENSION sourceHeight = source.image_height;
+        if (mirrorSourceX)
+            sourceWidth -= sourceWidth % mcuWidth;
+        if (mirrorSourceY)
+            sourceHeight -= sourceHeight % mcuHeight;
+        if (sourceWidth == 0 || sourceHeight == 0)
+        {
+            strcpy(errorMessage, "The image is smaller than one MCU");
+            abandon(&source, &destination, nullptr);
+            return false;
+        }
+
+        jpeg_copy_critical_parameters(&source, &destination);
+        destination.image_width = orientation.transpose ? sourceHeight : sourceWidth;
+        destination.image_height = orientation.transpose ? sourceWidth : sourceHeight;
+        if (orientation.transpose)
+        {
+            for (int ci = 0; ci < destination.num_components; ci++)
+            {
+                jpeg_component_info *component = destination.comp_info + ci;
+                const int horizontalSampling = component->h_samp_factor;
+                component->h_samp_factor = component->v_samp_factor;
+                component->v_samp_factor = horizontalSampling;
+            }
+
+            // Coefficients trade places with their transposed frequency, so their quantizers have to as well
+            for (int i = 0; i < NUM_QUANT_TBLS; i++)
+            {
+                JQUANT_TBL *table = destination.quant_tbl_ptrs[i];
+                if (!table)
+                    continue;
+                for (int row = 0; row < DCTSIZE; row++)
+                {
+                    for (int column = row + 1; column < DCTSIZE; column++)
+                    {
+                        const UINT16 quantizer = table->quantval[row * DCTSIZE + column];
+                        table->quantval[row * DCTSIZE + column] = table->quantval[column * DCTSIZE + row];
+                        table->quantval[column * DCTSIZE + row] = quantizer;
+                    }
+                }
+            }
+        }
+
+        // Allocated from the source, like jpegtran does, since the destination hasn't started yet
+        jvirt_barray_ptr destinationCoefficients[MAX_COMPONENTS];
+        for (int ci = 0; ci < destination.num_components; ci++)
+        {
+            const jpeg_component_info *component = destination.comp_info + ci;
+            const JDIMENSION blockColumns = orientation.transpose ? source.comp_info[ci].height_in_blocks : source.comp_info[ci].width_in_blocks;
+            const JDIMENSION blockRows = orientation.transpose ? source.comp_info[ci].width_in_blocks : source.comp_info[ci].height_in_blocks;
+            destinationCoefficients[ci] = (*source.mem->request_virt_barray)(reinterpret_cast<j_common_ptr>(&source), JPOOL_IMAGE, FALSE,
+                                                                              roundUp(blockColumns, component->h_samp_factor),
+                                                                              roundUp(blockRows, component->v_samp_factor),
+                                                                              static_cast<JDIMENSION>(component->v_samp_factor));
+        }
+        (*source.mem->realize_virt_arrays)(reinterpret_cast<j_common_ptr>(&source));
+
+        for (int ci = 0; ci < destination.num_components; ci++)
+        {
+            const jpeg_component_info *sourceComponent = source.comp_info + ci;
+            const jpeg_component_info *destinationComponent = destination.comp_info + ci;
+
+            // Blocks kept from the source, then where they fit in the destination
+            const JDIMENSION keptColumns = mirrorSourceX ? sourceWidth / mcuWidth * sourceComponent->h_samp_factor
+                                                         : sourceComponent->width_in_blocks;
+            const JDIMENSION keptRows = mirrorSourceY ? sourceHeight / mcuHeight * sourceComponent->v_samp_factor
+                                                      : sourceComponent->height_in_blocks;
+            const JDIMENSION blockColumns = orientation.transpose ? keptRows : keptColumns;
+            const JDIMENSION blockRows = orientation.transpose ? keptColumns : keptRows;
+            const JDIMENSION paddedColumns = roundUp(orientation.transpose ? sourceComponent->height_in_blocks : sourceComponent->width_in_blocks,
+                                                     destinationComponent->h_samp_factor);
+            const JDIMENSION paddedRows = roundUp(orientation.transpose ? sourceComponent->width_in_blocks : sourceComponent->height_in_blocks,
+                                                  destinationComponent->v_samp_factor);
+            const int rowsPerAccess = destinationComponent->v_samp_factor;
+
+            for (JDIMENSION firstRow = 0; firstRow < paddedRows; firstRow += rowsPerAccess)
+            {
+                JBLOCKARRAY destinationRows = (*source.mem->access_virt_barray)(reinterpret_cast<j_common_ptr>(&source), destinationCoefficients[ci],
+                                                                                firstRow, static_cast<JDIMENSION>(rowsPerAccess), TRUE);
+                for (int offset = 0; offset < rowsPerAccess; offset++)
+                {
+                    const JDIMENSION y = firstRow + offset;
+                    const JDIMENSION mirroredY = orientation.mirrorY ? blockRows - 1 - y : y;
+
+                    // Without a transpose every block in this row comes from the same source row
+                    JBLOCKROW sourceRow = nullptr;
+                    if (!orientation.transpose && y < blockRows)
+                    {
+                        sourceRow = (*source.mem->access_virt_barray)(reinterpret_cast<j_common_ptr>(&source), sourceCoefficients[ci],
+                                                                      mirroredY, 1, FALSE)[0];
+                    }
+
+                    for (JDIMENSION x = 0; x < paddedColumns; x++)
+                    {
+                        JCOEFPTR block = destinationRows[offset][x];
+                        if (x >= blockColumns || y >= blockRows)
+                        {
+                            memset(block, 0, sizeof(JBLOCK));
+                            continue;
+                        }
+
+                        const JDIMENSION mirroredX = orientation.mirrorX ? blockColumns - 1 - x : x;
+                        if (orientation.transpose)
+                        {
+                            sourceRow = (*source.mem->access_virt_barray)(reinterpret_cast<j_common_ptr>(&source), sourceCoefficients[ci],
+                                                                          mirroredX, 1, FALSE)[0];
+                            transformBlock(sourceRow[mirroredY], block, orientation);
+                        }
+                        else
+                        {
+                            transformBlock(sourceRow[mirroredX], block, orientation);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Huffman tables are rebuilt for the moved coefficients, which usually makes the file a little smaller
+        destination.optimize_coding = TRUE;
+        if (source.progressive_mode)
+            jpeg_simple_progression(&destination);
+
+        memoryDestination.manager.init_destination = initDestination;
+        memoryDestination.manager.empty_output_buffer = emptyOutputBuffer;
+        memoryDestination.manager.term_destination = termDestination;
+        memoryDestination.capacity = size + 4096;
+        destination.dest = &memoryDestination.manager;
+
+        jpeg_write_coefficients(&destination, destinationCoefficients);
+
+        for (jpeg_saved_marker_ptr marker = source.marker_list; marker; marker = marker->next)
+        {
+            // The encoder has already written its own JFIF and Adobe markers
+            if (destination.write_JFIF_header && marker->marker == JPEG_APP0 &&
+                marker->data_length >= 5 && memcmp(marker->data, "JFIF\0", 5) == 0)
+                continue;
+            if (destination.write_Adobe_marker && marker->marker == JPEG_APP0 + 14 &&
+                marker->data_length >= 5 && memcmp(marker->data, "Adobe", 5) == 0)
+                continue;
+
+            updateExif(marker, destination.image_width, destination.image_height);
+            jpeg_write_marker(&destination, static_cast<int>(marker->marker), marker->data, marker->data_length);
+        }
+
+        jpeg_finish_compress(&destination);
+        jpeg_finish_decompress(&source);
+        jpeg_destroy_compress(&destination);
+        jpeg_destroy_decompress(&source);
+
+        *output = memoryDestination.buffer;
+        *outputSize = memoryDestination.size;
+        return true;
+    }
+}
+
+QString QVJpegTransform::transformFile(const QString &filePath, int rotation, bool mirrored, bool flipped)
+{
+    const QString displayPath = QDir::toNativeSeparators(filePath);
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return tr("Could not open %1:\n%2").arg(displayPath, file.errorString());
+    const QByteArray data = file.readAll();
+    file.close();
+
+    JOCTET *output = nullptr;
+    size_t outputSize = 0;
+    char errorMessage[JMSG_LENGTH_MAX] = {};
+    if (!transformJpeg(reinterpret_cast<const JOCTET *>(data.constData()), static_cast<size_t>(data.size()),
+                       rotation, mirrored, flipped, &output, &outputSize, errorMessage))
+    {
+        return tr("Could not transform %1:\n%2").arg(displayPath, QString::fromLocal8Bit(errorMessage));
+    }
+
+    // Written beside the original and renamed over it, so nothing is lost if this fails halfway
+    QSaveFile saveFile(filePath);
+    const bool saved = saveFile.open(QIODevice::WriteOnly) &&
+                       saveFile.write(reinterpret_cast<const char *>(output), static_cast<qint64>(outputSize)) == static_cast<qint64>(outputSize) &&
+                       saveFile.commit();
+    free(output);
+
+    if (!saved)
+        return tr("Could not save %1:\n%2").arg(displayPath, saveFile.errorString());
+    return QString();
+}
+
+bool QVJpegTransform::canTransform(const QString &filePath)
+{
+    return QImageReader::imageFormat(filePath) == "jpeg";
+}
+
+bool QVJpegTransform::isSupported()
+{
+    return true;
+}
+
+#else
+
+QString QVJpegTransform::transformFile(const QString &filePath, int rotation, bool mirrored, bool flipped)
+{
+    Q_UNUSED(filePath)
+    Q_UNUSED(rotation)
+    Q_UNUSED(mirrored)
+    Q_UNUSED(flipped)
+    return tr("qView was built without libjpeg.");
+}
+
+bool QVJpegTransform::canTransform(const QString &filePath)
+{
+    Q_UNUSED(filePath)
+    return false;
+}
+
+bool QVJpegTransform::isSupported()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef QVJPEGTRANSFORM_H
+#define QVJPEGTRANSFORM_H
+
+#include <QCoreApplication>
+#include <QString>
+
+// Rotates and mirrors JPEG files without decoding them, by moving the quantized DCT blocks and their coefficients
+// around the way jpegtran does, so nothing is lost and it takes a fraction of the time a re-encode would.
+// Blocks along a mirrored edge that don't fill a whole MCU can't be moved to the other side, so those few pixels are trimmed off.
+// The EXIF orientation is applied along with the rest and then reset, so other viewers show the file the same way,
+// and the EXIF thumbnail, which would be left the old way around, is dropped.
+// Needs libjpeg, so this does nothing when built without it
+class QVJpegTransform
+{
+    Q_DECLARE_TR_FUNCTIONS(QVJpegTransform)
+
+public:
+    // rotation is clockwise in degrees, and mirrored and flipped are applied after it, as the image is shown.
+    // Blocks while it works and returns an empty string on success, or what went wrong
+    static QString transformFile(const QString &filePath, int rotation, bool mirrored, bool flipped);
+
+    static bool canTransform(const QString &filePath);
+
+    static bool isSupported();
+};
+
+#endif // QVJPEGTRANSFORM_H
@@ -0,0 +1,206 @@
+#include "qvlinuxfunctions.h"
+
+#include <QFile>
+#include <QtConcurrent/QtConcurrentMap>
+#include <atomic>
+#include <cerrno>
+#include <numeric>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <QDebug>
+
+namespace
+{
+    // Layout of the records returned by the getdents64 syscall, glibc does not declare it for us
+    struct LinuxDirent64
+    {
+        quint64 d_ino;
+        qint64 d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+
+    // Big enough that even folders with hundreds of thousands of entries only need a few syscalls
+    const int DIRENT_BUFFER_SIZE = 64 * 1024;
+
+    // Below this, the thread pool costs more than the stat calls it would parallelize
+    const int PARALLEL_STAT_THRESHOLD = 128;
+
+    class FileDescriptor
+    {
+    public:
+        explicit FileDescriptor(int fd) : fd(fd) {}
+        ~FileDescriptor() { if (fd >= 0) ::close(fd); }
+        int get() const { return fd; }
+    private:
+        int fd;
+    };
+
+#ifdef STATX_BASIC_STATS
+    // Set once statx turns out to be missing, kernels before 4.11 and some seccomp sandboxes refuse it on every call
+    std::atomic<bool> isStatxUnavailable(false);
+#endif
+
+    // Returns 0 if the entry couldn't be stat'ed
+    mode_t getFileModeAt(int dirFd, const char *name, bool followLinks)
+    {
+        struct stat st;
+        if (fstatat(dirFd, name, &st, followLinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+            return 0;
+
+        return st.st_mode;
+    }
+}
+
+bool QVLinuxFunctions::listFileNames(const QString &dirPath, QStringList &fileNames, QStringList *subdirNames)
+{
+    const FileDescriptor dirFd(::open(QFile::encodeName(dirPath).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (dirFd.get() < 0)
+    {
+        qWarning() << "Failed to open directory for scanning:" << dirPath;
+        return false;
+    }
+
+    QByteArray buffer(DIRENT_BUFFER_SIZE, Qt::Uninitialized);
+    while (true)
+    {
+        const long bytesRead = syscall(SYS_getdents64, dirFd.get(), buffer.data(), buffer.size());
+        if (bytesRead < 0)
+        {
+            qWarning() << "getdents64 failed while scanning:" << dirPath;
+            return false;
+        }
+
+        if (bytesRead == 0)
+            break;
+
+        long offset = 0;
+        while (offset < bytesRead)
+        {
+            const auto *entry = reinterpret_cast<const LinuxDirent64 *>(buffer.constData() + offset);
+            offset += entry->d_reclen;
+
+            // Skip hidden files, as well as . and .., to match QDir's default filter
+            if (entry->d_name[0] == '.')
+                continue;
+
+            // d_type lets us skip directories and such without touching the inode,
+            // only links and filesystems that don't report a type (some NFS, CIFS and FUSE mounts,
+            // XFS without ftype) need a stat. Symlinked folders are never followed so recursive walks can't loop
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN)
+            {
+                const mode_t mode = getFileModeAt(dirFd.get(), entry->d_name, false);
+                if (S_ISREG(mode))
+                    type = DT_REG;
+                else if (S_ISDIR(mode))
+                    type = DT_DIR;
+                else if (S_ISLNK(mode))
+                    type = DT_LNK;
+            }
+
+            switch (type) {
+            case DT_REG:
+                break;
+            case DT_DIR:
+            {
+                if (subdirNames)
+                    subdirNames->append(QFile::decodeName(entry->d_name));
+                continue;
+            }
+            case DT_LNK:
+            {
+                if (!S_ISREG(getFileModeAt(dirFd.get(), entry->d_name, true)))
+                    continue;
+                break;
+            }
+            default:
+                continue;
+            }
+
+            fileNames.append(QFile::decodeName(entry->d_name));
+        }
+    }
+
+    return true;
+}
+
+bool QVLinuxFunctions::statFiles(const QString &dirPath, const QStringList &fileNames, QVector<qint64> *lastModifieds, QVector<qint64> *sizes)
+{
+    // Pass nullptr for the arrays the caller doesn't need, they are filled with -1 on failure
+    if (lastModifieds)
+        lastModifieds->fill(-1, fileNames.length());
+    if (sizes)
+        sizes->fill(-1, fileNames.length());
+
+    if ((!lastModifieds && !sizes) || fileNames.isEmpty())
+        return true;
+
+    const FileDescriptor dirFd(::open(QFile::encodeName(dirPath).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (dirFd.get() < 0)
+        return false;
+
+    // Resolve the raw pointers up front so worker threads never touch the containers themselves
+    const int fd = dirFd.get();
+    qint64 *lastModifiedData = lastModifieds ? lastModifieds->data() : nullptr;
+    qint64 *sizeData = sizes ? sizes->data() : nullptr;
+
+    auto statFile = [fd, &fileNames, lastModifiedData, sizeData](int i){
+        const QByteArray encodedName = QFile::encodeName(fileNames.at(i));
+#ifdef STATX_BASIC_STATS
+        // Only ask for the fields the sort mode needs, and don't force network filesystems to revalidate
+        unsigned int mask = 0;
+        if (sizeData)
+            mask |= STATX_SIZE;
+        if (lastModifiedData)
+            mask |= STATX_MTIME;
+
+        if (!isStatxUnavailable.load(std::memory_order_relaxed))
+        {
+            struct statx stx;
+            if (statx(fd, encodedName.constData(), AT_STATX_DONT_SYNC, mask, &stx) == 0)
+            {
+                if (sizeData && (stx.stx_mask & STATX_SIZE))
+                    sizeData[i] = static_cast<qint64>(stx.stx_size);
+                if (lastModifiedData && (stx.stx_mask & STATX_MTIME))
+                    lastModifiedData[i] = static_cast<qint64>(stx.stx_mtime.tv_sec) * 1000 + stx.stx_mtime.tv_nsec / 1000000;
+                return;
+            }
+
+            // Any other error is about the file itself, which fstatat would only report again
+            if (errno != ENOSYS && errno != EPERM)
+                return;
+            isStatxUnavailable.store(true, std::memory_order_relaxed);
+        }
+#endif
+        struct stat st;
+        if (fstatat(fd, encodedName.constData(), &st, 0) != 0)
+            return;
+
+        if (sizeData)
+            sizeData[i] = static_cast<qint64>(st.st_size);
+        if (lastModifiedData)
+            lastModifiedData[i] = static_cast<qint64>(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+    };
+
+    // On high latency filesystems (NFS, FUSE) each stat is a round trip, so keep several in flight at once
+    if (fileNames.length() >= PARALLEL_STAT_THRESHOLD)
+    {
+        QVector<int> indices(fileNames.length());
+        std::iota(indices.begin(), indices.end(), 0);
+        QtConcurrent::blockingMap(indices, statFile);
+    }
+    else
+    {
+        for (int i = 0; i < fileNames.length(); i++)
+            statFile(i);
+    }
+
+    return true;
+}
@@ -0,0 +1,15 @@
+#ifndef QVLINUXFUNCTIONS_H
+#define QVLINUXFUNCTIONS_H
+
+#include <QStringList>
+#include <QVector>
+
+class QVLinuxFunctions
+{
+public:
+    static bool listFileNames(const QString &dirPath, QStringList &fileNames, QStringList *subdirNames = nullptr);
+
+    static bool statFiles(const QString &dirPath, const QStringList &fileNames, QVector<qint64> *lastModifieds, QVector<qint64> *sizes);
+};
+
+#endif // QVLINUXFUNCTIONS_H
@@ -51,6 +51,11 @@ QVOptionsDialog::QVOptionsDialog(QWidget *parent) :
     ui->quitOnLastWindowCheckbox->hide();
 #endif
 
+// Hide color management below 5.14, as QColorSpace is not available before then
+#if (QT_VERSION < QT_VERSION_CHECK(5, 14, 0))
+    ui->colorManagementCheckbox->hide();
+#endif
+
 // Hide language selection below 5.12, as 5.12 does not support embedding the translations :(
 #if (QT_VERSION < QT_VERSION_CHECK(5, 12, 0))
     ui->langComboBox->hide();
@@ -173,6 +178,8 @@ void QVOptionsDialog::syncSettings(bool defaults, bool makeConnections)
     syncComboBox(ui->cropModeComboBox, "cropmode", defaults, makeConnections);
     // pastactualsizeenabled
     syncCheckbox(ui->pastActualSizeCheckbox, "pastactualsizeenabled", defaults, makeConnections);
+    // colormanagementenabled
+    syncCheckbox(ui->colorManagementCheckbox, "colormanagementenabled", defaults, makeConnections);
     // language
     syncComboBoxData(ui->langComboBox, "language", defaults, makeConnections);
     // sortmode
@@ -183,6 +190,8 @@ void QVOptionsDialog::syncSettings(bool defaults, bool makeConnections)
     syncComboBox(ui->preloadingComboBox, "preloadingmode", defaults, makeConnections);
     // loopfolders
     syncCheckbox(ui->loopFoldersCheckbox, "loopfoldersenabled", defaults, makeConnections);
+    // recursivefolders
+    syncCheckbox(ui->recursiveFoldersCheckbox, "recursivefoldersenabled", defaults, makeConnections);
     // slideshowreversed
     syncComboBox(ui->slideshowDirectionComboBox, "slideshowreversed", defaults, makeConnections);
     // slideshowtimer
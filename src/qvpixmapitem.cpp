@@ -0,0 +1,43 @@
+#include "qvpixmapitem.h"
+
+#include <QPainter>
+
+QVPixmapItem::QVPixmapItem(QGraphicsItem *parent) : QGraphicsPixmapItem(parent)
+{
+}
+
+void QVPixmapItem::setPixmap(const QPixmap &pixmap)
+{
+    framePixmap = QPixmap();
+    QGraphicsPixmapItem::setPixmap(pixmap);
+}
+
+void QVPixmapItem::setFramePixmap(const QPixmap &pixmap, const QRect &changedRect)
+{
+    if (pixmap.isNull() || pixmap.size() != QGraphicsPixmapItem::pixmap().size())
+    {
+        setPixmap(pixmap);
+        return;
+    }
+
+    framePixmap = pixmap;
+    if (!changedRect.isEmpty())
+        update(QRectF(changedRect).translated(offset()));
+}
+
+QPixmap QVPixmapItem::pixmap() const
+{
+    return framePixmap.isNull() ? QGraphicsPixmapItem::pixmap() : framePixmap;
+}
+
+void QVPixmapItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    if (framePixmap.isNull())
+    {
+        QGraphicsPixmapItem::paint(painter, option, widget);
+        return;
+    }
+
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, transformationMode() == Qt::SmoothTransformation);
+    painter->drawPixmap(offset(), framePixmap);
+}
@@ -0,0 +1,27 @@
+#ifndef QVPIXMAPITEM_H
+#define QVPIXMAPITEM_H
+
+#include <QGraphicsPixmapItem>
+
+// The item QVGraphicsView shows the image with. QGraphicsPixmapItem::setPixmap always has the whole item repainted,
+// so animation frames the size of the one already up are painted from a pixmap of our own and only mark what changed
+class QVPixmapItem : public QGraphicsPixmapItem
+{
+public:
+    explicit QVPixmapItem(QGraphicsItem *parent = nullptr);
+
+    void setPixmap(const QPixmap &pixmap);
+
+    // changedRect is in the pixmap's pixels, a frame of another size is set like any other pixmap
+    void setFramePixmap(const QPixmap &pixmap, const QRect &changedRect);
+
+    QPixmap pixmap() const;
+
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
+
+private:
+    // Painted in place of the pixmap the base class keeps for the geometry
+    QPixmap framePixmap;
+};
+
+#endif // QVPIXMAPITEM_H
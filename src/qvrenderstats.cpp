@@ -0,0 +1,139 @@
+#include "qvrenderstats.h"
+
+#include <QPainter>
+#include <QFile>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <QAtomicInt>
+#include <algorithm>
+
+namespace
+{
+    const int OVERLAY_MARGIN = 8;
+    const int OVERLAY_PADDING = 6;
+    const int BAR_WIDTH = 14;
+    const int BAR_HEIGHT = 24;
+
+    double toMilliseconds(qint64 nanoseconds)
+    {
+        return nanoseconds / 1000000.0;
+    }
+
+    QAtomicInt statsCount;
+}
+
+QVRenderStats::QVRenderStats()
+{
+    // Every window has its own stats and clock, so its rows are told apart by process and creation order
+    sourceName = QString("%1-%2").arg(QCoreApplication::applicationPid()).arg(statsCount.fetchAndAddRelaxed(1) + 1);
+    clock.start();
+}
+
+void QVRenderStats::addSample(Metric metric, qint64 nanoseconds)
+{
+    nanoseconds = qMax<qint64>(0, nanoseconds);
+
+    Histogram &histogram = histograms[static_cast<int>(metric)];
+    histogram.count++;
+    histogram.total += nanoseconds;
+    histogram.max = qMax(histogram.max, nanoseconds);
+
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && nanoseconds >= (1000000LL << bucket))
+        bucket++;
+    histogram.buckets[bucket]++;
+
+    if (samples.size() < MAX_SAMPLES)
+        samples.append({metric, now(), nanoseconds});
+}
+
+void QVRenderStats::drawOverlay(QPainter *painter)
+{
+    const QFontMetrics fontMetrics = painter->fontMetrics();
+    const int lineHeight = qMax(fontMetrics.height(), BAR_HEIGHT) + OVERLAY_PADDING;
+
+    QStringList lines;
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        const Histogram &histogram = histograms.at(i);
+        const double mean = histogram.count ? toMilliseconds(histogram.total) / histogram.count : 0;
+        lines.append(QString("%1  n=%2  mean %3 ms  max %4 ms").arg(getMetricName(static_cast<Metric>(i)))
+                     .arg(histogram.count).arg(mean, 0, 'f', 2).arg(toMilliseconds(histogram.max), 0, 'f', 2));
+    }
+
+    int textWidth = 0;
+    for (const auto &line : lines)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+        textWidth = qMax(textWidth, fontMetrics.horizontalAdvance(line));
+#else
+        textWidth = qMax(textWidth, fontMetrics.width(line));
+#endif
+    }
+
+    const int barsWidth = BUCKET_COUNT * BAR_WIDTH;
+    overlayRect = QRect(OVERLAY_MARGIN, OVERLAY_MARGIN, textWidth + barsWidth + OVERLAY_PADDING * 3,
+                        lineHeight * METRIC_COUNT + OVERLAY_PADDING);
+
+    painter->save();
+    painter->fillRect(overlayRect, QColor(0, 0, 0, 180));
+    painter->setPen(Qt::white);
+
+    for (int i = 0; i < METRIC_COUNT; i++)
+    {
+        const int top = overlayRect.top() + OVERLAY_PADDING + i * lineHeight;
+        painter->drawText(QRect(overlayRect.left() + OVERLAY_PADDING, top, textWidth, BAR_HEIGHT), Qt::AlignVCenter, lines.at(i));
+
+        // Bars are scaled to the fullest bucket of their own metric, 1, 2, 4 ... 256 ms and slower
+        const Histogram &histogram = histograms.at(i);
+        const qint64 fullest = *std::max_element(histogram.buckets.begin(), histogram.buckets.end());
+        const int barsLeft = overlayRect.left() + OVERLAY_PADDING * 2 + textWidth;
+        for (int bucket = 0; bucket < BUCKET_COUNT; bucket++)
+        {
+            const int height = fullest ? static_cast<int>(BAR_HEIGHT * histogram.buckets.at(bucket) / fullest) : 0;
+            const QRect barRect(barsLeft + bucket * BAR_WIDTH, top + BAR_HEIGHT - height, BAR_WIDTH - 2, height);
+            painter->fillRect(barRect, bucket < 5 ? QColor(90, 200, 120) : QColor(230, 120, 80));
+        }
+    }
+
+    painter->restore();
+}
+
+bool QVRenderStats::exportCsv(const QString &filePath) const
+{
+    // Appended, since every window writes to the same file when it closes
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&file);
+    if (file.size() == 0)
+        stream << "window,metric,timestamp_ms,duration_ms\n";
+    for (const auto &sample : samples)
+    {
+        stream << sourceName << ','
+               << getMetricName(sample.metric) << ','
+               << QString::number(toMilliseconds(sample.timestamp), 'f', 3) << ','
+               << QString::number(toMilliseconds(sample.duration), 'f', 3) << '\n';
+    }
+
+    stream.flush();
+    return file.error() == QFile::NoError;
+}
+
+QString QVRenderStats::getMetricName(Metric metric)
+{
+    switch (metric) {
+    case Metric::Paint:
+        return "paint";
+    case Metric::WheelLatency:
+        return "wheel_to_paint";
+    case Metric::KeyLatency:
+        return "key_to_paint";
+    case Metric::ResizeLatency:
+        return "resize_to_paint";
+    case Metric::FrameLateness:
+        return "frame_lateness";
+    }
+    return QString();
+}
@@ -0,0 +1,72 @@
+#ifndef QVRENDERSTATS_H
+#define QVRENDERSTATS_H
+
+#include <QElapsedTimer>
+#include <QVector>
+#include <QString>
+#include <QRect>
+#include <array>
+
+class QPainter;
+
+// Timings for QVGraphicsView, turned on by setting QV_RENDER_STATS in the environment.
+// Every sample goes into a histogram for the overlay and into a list that can be written out as CSV.
+class QVRenderStats
+{
+public:
+    enum class Metric
+    {
+        Paint,
+        WheelLatency,
+        KeyLatency,
+        ResizeLatency,
+        FrameLateness
+    };
+
+    QVRenderStats();
+
+    qint64 now() const { return clock.nsecsElapsed(); }
+
+    void addSample(Metric metric, qint64 nanoseconds);
+
+    // Draws in viewport coordinates at the top left
+    void drawOverlay(QPainter *painter);
+    const QRect &getOverlayRect() const { return overlayRect; }
+
+    // Adds this window's samples to the end of the file, which gets a header if it's new
+    bool exportCsv(const QString &filePath) const;
+
+    static QString getMetricName(Metric metric);
+
+private:
+    // Bucket i holds samples under 2^i ms, the last one everything slower
+    static const int BUCKET_COUNT = 10;
+    static const int METRIC_COUNT = 5;
+
+    // Enough for a long session without the list growing without bound
+    static const int MAX_SAMPLES = 200000;
+
+    struct Histogram
+    {
+        qint64 count = 0;
+        qint64 total = 0;
+        qint64 max = 0;
+        std::array<qint64, BUCKET_COUNT> buckets = {};
+    };
+
+    struct Sample
+    {
+        Metric metric;
+        qint64 timestamp;
+        qint64 duration;
+    };
+
+    QString sourceName;
+    QElapsedTimer clock;
+    std::array<Histogram, METRIC_COUNT> histograms;
+    QVector<Sample> samples;
+
+    QRect overlayRect;
+};
+
+#endif // QVRENDERSTATS_H
@@ -143,3 +143,24 @@ void QVWin32Functions::showOpenWithDialog(const QString &filePath, const QWindow
     if (!SUCCEEDED(SHOpenWithDialog(winId, &info)))
         qDebug() << "Failed launching open with dialog";
 }
+
+QByteArray QVWin32Functions::getDisplayIccProfile()
+{
+    // The profile assigned to the primary display, which Windows gives as a file path
+    HDC screenDc = GetDC(nullptr);
+    if (!screenDc)
+        return QByteArray();
+
+    WCHAR profilePath[MAX_PATH];
+    DWORD profilePathSize = MAX_PATH;
+    const bool success = GetICMProfileW(screenDc, &profilePathSize, profilePath);
+    ReleaseDC(nullptr, screenDc);
+    if (!success)
+        return QByteArray();
+
+    QFile profileFile(QString::fromWCharArray(profilePath));
+    if (!profileFile.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    return profileFile.readAll();
+}
@@ -14,6 +14,8 @@ public:
 
     static void showOpenWithDialog(const QString &filePath, const QWindow *parent);
 
+    static QByteArray getDisplayIccProfile();
+
 };
 
 #endif // QVWIN32FUNCTIONS_H
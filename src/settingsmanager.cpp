@@ -166,12 +166,14 @@ void SettingsManager::initializeSettingsLibrary()
     settingsLibrary.insert("cursorzoom", {true, {}});
     settingsLibrary.insert("cropmode", {0, {}});
     settingsLibrary.insert("pastactualsizeenabled", {true, {}});
+    settingsLibrary.insert("colormanagementenabled", {true, {}});
     // Miscellaneous
     settingsLibrary.insert("language", {"system", {}});
     settingsLibrary.insert("sortmode", {0, {}});
     settingsLibrary.insert("sortdescending", {false, {}});
     settingsLibrary.insert("preloadingmode", {1, {}});
     settingsLibrary.insert("loopfoldersenabled", {true, {}});
+    settingsLibrary.insert("recursivefoldersenabled", {false, {}});
     settingsLibrary.insert("slideshowreversed", {false, {}});
     settingsLibrary.insert("slideshowtimer", {5, {}});
     settingsLibrary.insert("afterdelete", {2, {}});
@@ -84,6 +84,7 @@ void ShortcutManager::initializeShortcutsList()
     shortcutsList.append({tr("Rotate Left"), "rotateleft", QStringList(QKeySequence(Qt::Key_Down).toString()), {}});
     shortcutsList.append({tr("Mirror"), "mirror", QStringList(QKeySequence(Qt::Key_F).toString()), {}});
     shortcutsList.append({tr("Flip"), "flip", QStringList(QKeySequence(Qt::CTRL | Qt::Key_F).toString()), {}});
+    shortcutsList.append({tr("Save Rotation"), "saverotation", QStringList(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_R).toString()), {}});
     shortcutsList.append({tr("Full Screen"), "fullscreen", keyBindingsToStringList(QKeySequence::FullScreen), {}});
     //Fixes alt+enter only working with numpad enter when using qt's standard keybinds
 #ifdef Q_OS_WIN
@@ -97,8 +98,10 @@ void ShortcutManager::initializeShortcutsList()
     }
 #endif
     shortcutsList.append({tr("Save Frame As"), "saveframeas", keyBindingsToStringList(QKeySequence::Save), {}});
+    shortcutsList.append({tr("Export Frames"), "exportframes", QStringList(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_E).toString()), {}});
     shortcutsList.append({tr("Pause"), "pause", QStringList(QKeySequence(Qt::Key_P).toString()), {}});
     shortcutsList.append({tr("Next Frame"), "nextframe", QStringList(QKeySequence(Qt::Key_N).toString()), {}});
+    shortcutsList.append({tr("Go to Frame"), "gotoframe", QStringList(QKeySequence(Qt::CTRL | Qt::Key_G).toString()), {}});
     shortcutsList.append({tr("Decrease Speed"), "decreasespeed", QStringList(QKeySequence(Qt::Key_BracketLeft).toString()), {}});
     shortcutsList.append({tr("Reset Speed"), "resetspeed", QStringList(QKeySequence(Qt::Key_Backslash).toString()), {}});
     shortcutsList.append({tr("Increase Speed"), "increasespeed", QStringList(QKeySequence(Qt::Key_BracketRight).toString()), {}});
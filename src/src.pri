@@ -3,13 +3,25 @@ SOURCES += \
     $$PWD/mainwindow.cpp \
     $$PWD/openwith.cpp \
     $$PWD/qvgraphicsview.cpp \
+    $$PWD/qvpixmapitem.cpp \
     $$PWD/qvoptionsdialog.cpp \
     $$PWD/qvapplication.cpp \
     $$PWD/qvaboutdialog.cpp \
     $$PWD/qvrenamedialog.cpp \
+    $$PWD/qvexportframesdialog.cpp \
     $$PWD/qvwelcomedialog.cpp \
     $$PWD/qvinfodialog.cpp \
     $$PWD/qvimagecore.cpp \
+    $$PWD/qvfolderindex.cpp \
+    $$PWD/qvfolderwalker.cpp \
+    $$PWD/qvarchive.cpp \
+    $$PWD/qvimagescaler.cpp \
+    $$PWD/qvcolormanager.cpp \
+    $$PWD/qvanimationplayer.cpp \
+    $$PWD/qvanimationindex.cpp \
+    $$PWD/qvframeexporter.cpp \
+    $$PWD/qvjpegtransform.cpp \
+    $$PWD/qvrenderstats.cpp \
     $$PWD/qvshortcutdialog.cpp \
     $$PWD/actionmanager.cpp \
     $$PWD/settingsmanager.cpp \
@@ -18,18 +30,31 @@ SOURCES += \
 
 macx:!CONFIG(NO_COCOA):SOURCES += $$PWD/qvcocoafunctions.mm
 win32:!CONFIG(NO_WIN32):SOURCES += $$PWD/qvwin32functions.cpp
+linux:!CONFIG(NO_LINUX):SOURCES += $$PWD/qvlinuxfunctions.cpp
 
 HEADERS += \
     $$PWD/mainwindow.h \
     $$PWD/openwith.h \
     $$PWD/qvgraphicsview.h \
+    $$PWD/qvpixmapitem.h \
     $$PWD/qvoptionsdialog.h \
     $$PWD/qvapplication.h \
     $$PWD/qvaboutdialog.h \
     $$PWD/qvrenamedialog.h \
+    $$PWD/qvexportframesdialog.h \
     $$PWD/qvwelcomedialog.h \
     $$PWD/qvinfodialog.h \
     $$PWD/qvimagecore.h \
+    $$PWD/qvfolderindex.h \
+    $$PWD/qvfolderwalker.h \
+    $$PWD/qvarchive.h \
+    $$PWD/qvimagescaler.h \
+    $$PWD/qvcolormanager.h \
+    $$PWD/qvanimationplayer.h \
+    $$PWD/qvanimationindex.h \
+    $$PWD/qvframeexporter.h \
+    $$PWD/qvjpegtransform.h \
+    $$PWD/qvrenderstats.h \
     $$PWD/qvshortcutdialog.h \
     $$PWD/actionmanager.h \
     $$PWD/settingsmanager.h \
@@ -38,6 +63,7 @@ HEADERS += \
 
 macx:!CONFIG(NO_COCOA):HEADERS += $$PWD/qvcocoafunctions.h
 win32:!CONFIG(NO_WIN32):HEADERS += $$PWD/qvwin32functions.h
+linux:!CONFIG(NO_LINUX):HEADERS += $$PWD/qvlinuxfunctions.h
 
 FORMS += \
         $$PWD/mainwindow.ui \
@@ -1,4 +1,4 @@
-QT += core testlib gui network widgets
+QT += core testlib gui network widgets concurrent
 
 macx:LIBS += -framework Cocoa
 
@@ -10,7 +10,30 @@ CONFIG -= app_bundle
 
 TEMPLATE = app
 
-SOURCES +=  tst_actionmanagertests.cpp
+SOURCES +=  tst_actionmanagertests.cpp \
+    tst_animationindextests.cpp \
+    tst_archivetests.cpp \
+    tst_colormanagerbenchmarks.cpp \
+    tst_folderscannerbenchmarks.cpp \
+    tst_imagescalerbenchmarks.cpp \
+    tst_jpegtransformtests.cpp
+
+HEADERS += tst_animationindextests.h \
+    tst_archivetests.h \
+    tst_colormanagerbenchmarks.h \
+    tst_folderscannerbenchmarks.h \
+    tst_imagescalerbenchmarks.h \
+    tst_jpegtransformtests.h
+
+linux:!CONFIG(NO_LINUX):DEFINES += LINUX_LOADED
+!win32:!CONFIG(NO_ZLIB) {
+    LIBS += -lz
+    DEFINES += ZLIB_LOADED
+}
+linux:!CONFIG(NO_LIBJPEG) {
+    LIBS += -ljpeg
+    DEFINES += LIBJPEG_LOADED
+}
 
 INCLUDEPATH += ../src
 include( ../src/src.pri )
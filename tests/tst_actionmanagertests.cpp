@@ -1,6 +1,12 @@
 #include <QtTest>
 
 #include "qvapplication.h"
+#include "tst_animationindextests.h"
+#include "tst_archivetests.h"
+#include "tst_colormanagerbenchmarks.h"
+#include "tst_folderscannerbenchmarks.h"
+#include "tst_imagescalerbenchmarks.h"
+#include "tst_jpegtransformtests.h"
 
 class ActionManagerTests : public QObject
 {
@@ -49,8 +55,30 @@ void ActionManagerTests::testClonedActionsUntracked()
 int main(int argc, char *argv[])
 {
     QVApplication app(argc, argv);
+    int status = 0;
+
     ActionManagerTests actionManagerTests;
-    return QTest::qExec(&actionManagerTests, argc, argv);
+    status |= QTest::qExec(&actionManagerTests, argc, argv);
+
+    AnimationIndexTests animationIndexTests;
+    status |= QTest::qExec(&animationIndexTests, argc, argv);
+
+    ArchiveTests archiveTests;
+    status |= QTest::qExec(&archiveTests, argc, argv);
+
+    ColorManagerBenchmarks colorManagerBenchmarks;
+    status |= QTest::qExec(&colorManagerBenchmarks, argc, argv);
+
+    FolderScannerBenchmarks folderScannerBenchmarks;
+    status |= QTest::qExec(&folderScannerBenchmarks, argc, argv);
+
+    ImageScalerBenchmarks imageScalerBenchmarks;
+    status |= QTest::qExec(&imageScalerBenchmarks, argc, argv);
+
+    JpegTransformTests jpegTransformTests;
+    status |= QTest::qExec(&jpegTransformTests, argc, argv);
+
+    return status;
 }
 
 #include "tst_actionmanagertests.moc"
@@ -0,0 +1,591 @@
+#include "tst_animationindextests.h"
+
+#include "qvanimationindex.h"
+
+#include <QtTest>
+#include <QtEndian>
+#include <QBuffer>
+#include <QImageReader>
+
+namespace
+{
+    const int CANVAS_SIZE = 4;
+
+    void appendLittleEndian16(QByteArray &bytes, int value)
+    {
+        bytes.append(static_cast<char>(value & 0xFF));
+        bytes.append(static_cast<char>((value >> 8) & 0xFF));
+    }
+
+    void appendLittleEndian(QByteArray &bytes, quint32 value, int byteCount)
+    {
+        for (int i = 0; i < byteCount; i++)
+            bytes.append(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+
+    void appendBigEndian32(QByteArray &bytes, quint32 value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            bytes.append(static_cast<char>((value >> shift) & 0xFF));
+    }
+
+    quint32 readBigEndian32(const QByteArray &bytes, int offset)
+    {
+        return qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(bytes.constData() + offset));
+    }
+
+    QList<QImage> decodeFrames(const QByteArray &data, const QByteArray &format)
+    {
+        QBuffer buffer;
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer, format);
+
+        QList<QImage> frames;
+        QImage frame;
+        while (reader.read(&frame))
+            frames.append(frame.convertToFormat(QImage::Format_ARGB32));
+        return frames;
+    }
+
+    // GIF
+
+    struct GifFrame
+    {
+        QRect rect;
+        int colorIndex;
+        int disposal;
+        bool hasTransparency;
+    };
+
+    // LZW that never grows past 3-bit codes: a clear code after every two pixels keeps the table from filling up
+    QByteArray encodeGifPixels(int pixelCount, int colorIndex)
+    {
+        const int clearCode = 4;
+        const int endCode = 5;
+
+        QVector<int> codes = {clearCode};
+        for (int i = 0; i < pixelCount; i++)
+        {
+            codes.append(colorIndex);
+            if (i % 2 == 1)
+                codes.append(clearCode);
+        }
+        codes.append(endCode);
+
+        QByteArray packed;
+        quint32 bits = 0;
+        int bitCount = 0;
+        for (const int code : codes)
+        {
+            bits |= static_cast<quint32>(code) << bitCount;
+            bitCount += 3;
+            while (bitCount >= 8)
+            {
+                packed.append(static_cast<char>(bits & 0xFF));
+                bits >>= 8;
+                bitCount -= 8;
+            }
+        }
+        if (bitCount > 0)
+            packed.append(static_cast<char>(bits & 0xFF));
+
+        QByteArray blocks;
+        blocks.append(static_cast<char>(2));
+        for (int i = 0; i < packed.size(); i += 255)
+        {
+            const QByteArray block = packed.mid(i, 255);
+            blocks.append(static_cast<char>(block.size()));
+            blocks.append(block);
+        }
+        blocks.append('\0');
+        return blocks;
+    }
+
+    QByteArray buildGif(const QVector<GifFrame> &frames)
+    {
+        QByteArray gif("GIF89a");
+        appendLittleEndian16(gif, CANVAS_SIZE);
+        appendLittleEndian16(gif, CANVAS_SIZE);
+        // A global table of four colors: black, red, green and blue
+        gif.append(static_cast<char>(0x81));
+        gif.append('\0');
+        gif.append('\0');
+        gif.append(QByteArray::fromHex("000000ff000000ff000000ff"));
+
+        for (const auto &frame : frames)
+        {
+            gif.append(QByteArray::fromHex("21f904"));
+            gif.append(static_cast<char>((frame.disposal << 2) | (frame.hasTransparency ? 1 : 0)));
+            appendLittleEndian16(gif, 10);
+            gif.append('\0');
+            gif.append('\0');
+
+            gif.append(static_cast<char>(0x2c));
+            appendLittleEndian16(gif, frame.rect.left());
+            appendLittleEndian16(gif, frame.rect.top());
+            appendLittleEndian16(gif, frame.rect.width());
+            appendLittleEndian16(gif, frame.rect.height());
+            gif.append('\0');
+            gif.append(encodeGifPixels(frame.rect.width() * frame.rect.height(), frame.colorIndex));
+        }
+
+        gif.append(static_cast<char>(0x3b));
+        return gif;
+    }
+
+    const QRect FULL_CANVAS(0, 0, CANVAS_SIZE, CANVAS_SIZE);
+
+    QVector<GifFrame> getGifFrames()
+    {
+        return {
+            {FULL_CANVAS, 1, 1, false},
+            {QRect(1, 1, 2, 2), 2, 1, false},
+            // Opaque over everything
+            {FULL_CANVAS, 3, 1, false},
+            // Lets what's underneath show through
+            {FULL_CANVAS, 1, 1, true},
+            // Puts back what was there before it
+            {FULL_CANVAS, 2, 3, false},
+            {FULL_CANVAS, 1, 2, false}
+        };
+    }
+
+    // WebP, only the container, the frames can't be decoded
+
+    struct WebPFrame
+    {
+        QRect rect;
+        bool isBlended;
+        bool isLossless;
+        bool hasAlpha;
+    };
+
+    void appendRiffChunk(QByteArray &riff, const QByteArray &fourCc, const QByteArray &chunkData)
+    {
+        riff.append(fourCc);
+        appendLittleEndian(riff, static_cast<quint32>(chunkData.size()), 4);
+        riff.append(chunkData);
+        if (chunkData.size() % 2 == 1)
+            riff.append('\0');
+    }
+
+    QByteArray buildWebP(const QVector<WebPFrame> &frames)
+    {
+        QByteArray chunks("WEBP");
+
+        QByteArray vp8x;
+        vp8x.append(static_cast<char>(0x12));
+        appendLittleEndian(vp8x, 0, 3);
+        appendLittleEndian(vp8x, CANVAS_SIZE - 1, 3);
+        appendLittleEndian(vp8x, CANVAS_SIZE - 1, 3);
+        appendRiffChunk(chunks, "VP8X", vp8x);
+        appendRiffChunk(chunks, "ANIM", QByteArray(6, '\0'));
+
+        for (const auto &frame : frames)
+        {
+            QByteArray anmf;
+            appendLittleEndian(anmf, static_cast<quint32>(frame.rect.left() / 2), 3);
+            appendLittleEndian(anmf, static_cast<quint32>(frame.rect.top() / 2), 3);
+            appendLittleEndian(anmf, static_cast<quint32>(frame.rect.width() - 1), 3);
+            appendLittleEndian(anmf, static_cast<quint32>(frame.rect.height() - 1), 3);
+            appendLittleEndian(anmf, 10, 3);
+            anmf.append(static_cast<char>(frame.isBlended ? 0x00 : 0x02));
+
+            // Just enough of the bitstream header for the alpha bit
+            QByteArray bitstream;
+            if (frame.isLossless)
+            {
+                bitstream.append(static_cast<char>(0x2f));
+                appendLittleEndian(bitstream, frame.hasAlpha ? 1u << 28 : 0u, 4);
+                appendRiffChunk(anmf, "VP8L", bitstream);
+            }
+            else
+            {
+                bitstream = QByteArray(10, '\0');
+                if (frame.hasAlpha)
+                    appendRiffChunk(anmf, "ALPH", QByteArray(2, '\0'));
+                appendRiffChunk(anmf, "VP8 ", bitstream);
+            }
+
+            appendRiffChunk(chunks, "ANMF", anmf);
+        }
+
+        QByteArray webp("RIFF");
+        appendLittleEndian(webp, static_cast<quint32>(chunks.size()), 4);
+        webp.append(chunks);
+        return webp;
+    }
+
+    QVector<WebPFrame> getWebPFrames()
+    {
+        return {
+            {FULL_CANVAS, true, true, true},
+            {QRect(2, 2, 2, 2), false, true, false},
+            // Replaces everything without blending
+            {FULL_CANVAS, false, true, true},
+            // Blended, but nothing in it is see-through
+            {FULL_CANVAS, true, true, false},
+            // Blended with alpha, lossy and lossless
+            {FULL_CANVAS, true, false, true},
+            {FULL_CANVAS, true, true, true},
+            {FULL_CANVAS, true, false, false}
+        };
+    }
+
+    // APNG
+
+    struct ApngFrame
+    {
+        QRect rect;
+        QRgb color;
+        int disposeOp;
+        int blendOp;
+    };
+
+    quint32 getPngCrc(const QByteArray &typeAndData)
+    {
+        quint32 crc = 0xFFFFFFFF;
+        for (const char byte : typeAndData)
+        {
+            crc ^= static_cast<uchar>(byte);
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+        return ~crc;
+    }
+
+    void appendPngChunk(QByteArray &png, const QByteArray &type, const QByteArray &chunkData)
+    {
+        appendBigEndian32(png, static_cast<quint32>(chunkData.size()));
+        png.append(type);
+        png.append(chunkData);
+        appendBigEndian32(png, getPngCrc(type + chunkData));
+    }
+
+    // Unfiltered RGBA rows, and qCompress is a zlib stream after its 4-byte length
+    QByteArray compressPixels(const QSize &size, QRgb color)
+    {
+        QByteArray rows;
+        for (int y = 0; y < size.height(); y++)
+        {
+            rows.append('\0');
+            for (int x = 0; x < size.width(); x++)
+            {
+                rows.append(static_cast<char>(qRed(color)));
+                rows.append(static_cast<char>(qGreen(color)));
+                rows.append(static_cast<char>(qBlue(color)));
+                rows.append(static_cast<char>(qAlpha(color)));
+            }
+        }
+        return qCompress(rows).mid(4);
+    }
+
+    QByteArray buildApng(const QVector<ApngFrame> &frames, bool hasHiddenDefaultImage = false)
+    {
+        QByteArray png("\x89PNG\r\n\x1a\n");
+
+        QByteArray header;
+        appendBigEndian32(header, CANVAS_SIZE);
+        appendBigEndian32(header, CANVAS_SIZE);
+        header.append(QByteArray::fromHex("0806000000"));
+        appendPngChunk(png, "IHDR", header);
+
+        QByteArray animationControl;
+        appendBigEndian32(animationControl, static_cast<quint32>(frames.length()));
+        appendBigEndian32(animationControl, 0);
+        appendPngChunk(png, "acTL", animationControl);
+
+        if (hasHiddenDefaultImage)
+            appendPngChunk(png, "IDAT", compressPixels(FULL_CANVAS.size(), qRgba(255, 255, 255, 255)));
+
+        quint32 sequenceNumber = 0;
+        for (int i = 0; i < frames.length(); i++)
+        {
+            const auto &frame = frames.at(i);
+            QByteArray frameControl;
+            appendBigEndian32(frameControl, sequenceNumber++);
+            appendBigEndian32(frameControl, static_cast<quint32>(frame.rect.width()));
+            appendBigEndian32(frameControl, static_cast<quint32>(frame.rect.height()));
+            appendBigEndian32(frameControl, static_cast<quint32>(frame.rect.left()));
+            appendBigEndian32(frameControl, static_cast<quint32>(frame.rect.top()));
+            frameControl.append(QByteArray::fromHex("0001000a"));
+            frameControl.append(static_cast<char>(frame.disposeOp));
+            frameControl.append(static_cast<char>(frame.blendOp));
+            appendPngChunk(png, "fcTL", frameControl);
+
+            // Split in two, so frames with more than one data chunk are covered
+            const QByteArray pixels = compressPixels(frame.rect.size(), frame.color);
+            const QByteArray parts[2] = {pixels.left(pixels.size() / 2), pixels.mid(pixels.size() / 2)};
+            for (const auto &part : parts)
+            {
+                if (i == 0 && !hasHiddenDefaultImage)
+                {
+                    appendPngChunk(png, "IDAT", part);
+                }
+                else
+                {
+                    QByteArray frameData;
+                    appendBigEndian32(frameData, sequenceNumber++);
+                    appendPngChunk(png, "fdAT", frameData + part);
+                }
+            }
+        }
+
+        appendPngChunk(png, "tEXt", QByteArray("Comment\0kept", 12));
+        appendPngChunk(png, "IEND", QByteArray());
+        return png;
+    }
+
+    QVector<ApngFrame> getApngFrames()
+    {
+        return {
+            {FULL_CANVAS, qRgba(255, 0, 0, 255), 0, 0},
+            {QRect(1, 1, 2, 2), qRgba(0, 255, 0, 255), 1, 1},
+            // RGBA blended over what's there, which could show through
+            {FULL_CANVAS, qRgba(0, 0, 255, 128), 0, 1},
+            // Replaces everything
+            {FULL_CANVAS, qRgba(0, 255, 0, 128), 0, 0},
+            // Puts back what was there before it
+            {FULL_CANVAS, qRgba(255, 0, 0, 255), 2, 0},
+            {FULL_CANVAS, qRgba(0, 0, 255, 255), 1, 0}
+        };
+    }
+
+    // Walks a stream the way a strict decoder would and checks it against the frames it should hold
+    void verifyApngStream(const QByteArray &stream, int expectedFrameCount)
+    {
+        QVERIFY(stream.startsWith("\x89PNG\r\n\x1a\n"));
+
+        int position = 8;
+        quint32 expectedSequenceNumber = 0;
+        int frameControlCount = 0;
+        bool hasImageData = false;
+        QByteArray lastType;
+        while (position < stream.size())
+        {
+            QVERIFY(position + 12 <= stream.size());
+            const int chunkLength = static_cast<int>(readBigEndian32(stream, position));
+            QVERIFY(position + 12 + chunkLength <= stream.size());
+            const QByteArray type = stream.mid(position + 4, 4);
+            const QByteArray chunkData = stream.mid(position + 8, chunkLength);
+            QCOMPARE(readBigEndian32(stream, position + 8 + chunkLength), getPngCrc(type + chunkData));
+
+            if (type == "acTL")
+            {
+                QCOMPARE(static_cast<int>(readBigEndian32(chunkData, 0)), expectedFrameCount);
+            }
+            else if (type == "fcTL" || type == "fdAT")
+            {
+                QCOMPARE(readBigEndian32(chunkData, 0), expectedSequenceNumber);
+                expectedSequenceNumber++;
+                if (type == "fcTL")
+                    frameControlCount++;
+                else
+                    QVERIFY(hasImageData);
+            }
+            else if (type == "IDAT")
+            {
+                // The only image data is the first frame's
+                QCOMPARE(frameControlCount, 1);
+                hasImageData = true;
+            }
+
+            lastType = type;
+            position += 12 + chunkLength;
+        }
+
+        QVERIFY(hasImageData);
+        QCOMPARE(frameControlCount, expectedFrameCount);
+        QCOMPARE(lastType, QByteArray("IEND"));
+    }
+
+    bool isApngReadable()
+    {
+        return QImageReader::supportedImageFormats().contains("apng");
+    }
+
+    // Only has to get through without reading past the data, whatever it finds
+    void buildAndStreamAll(const QByteArray &data)
+    {
+        const QVAnimationIndex index = QVAnimationIndex::build(data);
+        for (int i = 0; i < index.frameCount(); i++)
+            QVERIFY(index.getStreamFrom(data, index.getKeyframe(i)).size() <= data.size());
+    }
+}
+
+void AnimationIndexTests::testGifKeyframes()
+{
+    const QVAnimationIndex index = QVAnimationIndex::build(buildGif(getGifFrames()));
+    QCOMPARE(index.frameCount(), 6);
+
+    const QVector<int> expected = {0, 0, 2, 2, 2, 5};
+    for (int i = 0; i < expected.length(); i++)
+        QCOMPARE(index.getKeyframe(i), expected.at(i));
+}
+
+void AnimationIndexTests::testGifStreamFrom()
+{
+    const QByteArray gif = buildGif(getGifFrames());
+    const QVAnimationIndex index = QVAnimationIndex::build(gif);
+    QCOMPARE(index.getStreamFrom(gif, 0), gif);
+
+    const QList<QImage> frames = decodeFrames(gif, "gif");
+    QCOMPARE(frames.length(), 6);
+
+    const QList<int> keyframes = {2, 5};
+    for (const int keyframe : keyframes)
+    {
+        const QByteArray stream = index.getStreamFrom(gif, keyframe);
+        QCOMPARE(QVAnimationIndex::build(stream).frameCount(), 6 - keyframe);
+        QCOMPARE(decodeFrames(stream, "gif"), frames.mid(keyframe));
+    }
+}
+
+void AnimationIndexTests::testWebPKeyframes()
+{
+    const QVAnimationIndex index = QVAnimationIndex::build(buildWebP(getWebPFrames()));
+    QCOMPARE(index.frameCount(), 7);
+
+    const QVector<int> expected = {0, 0, 2, 3, 3, 3, 6};
+    for (int i = 0; i < expected.length(); i++)
+        QCOMPARE(index.getKeyframe(i), expected.at(i));
+}
+
+void AnimationIndexTests::testWebPStreamFrom()
+{
+    const QVector<WebPFrame> frames = getWebPFrames();
+    const QByteArray webp = buildWebP(frames);
+    const QVAnimationIndex index = QVAnimationIndex::build(webp);
+    QCOMPARE(index.getStreamFrom(webp, 0), webp);
+
+    // The stream has to be what a file with only the later frames would have been, RIFF size included
+    const int keyframe = 3;
+    QCOMPARE(index.getStreamFrom(webp, keyframe), buildWebP(frames.mid(keyframe)));
+}
+
+void AnimationIndexTests::testApngKeyframes()
+{
+    const QVAnimationIndex index = QVAnimationIndex::build(buildApng(getApngFrames()));
+    QCOMPARE(index.frameCount(), 6);
+
+    const QVector<int> expected = {0, 0, 0, 3, 3, 5};
+    for (int i = 0; i < expected.length(); i++)
+        QCOMPARE(index.getKeyframe(i), expected.at(i));
+}
+
+void AnimationIndexTests::testApngStreamFrom()
+{
+    const QByteArray apng = buildApng(getApngFrames());
+    const QVAnimationIndex index = QVAnimationIndex::build(apng);
+    QCOMPARE(index.getStreamFrom(apng, 0), apng);
+
+    const QList<int> keyframes = {3, 5};
+    for (const int keyframe : keyframes)
+    {
+        const QByteArray stream = index.getStreamFrom(apng, keyframe);
+        verifyApngStream(stream, 6 - keyframe);
+        QCOMPARE(QVAnimationIndex::build(stream).frameCount(), 6 - keyframe);
+    }
+
+    if (!isApngReadable())
+        QSKIP("No APNG image format plugin to decode the streams with");
+
+    const QList<QImage> frames = decodeFrames(apng, "apng");
+    QCOMPARE(frames.length(), 6);
+    for (const int keyframe : keyframes)
+        QCOMPARE(decodeFrames(index.getStreamFrom(apng, keyframe), "apng"), frames.mid(keyframe));
+}
+
+void AnimationIndexTests::testApngHiddenDefaultImage()
+{
+    // The default image isn't a frame here, so the stream drops it and the keyframe's data becomes the image
+    const QByteArray apng = buildApng(getApngFrames(), true);
+    const QVAnimationIndex index = QVAnimationIndex::build(apng);
+    QCOMPARE(index.frameCount(), 6);
+    QCOMPARE(index.getKeyframe(4), 3);
+
+    verifyApngStream(index.getStreamFrom(apng, 3), 3);
+}
+
+void AnimationIndexTests::testStillImage()
+{
+    QImage image(CANVAS_SIZE, CANVAS_SIZE, QImage::Format_ARGB32);
+    image.fill(Qt::red);
+
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    QVERIFY(image.save(&buffer, "png"));
+
+    QVERIFY(QVAnimationIndex::build(png).isEmpty());
+    QVERIFY(QVAnimationIndex::build(QByteArray("GIF89a")).isEmpty());
+    QVERIFY(QVAnimationIndex::build(QByteArray()).isEmpty());
+}
+
+void AnimationIndexTests::testTruncated()
+{
+    const QList<QByteArray> animations = {buildGif(getGifFrames()), buildWebP(getWebPFrames()), buildApng(getApngFrames())};
+    for (const auto &animation : animations)
+    {
+        for (int length = 0; length < animation.size(); length++)
+            buildAndStreamAll(animation.left(length));
+    }
+}
+
+void AnimationIndexTests::testOversizedChunkLength()
+{
+    // Lengths that wrap around when added to an offset
+    const QList<quint32> lengths = {0x7FFFFFF8, 0x7FFFFFFF, 0x80000000, 0xFFFFFFF0};
+
+    const QByteArray apng = buildApng(getApngFrames());
+    // The length comes before the type
+    const int textOffset = apng.indexOf("tEXt") - 4;
+    for (const quint32 length : lengths)
+    {
+        // Every chunk, the header's and the frames' included
+        for (int offset = 8; offset + 12 <= apng.size(); offset += 12 + static_cast<int>(readBigEndian32(apng, offset)))
+        {
+            QByteArray corrupted = apng;
+            qToBigEndian<quint32>(length, corrupted.data() + offset);
+            buildAndStreamAll(corrupted);
+        }
+
+        // After the last frame, so the index is complete and the stream has to stop at the bad chunk
+        QByteArray corrupted = apng;
+        qToBigEndian<quint32>(length, corrupted.data() + textOffset);
+        const QVAnimationIndex index = QVAnimationIndex::build(corrupted);
+        QCOMPARE(index.frameCount(), 6);
+        QVERIFY(!index.getStreamFrom(corrupted, 3).contains("IEND"));
+    }
+
+    const QByteArray webp = buildWebP(getWebPFrames());
+    for (const quint32 length : lengths)
+    {
+        for (int offset = webp.indexOf("ANMF"); offset >= 0; offset = webp.indexOf("ANMF", offset + 4))
+        {
+            QByteArray corrupted = webp;
+            qToLittleEndian<quint32>(length, corrupted.data() + offset + 4);
+            buildAndStreamAll(corrupted);
+        }
+
+        // The last frame is dropped, not read past the end
+        QByteArray corrupted = webp;
+        qToLittleEndian<quint32>(length, corrupted.data() + webp.lastIndexOf("ANMF") + 4);
+        QCOMPARE(QVAnimationIndex::build(corrupted).frameCount(), 6);
+    }
+}
+
+void AnimationIndexTests::testApngTrailingBytes()
+{
+    // Whatever follows IEND was never checked, so it's left out of the stream
+    const QByteArray apng = buildApng(getApngFrames());
+    QByteArray trailing = apng;
+    appendBigEndian32(trailing, 0x7FFFFFF8);
+    trailing.append("junk");
+
+    const QVAnimationIndex index = QVAnimationIndex::build(trailing);
+    QCOMPARE(index.frameCount(), 6);
+    QCOMPARE(index.getStreamFrom(trailing, 3), index.getStreamFrom(apng, 3));
+    verifyApngStream(index.getStreamFrom(trailing, 3), 3);
+}
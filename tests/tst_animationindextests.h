@@ -0,0 +1,30 @@
+#ifndef TST_ANIMATIONINDEXTESTS_H
+#define TST_ANIMATIONINDEXTESTS_H
+
+#include <QObject>
+
+// Builds small GIF, WebP and APNG animations by hand, so each kind of frame that can or can't start a stream is
+// there on purpose, and checks the keyframes found and the streams cut from them
+class AnimationIndexTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testGifKeyframes();
+    void testGifStreamFrom();
+
+    void testWebPKeyframes();
+    void testWebPStreamFrom();
+
+    void testApngKeyframes();
+    void testApngStreamFrom();
+    void testApngHiddenDefaultImage();
+
+    void testStillImage();
+
+    void testTruncated();
+    void testOversizedChunkLength();
+    void testApngTrailingBytes();
+};
+
+#endif // TST_ANIMATIONINDEXTESTS_H
@@ -0,0 +1,344 @@
+#include "tst_archivetests.h"
+
+#include "qvarchive.h"
+
+#include <QtTest>
+#include <QtEndian>
+#include <limits>
+
+#ifdef ZLIB_LOADED
+#include <zlib.h>
+#endif
+
+namespace
+{
+    struct ZipEntry
+    {
+        QByteArray name;
+        QByteArray data;
+        bool deflate;
+
+        // Written to the central directory instead of the real values when not -1, to corrupt the archive
+        qint64 headerOffsetOverride;
+        qint64 compressedSizeOverride;
+        qint64 uncompressedSizeOverride;
+        qint64 crcOverride;
+    };
+
+    ZipEntry makeEntry(const QByteArray &name, const QByteArray &data, bool deflate = false)
+    {
+        return {name, data, deflate, -1, -1, -1, -1};
+    }
+
+    QByteArray makeImageData(int size)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        for (int i = 0; i < size; i++)
+            data[i] = static_cast<char>((i * 7 + i / 100) & 0xFF);
+        return data;
+    }
+
+    // Bitwise CRC-32, so building archives doesn't need zlib
+    quint32 getCrc32(const QByteArray &data)
+    {
+        quint32 crc = 0xFFFFFFFF;
+        for (const char byte : data)
+        {
+            crc ^= static_cast<uchar>(byte);
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+        return ~crc;
+    }
+
+#ifdef ZLIB_LOADED
+    QByteArray deflateRaw(const QByteArray &data)
+    {
+        z_stream stream = {};
+        deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        QByteArray output(static_cast<int>(deflateBound(&stream, static_cast<uLong>(data.size()))), Qt::Uninitialized);
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef *>(output.data());
+        stream.avail_out = static_cast<uInt>(output.size());
+        deflate(&stream, Z_FINISH);
+        output.resize(static_cast<int>(stream.total_out));
+        deflateEnd(&stream);
+        return output;
+    }
+#endif
+
+    void append16(QByteArray &out, quint64 value)
+    {
+        char bytes[2];
+        qToLittleEndian(static_cast<quint16>(value), bytes);
+        out.append(bytes, 2);
+    }
+
+    void append32(QByteArray &out, quint64 value)
+    {
+        char bytes[4];
+        qToLittleEndian(static_cast<quint32>(value), bytes);
+        out.append(bytes, 4);
+    }
+
+    void append64(QByteArray &out, quint64 value)
+    {
+        char bytes[8];
+        qToLittleEndian(value, bytes);
+        out.append(bytes, 8);
+    }
+
+    qint64 pick(qint64 override, qint64 value)
+    {
+        return override != -1 ? override : value;
+    }
+
+    // With zip64, every size and offset is moved into the ZIP64 extra field and end of central directory record
+    QByteArray buildZip(const QList<ZipEntry> &entries, bool zip64 = false)
+    {
+        QByteArray zip;
+        QByteArray centralDirectory;
+        for (const ZipEntry &entry : entries)
+        {
+            QByteArray payload = entry.data;
+            quint16 method = 0;
+#ifdef ZLIB_LOADED
+            if (entry.deflate)
+            {
+                payload = deflateRaw(entry.data);
+                method = 8;
+            }
+#endif
+            const quint32 crc = getCrc32(entry.data);
+            const qint64 headerOffset = zip.size();
+
+            append32(zip, 0x04034b50);
+            append16(zip, 20);
+            append16(zip, 0x0800);
+            append16(zip, method);
+            append16(zip, 0);
+            append16(zip, 0x21);
+            append32(zip, crc);
+            append32(zip, static_cast<quint64>(payload.size()));
+            append32(zip, static_cast<quint64>(entry.data.size()));
+            append16(zip, static_cast<quint64>(entry.name.size()));
+            append16(zip, 0);
+            zip.append(entry.name);
+            zip.append(payload);
+
+            const qint64 compressedSize = pick(entry.compressedSizeOverride, payload.size());
+            const qint64 uncompressedSize = pick(entry.uncompressedSizeOverride, entry.data.size());
+            const qint64 centralHeaderOffset = pick(entry.headerOffsetOverride, headerOffset);
+
+            append32(centralDirectory, 0x02014b50);
+            append16(centralDirectory, zip64 ? 45 : 20);
+            append16(centralDirectory, zip64 ? 45 : 20);
+            append16(centralDirectory, 0x0800);
+            append16(centralDirectory, method);
+            append16(centralDirectory, 0);
+            append16(centralDirectory, 0x21);
+            append32(centralDirectory, static_cast<quint64>(pick(entry.crcOverride, crc)));
+            append32(centralDirectory, zip64 ? 0xFFFFFFFF : static_cast<quint64>(compressedSize));
+            append32(centralDirectory, zip64 ? 0xFFFFFFFF : static_cast<quint64>(uncompressedSize));
+            append16(centralDirectory, static_cast<quint64>(entry.name.size()));
+            append16(centralDirectory, zip64 ? 28 : 0);
+            append16(centralDirectory, 0);
+            append16(centralDirectory, 0);
+            append16(centralDirectory, 0);
+            append32(centralDirectory, 0);
+            append32(centralDirectory, zip64 ? 0xFFFFFFFF : static_cast<quint64>(centralHeaderOffset));
+            centralDirectory.append(entry.name);
+            if (zip64)
+            {
+                append16(centralDirectory, 0x0001);
+                append16(centralDirectory, 24);
+                append64(centralDirectory, static_cast<quint64>(uncompressedSize));
+                append64(centralDirectory, static_cast<quint64>(compressedSize));
+                append64(centralDirectory, static_cast<quint64>(centralHeaderOffset));
+            }
+        }
+
+        const qint64 centralDirectoryOffset = zip.size();
+        zip.append(centralDirectory);
+
+        if (zip64)
+        {
+            const qint64 zip64RecordOffset = zip.size();
+            append32(zip, 0x06064b50);
+            append64(zip, 44);
+            append16(zip, 45);
+            append16(zip, 45);
+            append32(zip, 0);
+            append32(zip, 0);
+            append64(zip, static_cast<quint64>(entries.size()));
+            append64(zip, static_cast<quint64>(entries.size()));
+            append64(zip, static_cast<quint64>(centralDirectory.size()));
+            append64(zip, static_cast<quint64>(centralDirectoryOffset));
+
+            append32(zip, 0x07064b50);
+            append32(zip, 0);
+            append64(zip, static_cast<quint64>(zip64RecordOffset));
+            append32(zip, 1);
+        }
+
+        append32(zip, 0x06054b50);
+        append16(zip, 0);
+        append16(zip, 0);
+        append16(zip, zip64 ? 0xFFFF : static_cast<quint64>(entries.size()));
+        append16(zip, zip64 ? 0xFFFF : static_cast<quint64>(entries.size()));
+        append32(zip, zip64 ? 0xFFFFFFFF : static_cast<quint64>(centralDirectory.size()));
+        append32(zip, zip64 ? 0xFFFFFFFF : static_cast<quint64>(centralDirectoryOffset));
+        append16(zip, 0);
+        return zip;
+    }
+}
+
+void ArchiveTests::initTestCase()
+{
+    QVERIFY(dir.isValid());
+}
+
+QString ArchiveTests::writeArchive(const QString &name, const QByteArray &data)
+{
+    const QString path = dir.filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+        return QString();
+    return path;
+}
+
+void ArchiveTests::testStoredEntry()
+{
+    const QByteArray data = makeImageData(5000);
+    const QString path = writeArchive("stored.cbz", buildZip({makeEntry("a.jpg", data), makeEntry("folder/b.png", "b")}));
+
+    const auto archive = QVArchive::open(path);
+    QVERIFY(archive);
+    QCOMPARE(archive->getEntries().length(), 2);
+    QCOMPARE(archive->readEntry("a.jpg"), data);
+    QCOMPARE(archive->readEntry("folder/b.png"), QByteArray("b"));
+    QVERIFY(archive->readEntry("missing.jpg").isEmpty());
+}
+
+void ArchiveTests::testDeflatedEntry()
+{
+#ifdef ZLIB_LOADED
+    const QByteArray data = makeImageData(3 * 1024 * 1024);
+    const QString path = writeArchive("deflated.zip", buildZip({makeEntry("big.jpg", data, true), makeEntry("empty.jpg", QByteArray(), true)}));
+
+    const auto archive = QVArchive::open(path);
+    QVERIFY(archive);
+    QCOMPARE(archive->readEntry("big.jpg"), data);
+    QCOMPARE(archive->readEntry("empty.jpg"), QByteArray());
+    QCOMPARE(archive->getEntries().at(archive->indexOf("big.jpg")).method, quint16(8));
+#else
+    QSKIP("Built without zlib");
+#endif
+}
+
+void ArchiveTests::testZip64()
+{
+    const QByteArray data = makeImageData(70000);
+    const QString path = writeArchive("zip64.zip", buildZip({makeEntry("a.jpg", data), makeEntry("b.jpg", "second")}, true));
+
+    const auto archive = QVArchive::open(path);
+    QVERIFY(archive);
+    QCOMPARE(archive->getEntries().length(), 2);
+    QCOMPARE(archive->getEntries().at(0).uncompressedSize, qint64(data.size()));
+    QCOMPARE(archive->readEntry("a.jpg"), data);
+    QCOMPARE(archive->readEntry("b.jpg"), QByteArray("second"));
+}
+
+void ArchiveTests::testTruncatedEndOfCentralDirectory()
+{
+    const QByteArray zip = buildZip({makeEntry("a.jpg", makeImageData(100))});
+
+    QVERIFY(!QVArchive::open(writeArchive("truncated-eocd.zip", zip.left(zip.size() - 10))));
+    QVERIFY(!QVArchive::open(writeArchive("tiny.zip", zip.right(10))));
+    QVERIFY(!QVArchive::open(writeArchive("empty.zip", QByteArray())));
+}
+
+void ArchiveTests::testCentralDirectoryOutOfRange()
+{
+    // The central directory offset is the second to last field of the end record
+    QByteArray zip = buildZip({makeEntry("a.jpg", makeImageData(100))});
+    qToLittleEndian<quint32>(0xFFFFFF00, zip.data() + zip.size() - 6);
+    QVERIFY(!QVArchive::open(writeArchive("bad-directory.zip", zip)));
+
+    // A ZIP64 record whose offset and size add up past the 64-bit range
+    QByteArray zip64 = buildZip({makeEntry("a.jpg", makeImageData(100))}, true);
+    const int recordOffset = zip64.size() - 22 - 20 - 56;
+    qToLittleEndian<quint64>(std::numeric_limits<qint64>::max() - 4, zip64.data() + recordOffset + 40);
+    qToLittleEndian<quint64>(64, zip64.data() + recordOffset + 48);
+    QVERIFY(!QVArchive::open(writeArchive("bad-directory64.zip", zip64)));
+}
+
+void ArchiveTests::testBadHeaderOffsets()
+{
+    ZipEntry pastEnd = makeEntry("past-end.jpg", makeImageData(100));
+    pastEnd.headerOffsetOverride = 1000000;
+    ZipEntry overflowing = makeEntry("overflowing.jpg", makeImageData(100));
+    overflowing.headerOffsetOverride = std::numeric_limits<qint64>::max() - 10;
+    ZipEntry negative = makeEntry("negative.jpg", makeImageData(100));
+    negative.headerOffsetOverride = std::numeric_limits<qint64>::min();
+    ZipEntry notAHeader = makeEntry("not-a-header.jpg", makeImageData(100));
+    notAHeader.headerOffsetOverride = 5;
+
+    const auto archive = QVArchive::open(writeArchive("bad-offsets.zip", buildZip({pastEnd, overflowing, negative, notAHeader}, true)));
+    QVERIFY(archive);
+    QCOMPARE(archive->getEntries().length(), 4);
+    QVERIFY(archive->readEntry("past-end.jpg").isEmpty());
+    QVERIFY(archive->readEntry("overflowing.jpg").isEmpty());
+    QVERIFY(archive->readEntry("negative.jpg").isEmpty());
+    QVERIFY(archive->readEntry("not-a-header.jpg").isEmpty());
+}
+
+void ArchiveTests::testDataPastEndOfFile()
+{
+    ZipEntry tooLong = makeEntry("too-long.jpg", makeImageData(100));
+    tooLong.compressedSizeOverride = 100000;
+    tooLong.uncompressedSizeOverride = 100000;
+    ZipEntry overflowing = makeEntry("overflowing.jpg", makeImageData(100));
+    overflowing.compressedSizeOverride = std::numeric_limits<qint64>::max();
+
+    const auto archive = QVArchive::open(writeArchive("data-past-end.zip", buildZip({tooLong, overflowing}, true)));
+    QVERIFY(archive);
+    QVERIFY(archive->readEntry("too-long.jpg").isEmpty());
+    QVERIFY(archive->readEntry("overflowing.jpg").isEmpty());
+}
+
+void ArchiveTests::testStoredCrcMismatch()
+{
+    ZipEntry corrupt = makeEntry("corrupt.jpg", makeImageData(100));
+    corrupt.crcOverride = 0x12345678;
+
+    const auto archive = QVArchive::open(writeArchive("crc.zip", buildZip({corrupt})));
+    QVERIFY(archive);
+#ifdef ZLIB_LOADED
+    QVERIFY(archive->readEntry("corrupt.jpg").isEmpty());
+#else
+    QSKIP("Built without zlib, which provides the CRC-32");
+#endif
+}
+
+void ArchiveTests::testImplausibleUncompressedSize()
+{
+#ifdef ZLIB_LOADED
+    // A few bytes that claim to inflate to nearly 2 GiB must be turned away before anything is allocated
+    ZipEntry bomb = makeEntry("bomb.jpg", "tiny", true);
+    bomb.uncompressedSizeOverride = std::numeric_limits<int>::max() - 1;
+    ZipEntry shorter = makeEntry("shorter.jpg", makeImageData(5000), true);
+    shorter.uncompressedSizeOverride = 4000;
+    ZipEntry longer = makeEntry("longer.jpg", makeImageData(5000), true);
+    longer.uncompressedSizeOverride = 6000;
+
+    const auto archive = QVArchive::open(writeArchive("sizes.zip", buildZip({bomb, shorter, longer})));
+    QVERIFY(archive);
+    QVERIFY(archive->readEntry("bomb.jpg").isEmpty());
+    QVERIFY(archive->readEntry("shorter.jpg").isEmpty());
+    QVERIFY(archive->readEntry("longer.jpg").isEmpty());
+#else
+    QSKIP("Built without zlib");
+#endif
+}
@@ -0,0 +1,33 @@
+#ifndef TST_ARCHIVETESTS_H
+#define TST_ARCHIVETESTS_H
+
+#include <QObject>
+#include <QTemporaryDir>
+
+// QVArchive reads untrusted files, so besides well-formed archives these build
+// deliberately broken ones and check that they are turned away instead of read out of bounds
+class ArchiveTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testStoredEntry();
+    void testDeflatedEntry();
+    void testZip64();
+
+    void testTruncatedEndOfCentralDirectory();
+    void testCentralDirectoryOutOfRange();
+    void testBadHeaderOffsets();
+    void testDataPastEndOfFile();
+    void testStoredCrcMismatch();
+    void testImplausibleUncompressedSize();
+
+private:
+    QString writeArchive(const QString &name, const QByteArray &data);
+
+    QTemporaryDir dir;
+};
+
+#endif // TST_ARCHIVETESTS_H
@@ -0,0 +1,158 @@
+#include "tst_colormanagerbenchmarks.h"
+
+#include "qvcolormanager.h"
+
+#include <QtTest>
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+#include <QColorSpace>
+#endif
+
+Q_DECLARE_METATYPE(QVImageScaler::InstructionSet)
+Q_DECLARE_METATYPE(QImage::Format)
+
+namespace
+{
+    const QSize SOURCE_SIZE(4000, 3000);
+
+    // Noise reaches every cell of the table and every order of fractions inside one, a ramp along the
+    // top row adds the edges of the cube, and some of the pixels are see-through or fully transparent.
+    // ProPhoto is wide enough that no display is likely to match it
+    QImage createTestImage()
+    {
+        QImage image(SOURCE_SIZE, QImage::Format_ARGB32);
+        // xorshift, seeded the same every run
+        quint32 state = 39;
+        for (int y = 0; y < image.height(); y++)
+        {
+            auto *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < image.width(); x++)
+            {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                QRgb pixel = state;
+                if (pixel % 4 != 0)
+                    pixel |= 0xff000000;
+                line[x] = pixel;
+            }
+        }
+
+        auto *firstLine = reinterpret_cast<QRgb *>(image.scanLine(0));
+        for (int i = 0; i < 256; i++)
+        {
+            firstLine[i] = qRgb(i, i, i);
+            firstLine[256 + i] = qRgb(255, 255 - i, i);
+        }
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        image.setColorSpace(QColorSpace::ProPhotoRgb);
+#endif
+        return image;
+    }
+}
+
+void ColorManagerBenchmarks::initTestCase()
+{
+    if (!QVColorManager::isSupported())
+        QSKIP("Color management needs Qt 5.14");
+
+    sourceImage = createTestImage();
+}
+
+void ColorManagerBenchmarks::testInstructionSetsMatch_data()
+{
+    QTest::addColumn<QImage::Format>("format");
+
+    QTest::newRow("rgb32") << QImage::Format_RGB32;
+    QTest::newRow("argb32") << QImage::Format_ARGB32;
+    QTest::newRow("argb32 premultiplied") << QImage::Format_ARGB32_Premultiplied;
+}
+
+void ColorManagerBenchmarks::testInstructionSetsMatch()
+{
+    QFETCH(QImage::Format, format);
+
+    const QImage source = sourceImage.convertToFormat(format);
+    QImage reference = source;
+    QVERIFY(QVColorManager::convertToDisplay(reference, QVImageScaler::InstructionSet::Scalar));
+
+    const QList<QVImageScaler::InstructionSet> instructionSets = {QVImageScaler::InstructionSet::SSE41, QVImageScaler::InstructionSet::AVX2};
+    for (const auto instructionSet : instructionSets)
+    {
+        if (!QVImageScaler::isSupported(instructionSet))
+            continue;
+
+        QImage converted = source;
+        QVERIFY(QVColorManager::convertToDisplay(converted, instructionSet));
+        QCOMPARE(converted, reference);
+    }
+}
+
+void ColorManagerBenchmarks::testMatchesQtConversion_data()
+{
+    QTest::addColumn<QImage::Format>("format");
+
+    QTest::newRow("rgb32") << QImage::Format_RGB32;
+    QTest::newRow("argb32 premultiplied") << QImage::Format_ARGB32_Premultiplied;
+}
+
+void ColorManagerBenchmarks::testMatchesQtConversion()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QFETCH(QImage::Format, format);
+
+    // Premultiplied pixels are compared as stored, fully transparent ones have no color to compare
+    const QImage source = sourceImage.convertToFormat(format);
+    QImage converted = source;
+    QVERIFY(QVColorManager::convertToDisplay(converted));
+    QImage expected = source;
+    expected.convertToColorSpace(converted.colorSpace());
+    QCOMPARE(converted.format(), expected.format());
+
+    int largestDifference = 0;
+    for (int y = 0; y < converted.height(); y++)
+    {
+        const auto *convertedLine = reinterpret_cast<const QRgb *>(converted.constScanLine(y));
+        const auto *expectedLine = reinterpret_cast<const QRgb *>(expected.constScanLine(y));
+        for (int x = 0; x < converted.width(); x++)
+        {
+            if (qAlpha(expectedLine[x]) == 0)
+                continue;
+
+            const int difference = qMax(qMax(qAbs(qRed(convertedLine[x]) - qRed(expectedLine[x])), qAbs(qGreen(convertedLine[x]) - qGreen(expectedLine[x]))),
+                                        qMax(qAbs(qBlue(convertedLine[x]) - qBlue(expectedLine[x])), qAbs(qAlpha(convertedLine[x]) - qAlpha(expectedLine[x]))));
+            largestDifference = qMax(largestDifference, difference);
+        }
+    }
+    QVERIFY2(largestDifference <= 2, qPrintable(QString("Off by up to %1 levels").arg(largestDifference)));
+#endif
+}
+
+void ColorManagerBenchmarks::benchmarkConvert_data()
+{
+    QTest::addColumn<QVImageScaler::InstructionSet>("instructionSet");
+
+    QTest::newRow("scalar") << QVImageScaler::InstructionSet::Scalar;
+    QTest::newRow("sse4.1") << QVImageScaler::InstructionSet::SSE41;
+    QTest::newRow("avx2") << QVImageScaler::InstructionSet::AVX2;
+}
+
+void ColorManagerBenchmarks::benchmarkConvert()
+{
+    QFETCH(QVImageScaler::InstructionSet, instructionSet);
+
+    if (!QVImageScaler::isSupported(instructionSet))
+        QSKIP("Not supported by this processor");
+
+    const QImage source = sourceImage.convertToFormat(QImage::Format_RGB32);
+
+    // Warm the table cache, so only the conversion is timed
+    QImage warmup = source;
+    QVColorManager::convertToDisplay(warmup, instructionSet);
+
+    QBENCHMARK {
+        QImage converted = source;
+        QVColorManager::convertToDisplay(converted, instructionSet);
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef TST_COLORMANAGERBENCHMARKS_H
+#define TST_COLORMANAGERBENCHMARKS_H
+
+#include <QObject>
+#include <QImage>
+
+// Checks that every instruction set QVColorManager can use converts to exactly the same pixels,
+// that those pixels stay close to what Qt's own conversion makes of them, and times the instruction sets against each other
+class ColorManagerBenchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testInstructionSetsMatch_data();
+    void testInstructionSetsMatch();
+
+    void testMatchesQtConversion_data();
+    void testMatchesQtConversion();
+
+    void benchmarkConvert_data();
+    void benchmarkConvert();
+
+private:
+    QImage sourceImage;
+};
+
+#endif // TST_COLORMANAGERBENCHMARKS_H
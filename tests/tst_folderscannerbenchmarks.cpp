@@ -0,0 +1,165 @@
+#include "tst_folderscannerbenchmarks.h"
+
+#include "qvapplication.h"
+
+#include <QtTest>
+#include <QMimeDatabase>
+
+namespace
+{
+    const int IMAGE_COUNT = 5000;
+    const int OTHER_COUNT = 1000;
+
+    void populateDirectory(const QString &path)
+    {
+        QDir dir(path);
+        for (int i = 0; i < IMAGE_COUNT; i++)
+        {
+            QFile file(dir.filePath(QString("image%1.%2").arg(i).arg(i % 2 ? "png" : "jpg")));
+            file.open(QIODevice::WriteOnly);
+            file.write(QByteArray(i % 64, 'x'));
+        }
+        for (int i = 0; i < OTHER_COUNT; i++)
+        {
+            QFile file(dir.filePath(QString("notes%1.txt").arg(i)));
+            file.open(QIODevice::WriteOnly);
+        }
+        for (int i = 0; i < 10; i++)
+            dir.mkdir(QString("folder%1").arg(i));
+    }
+
+    // The scan getCompatibleFiles used before the native scanner, kept here as the baseline
+    QFileInfoList getCompatibleFilesWithQDir(const QString &dirPath)
+    {
+        QFileInfoList fileInfoList;
+
+        QMimeDatabase mimeDb;
+        const auto &regs = qvApp->getFilterRegExpList();
+        const auto &mimeTypes = qvApp->getMimeTypeNameList();
+
+        const QFileInfoList currentFolder = QDir(dirPath).entryInfoList();
+        for (const QFileInfo &fileInfo : currentFolder)
+        {
+            bool matched = false;
+            const QString name = fileInfo.fileName();
+            for (const QRegularExpression &reg : regs)
+            {
+                if (reg.match(name).hasMatch()) {
+                    matched = true;
+                    break;
+                }
+            }
+            if (matched || mimeTypes.contains(mimeDb.mimeTypeForFile(fileInfo).name()))
+            {
+                fileInfoList.append(fileInfo);
+            }
+        }
+
+        return fileInfoList;
+    }
+}
+
+void FolderScannerBenchmarks::initTestCase()
+{
+    QVERIFY(localDir.isValid());
+    populateDirectory(localDir.path());
+
+    const QString slowDirPath = QString::fromLocal8Bit(qgetenv("QVIEW_BENCHMARK_SLOW_DIR"));
+    if (slowDirPath.isEmpty())
+    {
+        qInfo("QVIEW_BENCHMARK_SLOW_DIR is not set, so only the local directory is benchmarked");
+    }
+    else
+    {
+        slowDir.reset(new QTemporaryDir(slowDirPath + "/qview-bench-XXXXXX"));
+        QVERIFY(slowDir->isValid());
+        populateDirectory(slowDir->path());
+    }
+}
+
+void FolderScannerBenchmarks::testScannersAgree()
+{
+    QStringList qDirNames;
+    const auto qDirFiles = getCompatibleFilesWithQDir(localDir.path());
+    for (const auto &fileInfo : qDirFiles)
+        qDirNames << fileInfo.fileName();
+
+    const auto folderIndex = QVImageCore::getCompatibleFiles(localDir.path(), 2);
+    QStringList nativeNames;
+    for (int i = 0; i < folderIndex.count(); i++)
+    {
+        nativeNames << folderIndex.fileName(i);
+        QCOMPARE(folderIndex.size(i), QFileInfo(folderIndex.absoluteFilePath(i)).size());
+    }
+
+    qDirNames.sort();
+    nativeNames.sort();
+    QCOMPARE(nativeNames.length(), IMAGE_COUNT);
+    QCOMPARE(nativeNames, qDirNames);
+}
+
+void FolderScannerBenchmarks::addScanData()
+{
+    QTest::addColumn<QString>("dirPath");
+    QTest::addColumn<int>("sortMode");
+
+    QTest::newRow("local, name") << localDir.path() << 0;
+    QTest::newRow("local, modified") << localDir.path() << 1;
+    QTest::newRow("local, size") << localDir.path() << 2;
+
+    if (slowDir)
+    {
+        QTest::newRow("slow, name") << slowDir->path() << 0;
+        QTest::newRow("slow, modified") << slowDir->path() << 1;
+        QTest::newRow("slow, size") << slowDir->path() << 2;
+    }
+}
+
+void FolderScannerBenchmarks::benchmarkQDirScan_data()
+{
+    addScanData();
+}
+
+void FolderScannerBenchmarks::benchmarkQDirScan()
+{
+    QFETCH(QString, dirPath);
+    QFETCH(int, sortMode);
+
+    qint64 checksum = 0;
+    QBENCHMARK {
+        // Touch the field the sort would compare, QFileInfo stats lazily
+        const auto files = getCompatibleFilesWithQDir(dirPath);
+        for (const auto &fileInfo : files)
+        {
+            if (sortMode == 1)
+                checksum += fileInfo.lastModified().toMSecsSinceEpoch();
+            else if (sortMode == 2)
+                checksum += fileInfo.size();
+        }
+    }
+    Q_UNUSED(checksum)
+}
+
+void FolderScannerBenchmarks::benchmarkNativeScan_data()
+{
+    addScanData();
+}
+
+void FolderScannerBenchmarks::benchmarkNativeScan()
+{
+    QFETCH(QString, dirPath);
+    QFETCH(int, sortMode);
+
+    qint64 checksum = 0;
+    QBENCHMARK {
+        const auto folderIndex = QVImageCore::getCompatibleFiles(dirPath, sortMode);
+        for (int i = 0; i < folderIndex.count(); i++)
+        {
+            if (sortMode == 1)
+                checksum += folderIndex.lastModified(i);
+            else if (sortMode == 2)
+                checksum += folderIndex.size(i);
+        }
+    }
+    Q_UNUSED(checksum)
+}
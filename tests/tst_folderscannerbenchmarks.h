@@ -0,0 +1,34 @@
+#ifndef TST_FOLDERSCANNERBENCHMARKS_H
+#define TST_FOLDERSCANNERBENCHMARKS_H
+
+#include <QObject>
+#include <QTemporaryDir>
+#include <QScopedPointer>
+
+// Compares QVImageCore::getCompatibleFiles against the old QDir::entryInfoList based scan.
+// By default only a local temporary directory is scanned. The slow filesystem rows are manual only,
+// the benchmark adds no latency of its own: point QVIEW_BENCHMARK_SLOW_DIR at a writable directory
+// on a high latency mount, e.g. a loopback NFS export with "tc qdisc add dev lo root netem delay 2ms".
+class FolderScannerBenchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testScannersAgree();
+
+    void benchmarkQDirScan_data();
+    void benchmarkQDirScan();
+
+    void benchmarkNativeScan_data();
+    void benchmarkNativeScan();
+
+private:
+    void addScanData();
+
+    QTemporaryDir localDir;
+    QScopedPointer<QTemporaryDir> slowDir;
+};
+
+#endif // TST_FOLDERSCANNERBENCHMARKS_H
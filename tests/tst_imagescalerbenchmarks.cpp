@@ -0,0 +1,242 @@
+#include "tst_imagescalerbenchmarks.h"
+
+#include "qvimagescaler.h"
+
+#include <QtTest>
+#include <QtMath>
+#include <cstring>
+
+Q_DECLARE_METATYPE(QVImageScaler::InstructionSet)
+
+namespace
+{
+    const QSize SOURCE_SIZE(4000, 3000);
+
+    // Smooth content, so the comparison with Qt measures the filters and not how each handles aliasing
+    QImage createTestImage(QImage::Format format)
+    {
+        QImage image(SOURCE_SIZE, QImage::Format_ARGB32_Premultiplied);
+        for (int y = 0; y < image.height(); y++)
+        {
+            auto *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < image.width(); x++)
+            {
+                const int alpha = 128 + static_cast<int>(127 * qSin(x / 300.0));
+                const int red = 255 * x / image.width();
+                const int green = 255 * y / image.height();
+                const int blue = 128 + static_cast<int>(127 * qSin((x + y) / 90.0));
+                line[x] = qPremultiply(qRgba(red, green, blue, alpha));
+            }
+        }
+        return image.convertToFormat(format);
+    }
+
+    double psnr(const QImage &image1, const QImage &image2)
+    {
+        double squaredError = 0;
+        const int rowBytes = image1.width() * image1.depth() / 8;
+        for (int y = 0; y < image1.height(); y++)
+        {
+            const uchar *line1 = image1.constScanLine(y);
+            const uchar *line2 = image2.constScanLine(y);
+            for (int i = 0; i < rowBytes; i++)
+            {
+                const int difference = line1[i] - line2[i];
+                squaredError += difference * difference;
+            }
+        }
+
+        const double meanSquaredError = squaredError / (static_cast<double>(rowBytes) * image1.height());
+        if (meanSquaredError == 0)
+            return 100;
+
+        return 10 * std::log10(255.0 * 255.0 / meanSquaredError);
+    }
+}
+
+void ImageScalerBenchmarks::initTestCase()
+{
+    colorImage = createTestImage(QImage::Format_ARGB32_Premultiplied);
+    grayscaleImage = createTestImage(QImage::Format_Grayscale8);
+}
+
+void ImageScalerBenchmarks::addScaleData()
+{
+    QTest::addColumn<bool>("grayscale");
+    QTest::addColumn<QSize>("size");
+
+    // Lanczos territory, right at the switch to area averaging, and a big reduction
+    QTest::newRow("color, 0.75") << false << QSize(3000, 2250);
+    QTest::newRow("color, 0.5") << false << QSize(2000, 1500);
+    QTest::newRow("color, 0.12") << false << QSize(480, 360);
+    QTest::newRow("grayscale, 0.75") << true << QSize(3000, 2250);
+    QTest::newRow("grayscale, 0.12") << true << QSize(480, 360);
+}
+
+void ImageScalerBenchmarks::testInstructionSetsMatch_data()
+{
+    addScaleData();
+}
+
+void ImageScalerBenchmarks::testInstructionSetsMatch()
+{
+    QFETCH(bool, grayscale);
+    QFETCH(QSize, size);
+
+    const QImage &source = grayscale ? grayscaleImage : colorImage;
+    const QImage reference = QVImageScaler::scale(source, size, QVImageScaler::Filter::Automatic, QVImageScaler::InstructionSet::Scalar);
+
+    const QList<QVImageScaler::InstructionSet> instructionSets = {QVImageScaler::InstructionSet::SSE41, QVImageScaler::InstructionSet::AVX2};
+    for (const auto instructionSet : instructionSets)
+    {
+        if (!QVImageScaler::isSupported(instructionSet))
+            continue;
+
+        QCOMPARE(QVImageScaler::scale(source, size, QVImageScaler::Filter::Automatic, instructionSet), reference);
+    }
+}
+
+void ImageScalerBenchmarks::testThreadingMatches_data()
+{
+    addScaleData();
+}
+
+void ImageScalerBenchmarks::testThreadingMatches()
+{
+    QFETCH(bool, grayscale);
+    QFETCH(QSize, size);
+
+    const QImage &source = grayscale ? grayscaleImage : colorImage;
+    const QImage reference = QVImageScaler::scale(source, size, QVImageScaler::Filter::Automatic,
+                                                  QVImageScaler::InstructionSet::Automatic, QVImageScaler::Threading::SingleThreaded);
+    QCOMPARE(QVImageScaler::scale(source, size, QVImageScaler::Filter::Automatic,
+                                  QVImageScaler::InstructionSet::Automatic, QVImageScaler::Threading::Parallel), reference);
+}
+
+void ImageScalerBenchmarks::testRescaleRectMatches_data()
+{
+    addScaleData();
+}
+
+void ImageScalerBenchmarks::testRescaleRectMatches()
+{
+    QFETCH(bool, grayscale);
+    QFETCH(QSize, size);
+
+    const QImage &source = grayscale ? grayscaleImage : colorImage;
+    QImage scaled = QVImageScaler::scale(source, size);
+
+    // Change a patch the way an animation frame would, then only redo what it touches
+    QImage changed = source.copy();
+    const QRect changedRect(1234, 567, 89, 1011);
+    const int bytesPerPixel = changed.depth() / 8;
+    for (int y = changedRect.top(); y <= changedRect.bottom(); y++)
+        memset(changed.scanLine(y) + changedRect.left() * bytesPerPixel, 0, changedRect.width() * bytesPerPixel);
+
+    QVERIFY(QVImageScaler::rescaleRect(changed, scaled, changedRect));
+    QCOMPARE(scaled, QVImageScaler::scale(changed, size));
+}
+
+void ImageScalerBenchmarks::testRasterFormat_data()
+{
+    QTest::addColumn<QVImageScaler::InstructionSet>("instructionSet");
+
+    QTest::newRow("scalar") << QVImageScaler::InstructionSet::Scalar;
+    QTest::newRow("sse4.1") << QVImageScaler::InstructionSet::SSE41;
+    QTest::newRow("avx2") << QVImageScaler::InstructionSet::AVX2;
+}
+
+void ImageScalerBenchmarks::testRasterFormat()
+{
+    QFETCH(QVImageScaler::InstructionSet, instructionSet);
+    if (!QVImageScaler::isSupported(instructionSet))
+        QSKIP("Instruction set not supported");
+
+    // An odd width so the last pixel of a row lands outside the vector loop
+    QImage opaque(1001, 7, QImage::Format_ARGB32);
+    opaque.fill(qRgba(10, 20, 30, 255));
+    QImage converted = opaque;
+    QVImageScaler::convertToRasterFormat(converted, instructionSet);
+    QCOMPARE(converted.format(), QImage::Format_RGB32);
+    QCOMPARE(converted.convertToFormat(QImage::Format_ARGB32), opaque);
+
+    QImage translucent = opaque;
+    translucent.setPixel(1000, 6, qRgba(10, 20, 30, 254));
+    converted = translucent;
+    QVImageScaler::convertToRasterFormat(converted, instructionSet);
+    QCOMPARE(converted.format(), QImage::Format_ARGB32_Premultiplied);
+    QCOMPARE(converted.convertToFormat(QImage::Format_ARGB32), translucent);
+}
+
+void ImageScalerBenchmarks::testQualityMatchesQt_data()
+{
+    addScaleData();
+}
+
+void ImageScalerBenchmarks::testQualityMatchesQt()
+{
+    QFETCH(bool, grayscale);
+    QFETCH(QSize, size);
+
+    const QImage &source = grayscale ? grayscaleImage : colorImage;
+    const QImage scaled = QVImageScaler::scale(source, size);
+    const QImage qtScaled = source.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).convertToFormat(scaled.format());
+
+    QCOMPARE(scaled.size(), size);
+    const double quality = psnr(scaled, qtScaled);
+    qInfo() << "PSNR against Qt:" << quality << "dB";
+    QVERIFY(quality > 35);
+}
+
+void ImageScalerBenchmarks::benchmarkQtSmoothScale_data()
+{
+    addScaleData();
+}
+
+void ImageScalerBenchmarks::benchmarkQtSmoothScale()
+{
+    QFETCH(bool, grayscale);
+    QFETCH(QSize, size);
+
+    const QImage &source = grayscale ? grayscaleImage : colorImage;
+    QBENCHMARK {
+        const QImage scaled = source.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        Q_UNUSED(scaled)
+    }
+}
+
+void ImageScalerBenchmarks::benchmarkScaler_data()
+{
+    addScaleData();
+}
+
+void ImageScalerBenchmarks::benchmarkScaler()
+{
+    QFETCH(bool, grayscale);
+    QFETCH(QSize, size);
+
+    const QImage &source = grayscale ? grayscaleImage : colorImage;
+    QBENCHMARK {
+        const QImage scaled = QVImageScaler::scale(source, size, QVImageScaler::Filter::Automatic,
+                                                   QVImageScaler::InstructionSet::Automatic, QVImageScaler::Threading::SingleThreaded);
+        Q_UNUSED(scaled)
+    }
+}
+
+void ImageScalerBenchmarks::benchmarkParallelScaler_data()
+{
+    addScaleData();
+}
+
+void ImageScalerBenchmarks::benchmarkParallelScaler()
+{
+    QFETCH(bool, grayscale);
+    QFETCH(QSize, size);
+
+    const QImage &source = grayscale ? grayscaleImage : colorImage;
+    QBENCHMARK {
+        const QImage scaled = QVImageScaler::scale(source, size, QVImageScaler::Filter::Automatic,
+                                                   QVImageScaler::InstructionSet::Automatic, QVImageScaler::Threading::Parallel);
+        Q_UNUSED(scaled)
+    }
+}
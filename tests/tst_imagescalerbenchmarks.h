@@ -0,0 +1,47 @@
+#ifndef TST_IMAGESCALERBENCHMARKS_H
+#define TST_IMAGESCALERBENCHMARKS_H
+
+#include <QObject>
+#include <QImage>
+
+// Compares QVImageScaler against QImage::scaled with Qt::SmoothTransformation,
+// both for speed and for how close the output is.
+class ImageScalerBenchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testInstructionSetsMatch_data();
+    void testInstructionSetsMatch();
+
+    void testThreadingMatches_data();
+    void testThreadingMatches();
+
+    void testRescaleRectMatches_data();
+    void testRescaleRectMatches();
+
+    void testRasterFormat_data();
+    void testRasterFormat();
+
+    void testQualityMatchesQt_data();
+    void testQualityMatchesQt();
+
+    void benchmarkQtSmoothScale_data();
+    void benchmarkQtSmoothScale();
+
+    void benchmarkScaler_data();
+    void benchmarkScaler();
+
+    void benchmarkParallelScaler_data();
+    void benchmarkParallelScaler();
+
+private:
+    void addScaleData();
+
+    QImage colorImage;
+    QImage grayscaleImage;
+};
+
+#endif // TST_IMAGESCALERBENCHMARKS_H
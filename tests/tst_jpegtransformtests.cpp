@@ -0,0 +1,381 @@
+#include "tst_jpegtransformtests.h"
+
+#include "qvjpegtransform.h"
+
+#include <QtTest>
+#include <QImageReader>
+#include <QtMath>
+
+#ifdef LIBJPEG_LOADED
+#include <cstdio>
+
+extern "C" {
+#include <jpeglib.h>
+}
+#endif
+
+namespace
+{
+    enum class Sampling
+    {
+        Gray,
+        Yuv420,
+        Yuv422
+    };
+
+#ifdef LIBJPEG_LOADED
+    QSize getMcuSize(Sampling sampling)
+    {
+        switch (sampling) {
+        case Sampling::Yuv420:
+            return QSize(16, 16);
+        case Sampling::Yuv422:
+            return QSize(16, 8);
+        default:
+            return QSize(8, 8);
+        }
+    }
+
+    // Decoding the moved blocks doesn't give back exactly the same pixels: the IDCT rounds its rows and columns
+    // separately, and chroma upsampling interpolates from different neighbours along an edge that was trimmed.
+    // Gray images stay within 1, subsampled ones within a few levels, worst right along a trimmed edge
+    const int MAX_PIXEL_DIFFERENCE = 24;
+    const double MAX_MEAN_DIFFERENCE = 1.0;
+
+    // The largest and average difference of any channel
+    QPair<int, double> compareImages(const QImage &image1, const QImage &image2)
+    {
+        const QImage converted1 = image1.convertToFormat(QImage::Format_RGB32);
+        const QImage converted2 = image2.convertToFormat(QImage::Format_RGB32);
+        int maxDifference = 0;
+        qint64 totalDifference = 0;
+        for (int y = 0; y < converted1.height(); y++)
+        {
+            const auto *line1 = reinterpret_cast<const QRgb *>(converted1.constScanLine(y));
+            const auto *line2 = reinterpret_cast<const QRgb *>(converted2.constScanLine(y));
+            for (int x = 0; x < converted1.width(); x++)
+            {
+                const int differences[3] = {
+                    qAbs(qRed(line1[x]) - qRed(line2[x])),
+                    qAbs(qGreen(line1[x]) - qGreen(line2[x])),
+                    qAbs(qBlue(line1[x]) - qBlue(line2[x]))
+                };
+                for (const int difference : differences)
+                {
+                    maxDifference = qMax(maxDifference, difference);
+                    totalDifference += difference;
+                }
+            }
+        }
+        return {maxDifference, static_cast<double>(totalDifference) / (converted1.width() * converted1.height() * 3)};
+    }
+
+    QImage readImage(const QString &filePath, bool autoTransform = false)
+    {
+        QImageReader reader(filePath);
+        reader.setAutoTransform(autoTransform);
+        return reader.read();
+    }
+
+    bool copyFile(const QString &source, const QString &destination)
+    {
+        QFile::remove(destination);
+        return QFile::copy(source, destination) && QFile(destination).setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    }
+
+    // Rotation first and then the mirror, as QVJpegTransform applies them
+    QTransform getViewTransform(int rotation, bool mirrored)
+    {
+        return QTransform().rotate(rotation) * QTransform().scale(mirrored ? -1 : 1, 1);
+    }
+
+    // An axis ends up reversed when its direction points left or up on screen, which is the side its partial MCU is lost from
+    bool isReversed(const QTransform &transform, const QPointF &axis)
+    {
+        const QPointF direction = transform.map(axis) - transform.map(QPointF(0, 0));
+        return direction.x() < -0.5 || direction.y() < -0.5;
+    }
+
+    // A minimal TIFF with the orientation in IFD0 and a one-entry IFD1 standing in for a thumbnail
+    QByteArray makeExif(int orientation)
+    {
+        QByteArray exif("Exif\0\0II", 8);
+        auto append16 = [&exif](int value){
+            exif.append(static_cast<char>(value & 0xFF));
+            exif.append(static_cast<char>((value >> 8) & 0xFF));
+        };
+        auto append32 = [&append16](int value){
+            append16(value & 0xFFFF);
+            append16((value >> 16) & 0xFFFF);
+        };
+
+        append16(42);
+        append32(8);
+
+        append16(1);
+        append16(0x0112);
+        append16(3);
+        append32(1);
+        append16(orientation);
+        append16(0);
+        append32(8 + 2 + 12 + 4);
+
+        append16(1);
+        append16(0x0103);
+        append16(3);
+        append32(1);
+        append16(6);
+        append16(0);
+        append32(0);
+        return exif;
+    }
+
+    // Smooth gradients with some detail, so every block has more than a DC coefficient to move around
+    bool writeJpeg(const QString &filePath, const QSize &size, Sampling sampling, int exifOrientation = 0)
+    {
+        FILE *file = fopen(QFile::encodeName(filePath).constData(), "wb");
+        if (!file)
+            return false;
+
+        jpeg_compress_struct info;
+        jpeg_error_mgr error;
+        info.err = jpeg_std_error(&error);
+        jpeg_create_compress(&info);
+        jpeg_stdio_dest(&info, file);
+
+        const int components = sampling == Sampling::Gray ? 1 : 3;
+        info.image_width = static_cast<JDIMENSION>(size.width());
+        info.image_height = static_cast<JDIMENSION>(size.height());
+        info.input_components = components;
+        info.in_color_space = sampling == Sampling::Gray ? JCS_GRAYSCALE : JCS_RGB;
+        jpeg_set_defaults(&info);
+        jpeg_set_quality(&info, 90, TRUE);
+        if (sampling == Sampling::Yuv422)
+        {
+            info.comp_info[0].h_samp_factor = 2;
+            info.comp_info[0].v_samp_factor = 1;
+        }
+        jpeg_start_compress(&info, TRUE);
+
+        if (exifOrientation > 0)
+        {
+            const QByteArray exif = makeExif(exifOrientation);
+            jpeg_write_marker(&info, JPEG_APP0 + 1, reinterpret_cast<const JOCTET *>(exif.constData()), static_cast<unsigned int>(exif.size()));
+        }
+
+        QVector<JSAMPLE> row(size.width() * components);
+        while (info.next_scanline < info.image_height)
+        {
+            const int y = static_cast<int>(info.next_scanline);
+            for (int x = 0; x < size.width(); x++)
+            {
+                const int red = x * 255 / (size.width() - 1);
+                const int green = y * 255 / (size.height() - 1);
+                const int blue = 128 + static_cast<int>(100 * qSin((x + y) / 9.0));
+                if (components == 1)
+                {
+                    row[x] = static_cast<JSAMPLE>((red + green) / 2);
+                }
+                else
+                {
+                    row[x * 3] = static_cast<JSAMPLE>(red);
+                    row[x * 3 + 1] = static_cast<JSAMPLE>(green);
+                    row[x * 3 + 2] = static_cast<JSAMPLE>(blue);
+                }
+            }
+            JSAMPROW rowPointer = row.data();
+            jpeg_write_scanlines(&info, &rowPointer, 1);
+        }
+
+        jpeg_finish_compress(&info);
+        jpeg_destroy_compress(&info);
+        fclose(file);
+        return true;
+    }
+
+    // Everything a lossless transform has to carry over: the layout, the quantizers and every coefficient
+    struct Coefficients
+    {
+        QSize size;
+        QVector<int> layout;
+        QVector<int> quantizers;
+        QVector<int> values;
+    };
+
+    Coefficients readCoefficients(const QString &filePath)
+    {
+        Coefficients coefficients;
+        FILE *file = fopen(QFile::encodeName(filePath).constData(), "rb");
+        if (!file)
+            return coefficients;
+
+        jpeg_decompress_struct info;
+        jpeg_error_mgr error;
+        info.err = jpeg_std_error(&error);
+        jpeg_create_decompress(&info);
+        jpeg_stdio_src(&info, file);
+        jpeg_read_header(&info, TRUE);
+        jvirt_barray_ptr *arrays = jpeg_read_coefficients(&info);
+
+        coefficients.size = QSize(static_cast<int>(info.image_width), static_cast<int>(info.image_height));
+        for (int ci = 0; ci < info.num_components; ci++)
+        {
+            const jpeg_component_info *component = info.comp_info + ci;
+            coefficients.layout << component->h_samp_factor << component->v_samp_factor
+                                << static_cast<int>(component->width_in_blocks) << static_cast<int>(component->height_in_blocks);
+
+            for (int i = 0; i < DCTSIZE2; i++)
+                coefficients.quantizers.append(component->quant_table ? component->quant_table->quantval[i] : 0);
+
+            for (JDIMENSION y = 0; y < component->height_in_blocks; y++)
+            {
+                JBLOCKARRAY rows = (*info.mem->access_virt_barray)(reinterpret_cast<j_common_ptr>(&info), arrays[ci], y, 1, FALSE);
+                for (JDIMENSION x = 0; x < component->width_in_blocks; x++)
+                {
+                    for (int i = 0; i < DCTSIZE2; i++)
+                        coefficients.values.append(rows[0][x][i]);
+                }
+            }
+        }
+
+        jpeg_finish_decompress(&info);
+        jpeg_destroy_decompress(&info);
+        fclose(file);
+        return coefficients;
+    }
+#endif
+}
+
+Q_DECLARE_METATYPE(Sampling)
+
+void JpegTransformTests::initTestCase()
+{
+#ifndef LIBJPEG_LOADED
+    QSKIP("Built without libjpeg");
+#endif
+    QVERIFY(dir.isValid());
+}
+
+void JpegTransformTests::addSamplingData()
+{
+    QTest::addColumn<Sampling>("sampling");
+    QTest::addColumn<QSize>("size");
+
+    // Odd sizes leave a partial MCU along both edges, the others fill them exactly
+    QTest::newRow("gray, odd") << Sampling::Gray << QSize(61, 45);
+    QTest::newRow("gray, whole MCUs") << Sampling::Gray << QSize(64, 48);
+    QTest::newRow("4:2:0, odd") << Sampling::Yuv420 << QSize(61, 45);
+    QTest::newRow("4:2:0, whole MCUs") << Sampling::Yuv420 << QSize(64, 48);
+    QTest::newRow("4:2:2, odd") << Sampling::Yuv422 << QSize(37, 29);
+    QTest::newRow("4:2:2, whole MCUs") << Sampling::Yuv422 << QSize(64, 48);
+}
+
+QString JpegTransformTests::getPath(const QString &name) const
+{
+    return dir.filePath(name);
+}
+
+void JpegTransformTests::testOrientations_data()
+{
+    addSamplingData();
+}
+
+void JpegTransformTests::testOrientations()
+{
+#ifdef LIBJPEG_LOADED
+    QFETCH(Sampling, sampling);
+    QFETCH(QSize, size);
+
+    const QString sourcePath = getPath("orientations-source.jpg");
+    QVERIFY(writeJpeg(sourcePath, size, sampling));
+    const QImage original = readImage(sourcePath);
+    QCOMPARE(original.size(), size);
+
+    const QSize mcuSize = getMcuSize(sampling);
+    for (int rotation = 0; rotation < 360; rotation += 90)
+    {
+        for (const bool mirrored : {false, true})
+        {
+            const QString description = QString("rotation %1, mirrored %2").arg(rotation).arg(mirrored);
+            const QString path = getPath("orientations.jpg");
+            QVERIFY(copyFile(sourcePath, path));
+            QCOMPARE(QVJpegTransform::transformFile(path, rotation, mirrored, false), QString());
+
+            // The partial MCU is only lost along an axis that gets reversed, from the right or bottom of the original
+            const QTransform transform = getViewTransform(rotation, mirrored);
+            QSize keptSize = size;
+            if (isReversed(transform, QPointF(1, 0)))
+                keptSize.setWidth(size.width() - size.width() % mcuSize.width());
+            if (isReversed(transform, QPointF(0, 1)))
+                keptSize.setHeight(size.height() - size.height() % mcuSize.height());
+
+            const QImage expected = original.copy(QRect(QPoint(0, 0), keptSize)).transformed(transform);
+            const QImage transformed = readImage(path);
+            QVERIFY2(transformed.size() == expected.size(), qPrintable(description));
+
+            const QPair<int, double> difference = compareImages(transformed, expected);
+            QVERIFY2(difference.first <= MAX_PIXEL_DIFFERENCE, qPrintable(description));
+            QVERIFY2(difference.second <= MAX_MEAN_DIFFERENCE, qPrintable(description));
+        }
+    }
+#endif
+}
+
+void JpegTransformTests::testQuarterTurnsRoundTrip_data()
+{
+    addSamplingData();
+}
+
+void JpegTransformTests::testQuarterTurnsRoundTrip()
+{
+#ifdef LIBJPEG_LOADED
+    QFETCH(Sampling, sampling);
+    QFETCH(QSize, size);
+
+    // The first two turns trim whatever partial MCUs they have to, one axis each, after that nothing is lost
+    const QString path = getPath("round-trip.jpg");
+    QVERIFY(writeJpeg(path, size, sampling));
+    for (int turn = 0; turn < 2; turn++)
+        QCOMPARE(QVJpegTransform::transformFile(path, 90, false, false), QString());
+    const Coefficients reference = readCoefficients(path);
+    QVERIFY(!reference.values.isEmpty());
+
+    for (int turn = 0; turn < 4; turn++)
+        QCOMPARE(QVJpegTransform::transformFile(path, 90, false, false), QString());
+
+    const Coefficients turned = readCoefficients(path);
+    QCOMPARE(turned.size, reference.size);
+    QCOMPARE(turned.layout, reference.layout);
+    QCOMPARE(turned.quantizers, reference.quantizers);
+    QVERIFY(turned.values == reference.values);
+#endif
+}
+
+void JpegTransformTests::testExifOrientation()
+{
+#ifdef LIBJPEG_LOADED
+    // Orientation 6 is shown turned clockwise, which ends up in the pixels
+    const QString path = getPath("exif.jpg");
+    QVERIFY(writeJpeg(path, QSize(64, 48), Sampling::Yuv420, 6));
+    const QImage shown = readImage(path, true);
+    QCOMPARE(shown.size(), QSize(48, 64));
+
+    QCOMPARE(QVJpegTransform::transformFile(path, 0, false, false), QString());
+
+    QImageReader reader(path);
+    QCOMPARE(static_cast<int>(reader.transformation()), static_cast<int>(QImageIOHandler::TransformationNone));
+    const QImage transformed = readImage(path);
+    QCOMPARE(transformed.size(), shown.size());
+    const QPair<int, double> difference = compareImages(transformed, shown);
+    QVERIFY(difference.first <= MAX_PIXEL_DIFFERENCE);
+    QVERIFY(difference.second <= MAX_MEAN_DIFFERENCE);
+
+    // The thumbnail would still be the old way around, so IFD0 no longer links to it
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray data = file.readAll();
+    const int tiff = data.indexOf(QByteArray("Exif\0\0", 6)) + 6;
+    QVERIFY(tiff >= 6);
+    QCOMPARE(data.mid(tiff + 8 + 2 + 12, 4), QByteArray(4, '\0'));
+#endif
+}
@@ -0,0 +1,31 @@
+#ifndef TST_JPEGTRANSFORMTESTS_H
+#define TST_JPEGTRANSFORMTESTS_H
+
+#include <QObject>
+#include <QTemporaryDir>
+
+// Writes JPEGs with each common chroma subsampling, at sizes that do and don't fill whole MCUs,
+// and checks QVJpegTransform against transforming the decoded pixels, and against itself
+class JpegTransformTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testOrientations_data();
+    void testOrientations();
+
+    void testQuarterTurnsRoundTrip_data();
+    void testQuarterTurnsRoundTrip();
+
+    void testExifOrientation();
+
+private:
+    void addSamplingData();
+    QString getPath(const QString &name) const;
+
+    QTemporaryDir dir;
+};
+
+#endif // TST_JPEGTRANSFORMTESTS_H